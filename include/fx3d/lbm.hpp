@@ -6,6 +6,7 @@
 #include <utils/graphics.hpp>
 #include <utils/units.hpp>
 #include <fx3d/info.hpp>
+#include <fx3d/transport.hpp>
 
 namespace fx3d
 {
@@ -13,6 +14,9 @@ namespace fx3d
 uint bytes_per_cell_host(); // returns the number of Bytes per cell allocated in host memory
 uint bytes_per_cell_device(); // returns the number of Bytes per cell allocated in device memory
 uint bandwidth_bytes_per_cell_device(); // returns the bandwidth in Bytes per cell per time step from/to device memory
+uint transfer_bytes_per_cell(); // returns the number of Bytes per domain boundary cell transferred between domains in every time step
+uint halo_width(); // returns the number of halo layers on every side of a domain in split directions
+uint3 decompose_domains(const uint Nx, const uint Ny, const uint Nz, const uint D, const uint memory=max_uint); // returns domains (Dx, Dy, Dz) with Dx*Dy*Dz=D that minimize halo transfer, domains have to fit into memory (in MB)
 uint3 resolution(const float3 box_aspect_ratio, const uint memory); // input: simulation box aspect ratio and VRAM occupation in MB, output: grid resolution
 
 string default_filename(const string& path, const string& name, const string& extension, const ulong t); // generate a default filename with timestamp
@@ -26,6 +30,7 @@ private:
 	uint Nx=1u, Ny=1u, Nz=1u; // (local) lattice dimensions
 	uint Dx=1u, Dy=1u, Dz=1u; // lattice domains
 	int Ox=0, Oy=0, Oz=0; // lattice domain offset
+	uint Gx=1u, Gy=1u, Gz=1u; // (global) lattice dimensions of all domains combined
 	ulong t = 0ull; // discrete time step in LBM units
 
 	float nu = 1.0f/6.0f; // kinematic shear viscosity
@@ -38,8 +43,13 @@ private:
 	Device device; // OpenCL device associated with this LBM domain
 	Kernel kernel_initialize; // initialization kernel
 	Kernel kernel_stream_collide; // main LBM kernel
+	uint vector_width = 1u; // lattice points per work-item in kernel_stream_collide, more than 1 selects the explicitly vectorized variant for OpenCL CPU devices
 	Kernel kernel_update_fields; // reads DDFs and updates (rho, u, T) in device memory
 	Memory<fpxx> fi; // LBM density distribution functions (DDFs); only exist in device memory
+	vector<Memory<fpxx>> fi_split; // DDF buffers 1, 2, ... if the DDFs do not fit into one device buffer, fi is buffer 0
+	uint fi_group = 0u; // DDF directions per device buffer, all directions unless the DDFs are split
+	Memory<fpxx> fi_next; // DDFs after a temporal block, only allocated with temporal blocking
+	Kernel kernel_stream_collide_tiles; // temporal blocking: advance tiles of the lattice by several time steps in one pass
 	ulong t_last_update_fields = 0ull; // optimization to not call kernel_update_fields multiple times if (rho, u, T) are already up-to-date
 // #ifdef FORCE_FIELD
 	Kernel kernel_calculate_force_on_boundaries; // calculate forces from fluid on TYPE_S nodes
@@ -47,6 +57,10 @@ private:
 // #endif // FORCE_FIELD
 // #ifdef MOVING_BOUNDARIES
 	Kernel kernel_update_moving_boundaries; // mark/unmark nodes next to TYPE_S nodes with velocity!=0 with TYPE_MS
+	bool neighbor_masks = false; // moving boundaries read solid neighbors from solid_neighbors instead of the flags of all neighbors
+	bool neighbor_masks_stale = true; // solids may have changed since solid_neighbors was built
+	Memory<uint> solid_neighbors; // bit i is set if neighbor i is TYPE_S, only allocated with neighbor masks
+	Kernel kernel_update_neighbor_masks; // rebuild solid_neighbors from flags
 // #endif // MOVING_BOUNDARIES
 // #ifdef SURFACE
 	Kernel kernel_surface_0; // additional kernel for computing mass conservation and mass flux computation
@@ -55,16 +69,43 @@ private:
 	Kernel kernel_surface_3; // additional kernel for flag handling and mass conservation
 	Memory<float> mass; // fluid mass; phi=mass/rho
 	Memory<float> massex; // excess mass; used for mass conservation
+	bool surface_tiles = false; // surface_0 stages phi and flags in local memory tiles for the curvature stencil, only on GPUs
+	Memory<uint> surface_list; // lattice points with flag changes in the current time step, only allocated for a single domain
+	Memory<uint> surface_count; // number of lattice points in surface_list from stream_collide and from surface_1
 // #endif // SURFACE
 // #ifdef TEMPERATURE
 	Memory<fpxx> gi; // thermal DDFs
+	vector<Memory<fpxx>> gi_split; // thermal DDF buffers 1, 2, ... if the thermal DDFs are split, gi is buffer 0
+	uint gi_group = 0u; // thermal DDF directions per device buffer
 // #endif // TEMPERATURE
 // #ifdef PARTICLES
 	Kernel kernel_integrate_particles; // intgegrates particles forward in time and couples particles to fluid
 // #endif // PARTICLES
+	Kernel kernel_count_active_cells; // count active nodes in every plane for dynamic domain repartitioning
+	bool boundary_lists = false; // lattice points with equilibrium/moving/temperature boundaries are computed by kernel_stream_collide_boundaries from a list, kernel_stream_collide skips them
+	bool boundary_list_stale = true; // flags have changed since the boundary list was built
+	Memory<uint> boundary_list; // indices of boundary lattice points, only allocated with boundary lists
+	Memory<uint> boundary_count; // number of lattice points in boundary_list
+	Kernel kernel_list_boundary_cells; // collect boundary lattice points into boundary_list
+	Kernel kernel_stream_collide_boundaries; // stream_collide for the lattice points in boundary_list
+	bool out_of_core = false; // this domain is a z-slab of an out-of-core lattice, all state fields including the DDFs live in host memory and are streamed through the device
+	const LBM_Domain* resident = nullptr; // out-of-core: slab whose device buffers this slab shares, nullptr if this slab owns its device buffers
+	int program_shift_z = 0; // out-of-core: all slabs run the OpenCL C program of the first slab, whose z-offset is compiled in, so positions in kernels are shifted by this many lattice points
 
 	void allocate(Device& device); // allocate all memory for data fields on host and device and set up kernels
 	string device_defines() const; // returns preprocessor constants for embedding in OpenCL C code
+	template<typename Function> void for_each_state_field(Function function); // call function(memory, device_only, ddf, first, dimensions) for every field that makes up the simulation state, always in the same order, split DDF fields are passed buffer by buffer with the first dimension of the buffer and the total dimensions of the field
+	bool ddf_tiled() const; // DDFs are stored in tiles (DDF_BRICK layout or ORDER_MORTON ordering), rows of lattice points are not contiguous
+	uint3 brick_size() const; // lattice points per DDF brick/tile in x/y/z
+	uint stream_collide_vector_width(const Device_Info& device_info) const; // lattice points per work-item in stream_collide, rows are split into vector-wide segments on OpenCL CPU devices
+	bool use_boundary_lists(const Device_Info& device_info) const; // boundary lattice points are kept in a list and stream_collide skips their branches, only for the scalar OpenCL kernel
+	void update_boundary_list(); // collect the lattice points that need boundary branches into boundary_list
+	void update_neighbor_masks(); // mark solid neighbors of every lattice point in solid_neighbors
+	bool surface_worklist() const; // surface_1 and surface_2 only visit lattice points with flag changes from surface_list
+	uint surface_list_capacity() const; // maximum number of lattice points in surface_list
+	uint ddf_group(const Device_Info& device_info, const uint q) const; // DDF directions per device buffer for a DDF field with q directions, fields above the maximum buffer size of the device are split into several buffers
+	void allocate_ddfs(Device& device, Memory<fpxx>& f, vector<Memory<fpxx>>& f_split, const uint q, const uint group); // allocate a DDF field with q directions as buffer 0 in f and the remaining buffers in f_split
+	ulong index_ddf(const ulong n, const uint i, const uint q) const; // host version of index_f()/index_g() in kernel.cpp for DDF fields with q directions
 
 public:
 	Memory<float> rho; // density of every node
@@ -83,18 +124,25 @@ public:
 	Memory<float> particles; // particle positions
 // #endif // PARTICLES
 
+	Memory<uint> active_cells; // number of active (not solid and not gas) nodes in every local x, y and z plane, only allocated with dynamic domain repartitioning
+
 	Memory<char> transfer_buffer_p, transfer_buffer_m; // transfer buffers for multi-device domain communication, only allocate one set of transfer buffers in plus/minus directions, for all x/y/z transfers
 	Kernel kernel_transfer[enum_transfer_field::enum_transfer_field_length][2]; // for each field one extract and one insert kernel
 	void allocate_transfer(Device& device); // allocate all memory for multi-device transfer
 	ulong get_area(const uint direction);
 	void enqueue_transfer_extract_field(Kernel& kernel_transfer_extract_field, const uint direction, const uint bytes_per_cell);
 	void enqueue_transfer_insert_field(Kernel& kernel_transfer_insert_field, const uint direction, const uint bytes_per_cell);
+	void enqueue_transfer_insert_field(Kernel& kernel_transfer_insert_field, const uint direction, const uint bytes_per_cell, const ulong t); // insert halo data that was extracted at time step t
 
-	LBM_Domain(const Device_Info& device_info, const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz, const int Ox, const int Oy, const int Oz, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho); // compiles OpenCL C code and allocates memory
+	LBM_Domain(const Device_Info& device_info, const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz, const int Ox, const int Oy, const int Oz, const uint Gx, const uint Gy, const uint Gz, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho, const LBM_Domain* resident=nullptr, const LBM_Domain* first_slab=nullptr); // compiles OpenCL C code and allocates memory, out-of-core slabs pass the resident slab whose device buffers they share and the first slab whose program they share
 
 	void enqueue_initialize(); // write all data fields to device and call kernel_initialize
 	void enqueue_stream_collide(); // call kernel_stream_collide to perform one LBM time step
+	void invalidate_boundary_list(); // flags have changed in device memory, the boundary list is rebuilt before the next time step
+	void invalidate_flags(); // flags including solids may have changed in device memory, the boundary list and neighbor masks are rebuilt before the next time step
 	void enqueue_update_fields(); // update fields (rho, u, T) manually
+	bool temporal_blocking() const; // the domain can advance several time steps in one pass over the lattice
+	void enqueue_stream_collide_tiles(const uint steps); // call kernel_stream_collide_tiles to perform steps LBM time steps at once
 // #ifdef SURFACE
 	void enqueue_surface_0();
 	void enqueue_surface_1();
@@ -111,6 +159,13 @@ public:
 	void enqueue_integrate_particles(const uint time_step_multiplicator=1u); // intgegrates particles forward in time and couples particles to fluid
 // #endif // PARTICLES
 
+	void enqueue_count_active_cells(); // count active nodes in every x/y/z plane and read the counts into active_cells
+	void gather_state(vector<vector<char>>& state); // copy interior nodes of all fields, including device-only DDFs and mass, into global host arrays (one array per field)
+	void scatter_state(const vector<vector<char>>& state, const ulong t); // fill all fields including halo nodes from global host arrays, write them to device and continue at time step t
+	void enqueue_slab_upload(); // out-of-core: write all state fields of this slab from host memory into its device buffers
+	void enqueue_slab_download(); // out-of-core: read all state fields of this slab from its device buffers back into host memory
+	void enqueue_slab_insert_fi(); // out-of-core: insert the DDF halo that was extracted in the previous time step, right before the next stream_collide
+
 	void increment_time_step(const uint steps=1u); // increment time step
 	void reset_time_step(); // reset time step
 	void finish_queue();
@@ -120,10 +175,15 @@ public:
 	uint get_Ny() const { return Ny; } // get (local) lattice dimensions in y-direction
 	uint get_Nz() const { return Nz; } // get (local) lattice dimensions in z-direction
 	ulong get_N() const { return (ulong)Nx*(ulong)Ny*(ulong)Nz; } // get (local) number of lattice points
+	bool index64() const { return get_N()>=(ulong)max_uint; } // lattice point indices don't fit into 32 bits, kernels are compiled with 64-bit indexing
+	uint index_words() const { return index64() ? 2u : 1u; } // uint words per lattice point index in boundary_list and surface_list
 	uint get_Dx() const { return Dx; } // get lattice domains in x-direction
 	uint get_Dy() const { return Dy; } // get lattice domains in y-direction
 	uint get_Dz() const { return Dz; } // get lattice domains in z-direction
 	uint get_D() const { return Dx*Dy*Dz; } // get number of lattice domains
+	int get_Ox() const { return Ox; } // get lattice domain offset in x-direction
+	int get_Oy() const { return Oy; } // get lattice domain offset in y-direction
+	int get_Oz() const { return Oz; } // get lattice domain offset in z-direction
 	float get_nu() const { return nu; } // get kinematic shear viscosity
 	float get_tau() const { return 3.0f*get_nu()+0.5f; } // get LBM relaxation time
 	float get_fx() const { return fx; } // get global froce per volume
@@ -208,17 +268,38 @@ class LBM {
 private:
 	uint Nx=1u, Ny=1u, Nz=1u; // (global) lattice dimensions
 	uint Dx=1u, Dy=1u, Dz=1u; // lattice domains
+	vector<uint> Sx, Sy, Sz; // domain split positions, domains with index dx cover global x-coordinates Sx[dx] to Sx[dx+1]-1, domains can have different sizes
+	vector<float> weights; // relative throughput of the device of every domain
 	bool initialized = false; // becomes true after LBM::initialize() has been called
+	HaloTransport* transport = nullptr; // exchanges halo data with the domains of other processes, nullptr if all domains are in this process
+	char* halo_buffer = nullptr; // receive buffer for halo data from other processes, swapped into the transfer buffers like in the CPU pointer swaps
+	uint D0=0u, D1=1u; // this process owns domains D0 to D1-1, lbm[d] is nullptr for all other domains
+	bool halo_rho_u_flags_stale = false; // rho/u/flags halo data is outdated after stream_collide, it is only exchanged once it is needed
+	uint resident_slabs = 0u; // out-of-core: number of z-slabs that own device buffers, all other slabs take turns using them, 0 if the whole lattice is in device memory
+	bool slab_halo_pending = false; // out-of-core: the DDF halo of the last time step is exchanged, but not yet inserted into the slabs in host memory
+	ulong t_slabs_updated = max_ulong; // out-of-core: time step at which rho/u of all slabs were last updated from the DDFs
+	vector<char> export_scratch; // host buffer shared by all fields for writing exports in pieces
 
 	void sanity_checks_constructor(const vector<Device_Info>& device_infos, const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho); // sanity checks on grid resolution and extension support
 	void sanity_checks_initialization(); // sanity checks during initialization on used extensions based on used flags
 	void initialize(); // write all data fields to device and call kernel_initialize
 	void do_time_step(); // call kernel_stream_collide to perform one LBM time step
+	void do_time_steps_tiled(const uint steps); // perform steps LBM time steps in one pass over the lattice (temporal blocking)
+	void repartition(); // count active nodes in all domains and move domain boundaries if the load is too uneven
+	void link_memory_containers(); // (re-)link host Memory_Container objects to the buffers of all domains
+	uint get_domain_process(const uint d) const; // returns the rank of the process that owns domain d
+	void allocate_transfer_host_buffers(); // give all host transfer buffers the same size, as they are swapped between domains
+	void release_host_mirrors(); // with lazy host mirrors, free the host buffers of all fields that also live in device memory
+	template<typename Function> void cycle_slabs(Function function); // out-of-core: stream all slabs through the device, call function(d) between upload and download of slab d
+	void initialize_slabs(); // out-of-core version of initialize()
+	void do_time_step_slabs(); // out-of-core version of do_time_step()
 
 	void communicate_field(const enum_transfer_field field, const uint bytes_per_cell);
+	void exchange_transfer_buffers(const uint direction, const uint bytes_per_cell); // hand the extracted halo data in host memory over to the neighboring domains
 
 	void communicate_fi();
 	void communicate_rho_u_flags();
+	void update_halo_rho_u_flags(); // exchange rho/u/flags halo data only if it is outdated
 // #ifdef SURFACE
 	void communicate_flags();
 	void communicate_phi_massex_flags();
@@ -246,12 +327,22 @@ public:
 			const ulong global_i = i%N;
 			const ulong NxNy=(ulong)Nx*(ulong)Ny, t=global_i%NxNy;
 			const uint x=(uint)(t%(ulong)Nx), y=(uint)(t/(ulong)Nx), z=(uint)(global_i/NxNy); // n = x+(y+z*Ny)*Nx
-			const uint NxDx=Nx/Dx, NyDy=Ny/Dy, NzDz=Nz/Dz;
-			const uint px=x%NxDx, py=y%NyDy, pz=z%NzDz, dx=x/NxDx, dy=y/NyDy, dz=z/NzDz, domain=dx+(dy+dz*Dy)*Dx;
-			const uint Hx=Dx>1u, Hy=Dy>1u, Hz=Dz>1u; // halo offsets
+			uint dx=0u, dy=0u, dz=0u; // find domain, domains can have different sizes
+			while(x>=lbm->Sx[dx+1u]) dx++;
+			while(y>=lbm->Sy[dy+1u]) dy++;
+			while(z>=lbm->Sz[dz+1u]) dz++;
+			const uint NxDx=lbm->Sx[dx+1u]-lbm->Sx[dx], NyDy=lbm->Sy[dy+1u]-lbm->Sy[dy], NzDz=lbm->Sz[dz+1u]-lbm->Sz[dz]; // domain size without halo
+			const uint px=x-lbm->Sx[dx], py=y-lbm->Sy[dy], pz=z-lbm->Sz[dz], domain=dx+(dy+dz*Dy)*Dx;
+			const uint W=halo_width(), Hx=(Dx>1u)*W, Hy=(Dy>1u)*W, Hz=(Dz>1u)*W; // halo offsets
 			const ulong local_N = (ulong)(NxDx+2u*Hx)*(ulong)(NyDy+2u*Hy)*(ulong)(NzDz+2u*Hz); // add halo offsets
 			const ulong local_i = (ulong)(px+Hx)+((ulong)(py+Hy)+(ulong)(pz+Hz)*(ulong)(NyDy+2u*Hy))*(ulong)(NxDx+2u*Hx); // add halo offsets
 			const ulong local_dimension = max(i/N, (ulong)dimension);
+			if(buffers[domain]==nullptr) { // domain belongs to another process: reads return zero and writes are dropped, so all processes can run the same setup
+				thread_local T remote; // every thread of a parallel_for() setup loop has its own dummy, so no thread sees another thread's dropped write
+				remote = (T)0;
+				return remote;
+			}
+			buffers[domain]->restore_host_buffer(); // released host mirror, read it back on first host access, only one thread does this while the others wait
 			return buffers[domain]->data()[local_i+local_dimension*local_N]; // array of structures
 		}
 		inline static string vtk_type() {
@@ -273,19 +364,22 @@ public:
 				"SPACING "+to_string(spacing)+" "+to_string(spacing)+" "+to_string(spacing)+"\n"
 				"POINT_DATA "+to_string((ulong)Nx*(ulong)Ny*(ulong)Nz)+"\nSCALARS data "+vtk_type()+" "+to_string(dimensions())+"\nLOOKUP_TABLE default\n"
 			;
-			T* data = new T[range()];
-			for(uint d=0u; d<dimensions(); d++) {
-				for(ulong i=0ull; i<length(); i++) {
-					data[i*(ulong)dimensions()+(ulong)d] = reverse_bytes(reference(i, d)); // SoA <- AoS
-				}
-			}
+			const ulong chunk = max((ulong)1u, min(length(), (ulong)16777216u/((ulong)dimensions()*(ulong)sizeof(T)))); // lattice points per piece, the data is written in pieces of up to 16 MB through the shared scratch buffer of LBM
+			T* data = (T*)lbm->get_export_scratch(chunk*(ulong)dimensions()*(ulong)sizeof(T));
 			const string filename = create_file_extension(path, ".vtk");
 			create_folder(filename);
 			std::ofstream file(filename, std::ios::out|std::ios::binary);
 			file.write(header.c_str(), header.length()); // write non-binary file header
-			file.write((char*)data, capacity()); // write binary data
+			for(ulong i0=0ull; i0<length(); i0+=chunk) {
+				const ulong n = min(chunk, length()-i0);
+				for(uint d=0u; d<dimensions(); d++) {
+					for(ulong i=0ull; i<n; i++) {
+						data[i*(ulong)dimensions()+(ulong)d] = reverse_bytes(reference(i0+i, d)); // SoA <- AoS
+					}
+				}
+				file.write((char*)data, n*(ulong)dimensions()*(ulong)sizeof(T)); // write binary data
+			}
 			file.close();
-			delete[] data;
 			info.allow_rendering = false; // temporarily disable interactive rendering
 			print_info("File \""+filename+"\" saved.");
 			info.allow_rendering = true;
@@ -297,7 +391,11 @@ public:
 					data[i*(ulong)dimensions()+(ulong)d] = reverse_bytes(reference(i, d)); // SoA <- AoS
 				}
 			}*/
-			int nn = lbm->get_N();
+			if(lbm->get_N()>(ulong)max_int) { // the COO format stores 32-bit signed indices
+				print_warning("File \""+path+"\" not saved, sparse arrays are limited to 2^31 lattice points.");
+				return;
+			}
+			const int nn = (int)lbm->get_N();
 			int* idxs = (int*)std::malloc(nn * sizeof(int));
 			float* vals = float_alloc(nn);
 			int nnz = 0;
@@ -331,12 +429,13 @@ public:
 			this->buffers = buffers;
 			this->name = name;
 			this->N = (ulong)this->Nx*(ulong)this->Ny*(ulong)this->Nz;
-			this->d = buffers[0]->dimensions();
+			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) if(buffers[domain]!=nullptr) { this->d = buffers[domain]->dimensions(); break; } // some domains may belong to other processes
 			if(this->N*(ulong)this->d==0ull) print_error("Memory size must be larger than 0.");
 			initialize_auxiliary_pointers();
 		}
 		inline Memory_Container() {} // default constructor
 		inline Memory_Container& operator=(Memory_Container&& memory) noexcept { // move assignment
+			if(this->buffers!=memory.buffers) delete[] this->buffers; // buffer list is owned by the container, the buffers themselves belong to LBM_Domain
 			this->lbm = memory.lbm;
 			this->Nx = memory.Nx; this->Ny = memory.Ny; this->Nz = memory.Nz;
 			this->Dx = memory.Dx; this->Dy = memory.Dy; this->Dz = memory.Dz;
@@ -349,7 +448,9 @@ public:
 		}
 		inline void reset(const T value=(T)0) {
 			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) {
-				for(ulong i=0ull; i<range()/(ulong)(Dx*Dy*Dz); i++) buffers[domain][i] = value;
+				if(buffers[domain]==nullptr) continue;
+				buffers[domain]->ensure_host_buffer(); // all values are overwritten, so a released host mirror doesn't have to be read back
+				for(ulong i=0ull; i<buffers[domain]->range(); i++) (*buffers[domain])[i] = value;
 			}
 			write_to_device();
 		}
@@ -362,18 +463,26 @@ public:
 		inline const T operator()(const ulong i) const { return reference(i, 0u); }
 		inline const T operator()(const ulong i, const uint dimension) const { return reference(i, dimension); } // array of structures
 		inline void read_from_device() {
+			if(lbm->out_of_core()) { // host memory holds the lattice and is up-to-date after every pass over the slabs, only rho/u may have to be computed from the DDFs
+				lbm->update_fields();
+				return;
+			}
 // #ifndef UPDATE_FIELDS
 			if (!fx3d::Settings::IsFeatureEnabled(fx3d::Feature::UPDATE_FIELDS))
 			{
-				for(uint domain=0u; domain<Dx*Dy*Dz; domain++) lbm->lbm[domain]->enqueue_update_fields(); // make sure data in device memory is up-to-date
+				for(uint domain=0u; domain<Dx*Dy*Dz; domain++) if(buffers[domain]!=nullptr) lbm->lbm[domain]->enqueue_update_fields(); // make sure data in device memory is up-to-date
 			}
 // #endif // UPDATE_FIELDS
-			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) buffers[domain]->enqueue_read_from_device();
-			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) buffers[domain]->finish_queue();
+			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) if(buffers[domain]!=nullptr) buffers[domain]->enqueue_read_from_device();
+			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) if(buffers[domain]!=nullptr) buffers[domain]->finish_queue();
 		}
 		inline void write_to_device() {
-			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) buffers[domain]->enqueue_write_to_device();
-			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) buffers[domain]->finish_queue();
+			if(lbm->out_of_core()) return; // slabs are uploaded from host memory in every pass
+			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) if(buffers[domain]!=nullptr) buffers[domain]->enqueue_write_to_device();
+			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) if(buffers[domain]!=nullptr) buffers[domain]->finish_queue();
+			if constexpr(std::is_same<T, uchar>::value) {
+				if(this==&lbm->flags) for(uint domain=0u; domain<Dx*Dy*Dz; domain++) if(buffers[domain]!=nullptr) lbm->lbm[domain]->invalidate_flags(); // new flags can change boundaries and solids
+			}
 		}
 		inline void write_host_to_vtk(const string& path="") { // write binary .vtk file
 			write_vtk(default_filename(path, name, ".vtk", lbm->get_t()));
@@ -381,6 +490,7 @@ public:
 		inline void write_device_to_vtk(const string& path="") { // write binary .vtk file
 			read_from_device();
 			write_host_to_vtk(path);
+			release_host_buffers();
 		}
 		inline void write_host_to_sparse(const string& path="") {
 			write_sparse_array(default_filename(path, name, ".dat", lbm->get_t()));
@@ -388,6 +498,12 @@ public:
 		inline void write_device_to_sparse(const string& path="") {
 			read_from_device();
 			write_host_to_sparse(path);
+			release_host_buffers();
+		}
+		inline void release_host_buffers() { // with lazy host mirrors, free the host buffers until the next host access or readback, the data stays in device memory
+			if(!fx3d::Settings::GetLazyHostMirrors()||lbm->out_of_core()) return; // out-of-core, host memory holds the only copy of the lattice
+			for(uint domain=0u; domain<Dx*Dy*Dz; domain++) if(buffers[domain]!=nullptr) buffers[domain]->release_host_buffer();
+			lbm->release_export_scratch();
 		}
 	};
 
@@ -410,6 +526,8 @@ public:
 // #endif // PARTICLES
 
 	LBM(const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz, const float nu, const float fx=0.0f, const float fy=0.0f, const float fz=0.0f, const float sigma=0.0f, const float alpha=0.0f, const float beta=0.0f, const uint particles_N=0u, const float particles_rho=0.0f); // compiles OpenCL C code and allocates memory
+	LBM(const uint Nx, const uint Ny, const uint Nz, const uint D, const float nu, const float fx=0.0f, const float fy=0.0f, const float fz=0.0f, const float sigma=0.0f, const float alpha=0.0f, const float beta=0.0f, const uint particles_N=0u, const float particles_rho=1.0f); // D domains with automatic decomposition, D=0 uses all suitable devices; compiles OpenCL C code and allocates memory
+	LBM(const uint3 N, const uint3 D, const float nu, const float fx=0.0f, const float fy=0.0f, const float fz=0.0f, const float sigma=0.0f, const float alpha=0.0f, const float beta=0.0f, const uint particles_N=0u, const float particles_rho=1.0f); // compiles OpenCL C code and allocates memory
 	LBM(const uint Nx, const uint Ny, const uint Nz, const float nu, const float fx=0.0f, const float fy=0.0f, const float fz=0.0f, const float sigma=0.0f, const float alpha=0.0f, const float beta=0.0f, const uint particles_N=0u, const float particles_rho=1.0f); // compiles OpenCL C code and allocates memory
 	LBM(const uint Nx, const uint Ny, const uint Nz, const float nu, const uint particles_N, const float particles_rho=1.0f); // compiles OpenCL C code and allocates memory
 	LBM(const uint Nx, const uint Ny, const uint Nz, const float nu, const float fx, const float fy, const float fz, const uint particles_N, const float particles_rho=1.0f); // compiles OpenCL C code and allocates memory
@@ -443,20 +561,26 @@ public:
 	uint get_Dy() const { return Dy; } // get lattice domains in y-direction
 	uint get_Dz() const { return Dz; } // get lattice domains in z-direction
 	uint get_D() const { return Dx*Dy*Dz; } // get number of lattice domains
-	float get_nu() const { return lbm[0]->get_nu(); } // get kinematic shear viscosity
+	bool out_of_core() const { return resident_slabs>0u; } // the lattice lives in host memory and its z-slabs are streamed through the device
+	char* get_export_scratch(const ulong bytes) { if((ulong)export_scratch.size()<bytes) export_scratch.resize(bytes); return export_scratch.data(); } // shared host buffer for writing exports in pieces
+	void release_export_scratch() { vector<char>().swap(export_scratch); } // free the export scratch buffer
+	uint get_domain_Nx(const uint dx) const { return Sx[dx+1u]-Sx[dx]; } // get lattice dimensions in x-direction of domains with index dx (without halo)
+	uint get_domain_Ny(const uint dy) const { return Sy[dy+1u]-Sy[dy]; } // get lattice dimensions in y-direction of domains with index dy (without halo)
+	uint get_domain_Nz(const uint dz) const { return Sz[dz+1u]-Sz[dz]; } // get lattice dimensions in z-direction of domains with index dz (without halo)
+	float get_nu() const { return lbm[D0]->get_nu(); } // get kinematic shear viscosity
 	float get_tau() const { return 3.0f*get_nu()+0.5f; } // get LBM relaxation time
 	float get_Re_max() const { return 0.57735027f*(float)min(min(Nx, Ny), Nz)/get_nu(); } // Re < c*L/nu
-	float get_fx() const { return lbm[0]->get_fx(); } // get global froce per volume
-	float get_fy() const { return lbm[0]->get_fy(); } // get global froce per volume
-	float get_fz() const { return lbm[0]->get_fz(); } // get global froce per volume
-	float get_sigma() const { return lbm[0]->get_sigma(); } // get surface tension coefficient
-	float get_alpha() const { return lbm[0]->get_alpha(); } // get thermal diffusion coefficient
-	float get_beta() const { return lbm[0]->get_beta(); } // get thermal expansion coefficient
-	ulong get_t() const { return lbm[0]->get_t(); } // get discrete time step in LBM units
-	uint get_velocity_set() const { return lbm[0]->get_velocity_set(); }
-	void set_fx(const float fx) { for(uint d=0u; d<get_D(); d++) lbm[d]->set_fx(fx); } // set global froce per volume
-	void set_fy(const float fy) { for(uint d=0u; d<get_D(); d++) lbm[d]->set_fy(fy); } // set global froce per volume
-	void set_fz(const float fz) { for(uint d=0u; d<get_D(); d++) lbm[d]->set_fz(fz); } // set global froce per volume
+	float get_fx() const { return lbm[D0]->get_fx(); } // get global froce per volume
+	float get_fy() const { return lbm[D0]->get_fy(); } // get global froce per volume
+	float get_fz() const { return lbm[D0]->get_fz(); } // get global froce per volume
+	float get_sigma() const { return lbm[D0]->get_sigma(); } // get surface tension coefficient
+	float get_alpha() const { return lbm[D0]->get_alpha(); } // get thermal diffusion coefficient
+	float get_beta() const { return lbm[D0]->get_beta(); } // get thermal expansion coefficient
+	ulong get_t() const { return lbm[D0]->get_t(); } // get discrete time step in LBM units
+	uint get_velocity_set() const { return lbm[D0]->get_velocity_set(); }
+	void set_fx(const float fx) { for(uint d=D0; d<D1; d++) lbm[d]->set_fx(fx); } // set global froce per volume
+	void set_fy(const float fy) { for(uint d=D0; d<D1; d++) lbm[d]->set_fy(fy); } // set global froce per volume
+	void set_fz(const float fz) { for(uint d=D0; d<D1; d++) lbm[d]->set_fz(fz); } // set global froce per volume
 	void set_f(const float fx, const float fy, const float fz) { set_fx(fx); set_fy(fy); set_fz(fz); } // set global froce per volume
 
 	void coordinates(const ulong n, uint& x, uint& y, uint& z) const { // disassemble 1D linear index to 3D coordinates (n -> x,y,z)
@@ -41,6 +41,9 @@ protected:
 
     /* Simulation parameters */
 	uint Nx = 1u, Ny = 1u, Nz = 1u;
+	uint Dx = 1u, Dy = 1u, Dz = 1u;
+	bool auto_domains = false; // choose Dx/Dy/Dz automatically for the given number of domains
+	uint domains = 0u; // number of domains for automatic decomposition, 0 uses all suitable devices
 	float nu = 1.0f/6.0f, sigma = 0.0f, alpha = 0.0f, beta = 0.0f;
 	float fx = 0.0f, fy = 0.0f, fz = 0.0f;
 	uint particles_N = 0u;
@@ -49,6 +49,22 @@ enum DDFCompression
     // NONE
 };
 
+enum DDFLayout
+{
+    // structure of arrays, every DDF direction is one contiguous array over all lattice points; (default)
+    DDF_SOA,
+    // array of structures of arrays, all DDFs of a 4x4x4 brick of lattice points are contiguous; better cache and TLB locality on CPUs
+    DDF_BRICK
+};
+
+enum DDFOrdering
+{
+    // lattice points in DDF storage follow the linear index n = x+(y+z*Ny)*Nx; (default)
+    ORDER_LINEAR,
+    // lattice points in DDF storage follow a Morton (Z-order) curve within 4x4x4 tiles, so neighbors in all three directions are close in memory
+    ORDER_MORTON
+};
+
 enum Feature
 {
     // enables global force per volume in one direction (equivalent to a pressure gradient); specified in the LBM class constructor; the force can be changed on-the-fly between time steps at no performance cost
@@ -71,6 +87,44 @@ enum Feature
     UPDATE_FIELDS = 256
 };
 
+enum DomainBalancing
+{
+    // split the lattice into domains of equal size, truncating the resolution to be divisible by Dx/Dy/Dz; (default)
+    UNIFORM,
+    // size domains proportionally to the estimated FP32 performance of their devices (Device_Info::tflops)
+    TFLOPS,
+    // size domains proportionally to the memory bandwidth of their devices, measured with a short copy benchmark at startup
+    BANDWIDTH
+};
+
+enum HaloCompression
+{
+    // transfer halo data between domains in full precision; (default)
+    HALO_NONE,
+    // pack rho/u into range-scaled FP16 (9 instead of 17 Bytes/cell); DDFs are sent as they are stored, so they stay lossless; phi/massex stay FP32 for mass conservation
+    HALO_FP16,
+    // like HALO_FP16, and additionally pack FP32 DDFs into the scaled FP16 format of FP16S; lossy, adds FP16 rounding of the DDFs at every domain boundary in every exchange
+    HALO_FP16_DDF
+};
+
+enum HostPages
+{
+    // allocate host buffers with the default page size of the OS; (default)
+    PAGES_DEFAULT,
+    // back host buffers of 2 MB and more with transparent huge pages through madvise(MADV_HUGEPAGE), fewer TLB misses on large lattices (Linux only)
+    PAGES_TRANSPARENT,
+    // take host buffers of 2 MB and more from the reserved huge page pool with MAP_HUGETLB, falls back to transparent huge pages if the pool is exhausted (Linux only)
+    PAGES_HUGETLB
+};
+
+enum ProcessTransport
+{
+    // exchange halo data between processes on the same node through ring buffers in POSIX shared memory; (default)
+    TRANSPORT_SHM,
+    // exchange halo data between processes over TCP sockets, works across nodes and over loopback
+    TRANSPORT_TCP
+};
+
 
 
 /**
@@ -84,7 +138,32 @@ private:
     static VelocitySet m_VSet;      // fx3d::VelocitySet::D3Q19
     static CollisionType m_CollType;       // fx3d::CollisionType::SRT
     static DDFCompression m_Compr;  // fx3d::DDFCompression::FP16S
+    static DDFLayout m_DDFLayout;
+    static DDFOrdering m_DDFOrdering;
     static Feature m_Features;
+    static DomainBalancing m_Balancing;
+    static unsigned int m_RepartitionPeriod;
+    static float m_RepartitionThreshold;
+    static HaloCompression m_HaloCompression;
+    static unsigned int m_HaloExchangePeriod;
+    static bool m_NativeBackend;
+    static unsigned int m_TemporalBlocking;
+    static bool m_BoundaryLists;
+    static bool m_NeighborMasks;
+    static bool m_OutOfCore;
+    static unsigned int m_DeviceMemoryLimit;
+    static unsigned int m_DeviceArena;
+    static bool m_LazyHostMirrors;
+    static HostPages m_HostPages;
+    static bool m_NumaPlacement;
+    static bool m_ParallelFirstTouch;
+    static bool m_DeviceFission;
+    static unsigned int m_ProcessRank;
+    static unsigned int m_ProcessCount;
+    static ProcessTransport m_Transport;
+    static std::string m_TransportHosts;
+    static unsigned int m_TransportPort;
+    static std::string m_TransportSession;
 
     static unsigned int m_VSetSize;
     static unsigned int m_VSetDims;
@@ -105,10 +184,84 @@ public:
 
     static DDFCompression GetDDFCompression();
     static void SetDDFCompression(DDFCompression Compression);
+    // memory layout of the DDFs in device memory; bricks shrink to 2 or 1 lattice points along axes where the domain size is not divisible by 4 (default DDF_SOA)
+    static DDFLayout GetDDFLayout();
+    static void SetDDFLayout(DDFLayout Layout);
+    // order of lattice points in DDF storage; only affects DDFs in device memory, all other fields and host access keep the linear index (default ORDER_LINEAR)
+    static DDFOrdering GetDDFOrdering();
+    static void SetDDFOrdering(DDFOrdering Ordering);
     
     static void EnableFeature(Feature Feat);
     static void DisableFeature(Feature Feat);
     static bool IsFeatureEnabled(Feature Feat);
+
+    static DomainBalancing GetDomainBalancing();
+    static void SetDomainBalancing(DomainBalancing Balancing);
+
+    // count active (not solid and not gas) nodes every Steps time steps and move domain boundaries if the load is uneven; 0 disables repartitioning (default)
+    static unsigned int GetRepartitionPeriod();
+    static void SetRepartitionPeriod(unsigned int Steps);
+    // relative load imbalance (slowest domain vs. average) that has to be exceeded before domain boundaries are moved; avoids rebuilding domains for small fluctuations (default 0.1)
+    static float GetRepartitionThreshold();
+    static void SetRepartitionThreshold(float Imbalance);
+
+    static HaloCompression GetHaloCompression();
+    static void SetHaloCompression(HaloCompression Compression);
+    // exchange halos between domains only every Steps time steps; domains then carry Steps+1 halo layers and recompute the inner ones locally in between (default 1, every time step with a single halo layer)
+    static unsigned int GetHaloExchangePeriod();
+    static void SetHaloExchangePeriod(unsigned int Steps);
+    // run on the native multithreaded C++ CPU backend instead of OpenCL devices when devices are auto-selected; it can also be selected by its device ID, which comes after all OpenCL devices (default false)
+    static bool GetNativeBackend();
+    static void SetNativeBackend(bool Enable);
+    // advance tiles of the lattice by Steps time steps in one pass while they stay in cache (temporal blocking); only for a single domain on the native CPU backend without FORCE_FIELD, SURFACE, TEMPERATURE and PARTICLES (default 1, off)
+    static unsigned int GetTemporalBlocking();
+    static void SetTemporalBlocking(unsigned int Steps);
+    // keep lists of the lattice points with equilibrium/moving/temperature boundaries, compute them in a separate kernel and let stream_collide skip their branches for all other lattice points; only for the scalar OpenCL kernel, the lists are rebuilt whenever flags change (default false)
+    static bool GetBoundaryLists();
+    static void SetBoundaryLists(bool Enable);
+    // store a 32-bit mask of solid neighbors for every lattice point with MOVING_BOUNDARIES, so moving boundaries read one word instead of the flags of all neighbors; costs 4 Bytes per lattice point and is rebuilt whenever solids change, not used on the native CPU backend (default false)
+    static bool GetNeighborMasks();
+    static void SetNeighborMasks(bool Enable);
+    // keep the lattice in host memory and stream its Dz domains as z-slabs through one device, which only holds up to 3 slabs at a time; for lattices larger than device memory, only for Dx=Dy=1 on an OpenCL device in a single process, without FORCE_FIELD, SURFACE, TEMPERATURE and PARTICLES (default false)
+    static bool GetOutOfCore();
+    static void SetOutOfCore(bool Enable);
+    // pretend that devices have at most MB of memory, to test out-of-core runs and memory-dependent decisions on devices with more memory; 0 uses the real device memory (default 0)
+    static unsigned int GetDeviceMemoryLimit();
+    static void SetDeviceMemoryLimit(unsigned int MB);
+    // allocate device memory in blocks of BlockMB MB and hand out aligned sub-buffers for all fields, freed ranges are reused by later allocations like voxelization buffers; fields larger than a block get their own buffer; 0 gives every field its own device buffer (default 0)
+    static unsigned int GetDeviceArena();
+    static void SetDeviceArena(unsigned int BlockMB);
+    // free the host copies of rho, u, flags, F, phi and T once they are in device memory, they are allocated again on the next host access or read_from_device() and freed again after write_device_to_vtk(); keeps host memory free during long runs on large GPUs (default false)
+    static bool GetLazyHostMirrors();
+    static void SetLazyHostMirrors(bool Enable);
+    // page size of host buffers, also of the lattice itself on the native CPU backend (default PAGES_DEFAULT)
+    static HostPages GetHostPages();
+    static void SetHostPages(HostPages Pages);
+    // bind the host buffers of domain d of D to NUMA node d*Nodes/D, so on multi-socket machines every domain keeps its data on one socket; Linux only, ignored on single-node machines (default false)
+    static bool GetNumaPlacement();
+    static void SetNumaPlacement(bool Enable);
+    // initialize host buffers of 2 MB and more on the native CPU backend threads with the same lattice ranges the native kernels use, so first-touch placement spreads the pages over the NUMA nodes of the threads that compute on them (default false)
+    static bool GetParallelFirstTouch();
+    static void SetParallelFirstTouch(bool Enable);
+    // split an OpenCL CPU device that runs several domains into one sub-device per NUMA node with clCreateSubDevices(), so every domain runs on the cores and memory of one socket; automatic domain selection then counts every node as a device (default false)
+    static bool GetDeviceFission();
+    static void SetDeviceFission(bool Enable);
+
+    // split the domains of one LBM across Count processes, every process runs the same setup with its own Rank and owns a contiguous block of domains (default 0 of 1)
+    static unsigned int GetProcessRank();
+    static unsigned int GetProcessCount();
+    static void SetProcesses(unsigned int Rank, unsigned int Count);
+    static ProcessTransport GetTransport();
+    static void SetTransport(ProcessTransport Transport);
+    // comma-separated host names or IP addresses of all ranks for TRANSPORT_TCP; a single entry is used for all ranks (default "127.0.0.1")
+    static std::string GetTransportHosts();
+    static void SetTransportHosts(const std::string& Hosts);
+    // rank r listens on Port+r for TRANSPORT_TCP (default 47000)
+    static unsigned int GetTransportPort();
+    static void SetTransportPort(unsigned int Port);
+    // name prefix of the shared memory segments for TRANSPORT_SHM, has to be unique for simultaneous runs on the same node (default "fx3d")
+    static std::string GetTransportSession();
+    static void SetTransportSession(const std::string& Session);
 };
 
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <utils/utilities.hpp>
+
+namespace fx3d
+{
+
+class HaloTransport { // moves halo data between processes, each process owns a contiguous block of the domains of one LBM
+protected:
+	uint rank=0u, size=1u; // rank of this process and total number of processes
+public:
+	virtual ~HaloTransport() {}
+	uint get_rank() const { return rank; }
+	uint get_size() const { return size; }
+	virtual void exchange(const uint peer, const void* send, void* receive, const ulong bytes) = 0; // send bytes to peer and receive the same number of bytes from peer, both directions progress at the same time, so two processes exchanging with each other never deadlock
+	void barrier(); // all processes wait until every process has arrived
+	void sum(vector<float>& values); // adds up values element-wise over all processes, every process gets the same result
+};
+
+class SharedMemoryTransport : public HaloTransport { // one single-producer/single-consumer ring buffer in POSIX shared memory per ordered pair of processes, for processes on the same node
+private:
+	struct Ring;
+	vector<Ring*> rings_send, rings_receive; // indexed by peer rank, nullptr for this process
+	vector<string> names_receive; // shared memory names of the rings this process has created and unlinks again
+	ulong capacity = 0ull; // ring buffer size in Bytes
+public:
+	SharedMemoryTransport(const uint rank, const uint size, const string& session, const ulong capacity=16ull*1048576ull);
+	~SharedMemoryTransport();
+	void exchange(const uint peer, const void* send, void* receive, const ulong bytes) override;
+};
+
+class SocketTransport : public HaloTransport { // one TCP connection per pair of processes, rank r listens on port+r and connects to all lower ranks
+private:
+	vector<int> sockets; // indexed by peer rank, -1 for this process
+public:
+	SocketTransport(const uint rank, const uint size, const vector<string>& hosts, const uint port);
+	~SocketTransport();
+	void exchange(const uint peer, const void* send, void* receive, const ulong bytes) override;
+};
+
+HaloTransport* create_transport(); // returns the transport selected in Settings, or nullptr if the simulation runs in a single process
+
+}
@@ -1,16 +1,101 @@
 #pragma once
 
 #define WORKGROUP_SIZE 64 // needs to be 64 to fully use AMD GPUs
+#define WORKGROUP_SHAPE uint3(16u, 4u, 1u) // workgroup shape for kernels on a 3D range over the lattice, WORKGROUP_SIZE work-items: 16 along x for coalesced memory access, 4 along y so neighbors in y are shared in cache
 //#define PTX
 //#define LOG
+//#define STRICT_MATH // compile OpenCL C code with IEEE-754 compliant arithmetic (no fast relaxed math, no FMA contraction, correctly rounded division), then FP32 results are bit-identical to the native C++ backend
 
 #ifndef _WIN32
 #pragma GCC diagnostic ignored "-Wignored-attributes" // ignore compiler warnings for CL/cl.hpp with g++
 #endif // _WIN32
 #include <CL/cl.hpp> // OpenCL 1.0, 1.1, 1.2
 #include <utils/utilities.hpp>
+#include <memory> // std::shared_ptr for the native CPU backend
+#include <cstring> // std::memcpy for the native CPU backend
+#include <functional> // std::function for the native CPU backend threads
+#include <mutex> // std::mutex for allocating released host buffers again from several threads
+#include <atomic> // std::atomic for the host buffer state that host access checks without locking
+#ifdef __linux__
+#include <sys/mman.h> // mmap() and madvise() for large host buffers
+#include <sys/syscall.h> // mbind() as a system call, without linking libnuma
+#include <unistd.h>
+#endif // Linux
 using cl::Event;
 
+struct Host_Memory_Policy { // how Memory allocates host buffers, applies to the host side of all buffers and to the device buffers of the native CPU backend
+	uint huge_pages = 0u; // 0: default pages, 1: transparent huge pages with madvise(), 2: pages from the reserved huge page pool with MAP_HUGETLB, falls back to 1 if the pool is exhausted
+	int numa_node = -1; // bind the pages of large buffers to this NUMA node, -1 leaves placement to the first touch
+	bool parallel_touch = false; // initialize new buffers on the native CPU backend threads, so with first-touch placement every page lands on the NUMA node of the thread that computes on it
+};
+void run_native_threads(const std::function<void(const uint, const uint)>& function); // implemented in native.cpp, runs function(thread index, number of threads) on the worker threads of the native CPU backend
+
+#define HOST_MEMORY_HEADER 64ull // Bytes in front of every host buffer that record how it was allocated
+#define HOST_MEMORY_LARGE 2097152ull // buffers of at least one huge page are mapped directly when a Host_Memory_Policy asks for it, smaller ones always come from malloc()
+inline uint get_numa_nodes() { // number of NUMA nodes of this machine, 1 if unknown
+#ifdef __linux__
+	std::ifstream file("/sys/devices/system/node/online"); // for example "0-1"
+	string online = "";
+	if(file>>online) {
+		const size_t i = online.find_last_of("-,");
+		return to_uint(i==string::npos ? online : online.substr(i+1u), 0u)+1u;
+	}
+#endif // Linux
+	return 1u;
+}
+inline void* host_allocate(const ulong bytes, const Host_Memory_Policy& policy) { // returns an uninitialized buffer that has to be freed with host_free(), Memory host buffers and all pointers exchanged with them come from here
+	ulong total = bytes+HOST_MEMORY_HEADER;
+	char* allocation = nullptr;
+	ulong mapped = 0ull;
+#ifdef __linux__
+	if(total>=HOST_MEMORY_LARGE&&(policy.huge_pages>0u||policy.numa_node>=0)) {
+		const ulong length = (total+HOST_MEMORY_LARGE-1ull)/HOST_MEMORY_LARGE*HOST_MEMORY_LARGE; // whole huge pages
+		void* pages = MAP_FAILED;
+		if(policy.huge_pages==2u) pages = mmap(nullptr, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if(pages==MAP_FAILED) {
+			pages = mmap(nullptr, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			if(pages!=MAP_FAILED&&policy.huge_pages>0u) madvise(pages, length, MADV_HUGEPAGE); // only a hint, the kernel may still use small pages
+		}
+		if(pages!=MAP_FAILED) {
+			if(policy.numa_node>=0&&policy.numa_node<64) { // pages are not touched yet, so the binding applies to all of them
+				const unsigned long mask = 1ul<<policy.numa_node;
+				syscall(SYS_mbind, pages, length, 2 /* MPOL_BIND */, &mask, (unsigned long)(8u*sizeof(mask)+1u), 0u); // if binding fails, the pages stay with first-touch placement
+			}
+			allocation = (char*)pages;
+			total = mapped = length;
+		}
+	}
+#endif // Linux
+	if(allocation==nullptr) allocation = (char*)std::malloc(total);
+	if(allocation==nullptr) print_error("Host memory allocation of "+to_string((uint)(bytes/1048576ull))+" MB failed.");
+	((ulong*)allocation)[0] = total; // header: total size of the allocation in Bytes and whether it is mapped
+	((ulong*)allocation)[1] = mapped;
+	return (void*)(allocation+HOST_MEMORY_HEADER);
+}
+inline void host_free(void* const buffer) {
+	if(buffer==nullptr) return;
+	char* const allocation = (char*)buffer-HOST_MEMORY_HEADER;
+#ifdef __linux__
+	if(((ulong*)allocation)[1]>0ull) {
+		munmap((void*)allocation, ((ulong*)allocation)[0]);
+		return;
+	}
+#endif // Linux
+	std::free((void*)allocation);
+}
+template<typename T> inline T* host_allocate(const ulong range, const Host_Memory_Policy& policy) {
+	return (T*)host_allocate(range*sizeof(T), policy);
+}
+template<typename T> inline void host_fill(T* const buffer, const ulong N, const uint d, const T value, const Host_Memory_Policy& policy) { // with parallel_touch, thread i fills lattice points N*i/T to N*(i+1)/T of every dimension, the same range it computes in native kernels
+	if(policy.parallel_touch&&N*(ulong)d*sizeof(T)>=HOST_MEMORY_LARGE) {
+		run_native_threads([&](const uint i, const uint threads) {
+			for(uint c=0u; c<d; c++) for(ulong n=N*(ulong)i/(ulong)threads; n<N*(ulong)(i+1u)/(ulong)threads; n++) buffer[(ulong)c*N+n] = value;
+		});
+	} else {
+		for(ulong i=0ull; i<N*(ulong)d; i++) buffer[i] = value;
+	}
+}
+
 struct Device_Info {
 	cl::Device cl_device; // OpenCL device
 	cl::Context cl_context; // multiple devices in the same context can communicate buffers
@@ -24,7 +109,11 @@ struct Device_Info {
 	uint compute_units=0u; // compute units (CUs) can contain multiple cores depending on the microarchitecture
 	uint clock_frequency=0u; // in MHz
 	bool is_cpu=false, is_gpu=false;
+	bool is_native=false; // pseudo-device that runs the kernels as multithreaded C++ code on the host CPU, without any OpenCL runtime
 	bool intel_gpu_above_4gb_patch = false; // memory allocations greater than 4GB need to be specifically enabled on Intel GPUs
+	uint memory_alignment=1u; // alignment of sub-buffer offsets in Bytes
+	uint arena_block=0u; // size in MB of the blocks of the device memory arena, 0 if every Memory allocates its own device buffer
+	Host_Memory_Policy host_policy; // huge pages, NUMA node and first touch for the host buffers of this device
 	uint is_fp64_capable=0u, is_fp32_capable=0u, is_fp16_capable=0u, is_int64_capable=0u, is_int32_capable=0u, is_int16_capable=0u, is_int8_capable=0u;
 	uint cores=0u; // for CPUs, compute_units is the number of threads (twice the number of cores with hyperthreading)
 	float tflops=0.0f; // estimated device FP32 floating point performance in TeraFLOPs/s
@@ -41,6 +130,7 @@ struct Device_Info {
 		local_cache = (uint)(cl_device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>()/1024ull); // local cache in KB
 		max_global_buffer = (uint)(cl_device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>()/1048576ull); // maximum global buffer size in MB
 		max_constant_buffer = (uint)(cl_device.getInfo<CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE>()/1024ull); // maximum constant buffer size in KB
+		memory_alignment = max((uint)cl_device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>()/8u, 1u); // reported in bits
 		compute_units = (uint)cl_device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>(); // compute units (CUs) can contain multiple cores depending on the microarchitecture
 		clock_frequency = (uint)cl_device.getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>(); // in MHz
 		is_fp64_capable = (uint)cl_device.getInfo<CL_DEVICE_NATIVE_VECTOR_WIDTH_DOUBLE>()*(uint)contains(cl_device.getInfo<CL_DEVICE_EXTENSIONS>(), "cl_khr_fp64");
@@ -78,6 +168,13 @@ struct Device_Info {
 };
 
 string get_opencl_c_code(); // implemented in kernel.hpp
+class Native_Program; // configuration of the kernels of the native CPU backend, read from the #define lines of the OpenCL C code
+Device_Info get_native_device_info(const uint id); // implemented in native.cpp
+float measure_native_memory_bandwidth(); // implemented in native.cpp
+Native_Program* create_native_program(const string& opencl_c_code); // implemented in native.cpp
+void delete_native_program(Native_Program* program); // implemented in native.cpp
+int get_native_kernel(const string& name); // implemented in native.cpp, returns -1 if there is no C++ implementation of the kernel
+void run_native_kernel(const Native_Program& program, const int kernel, const ulong N, const vector<void*>& buffers, const vector<ulong>& constants); // implemented in native.cpp, runs synchronously on all CPU threads
 inline void print_device_info(const Device_Info& d) { // print OpenCL device info
 	println("\r|----------------.------------------------------------------------------------|");
 	println("| Device ID      | "+alignl(58, to_string(d.id)        )+" |");
@@ -105,8 +202,9 @@ inline vector<Device_Info> get_devices(const bool print_info=true) { // returns
 		}
 	}
 	if((uint)cl_platforms.size()==0u||(uint)devices.size()==0u) {
-		print_error("There are no OpenCL devices available. Make sure that the OpenCL 1.2 Runtime for your device is installed. For GPUs it comes by default with the graphics driver, for CPUs it has to be installed separately.");
+		print_warning("There are no OpenCL devices available, only the native C++ CPU backend can be used. Make sure that the OpenCL 1.2 Runtime for your device is installed. For GPUs it comes by default with the graphics driver, for CPUs it has to be installed separately.");
 	}
+	devices.push_back(get_native_device_info(id++)); // native CPU backend always comes last, so OpenCL device IDs don't change
 	if(print_info) {
 		println("\r|----------------.------------------------------------------------------------|");
 		for(uint i=0u; i<(uint)devices.size(); i++) println("| Device ID "+alignr(4u, i)+" | "+alignl(58u, devices[i].name)+" |");
@@ -144,6 +242,141 @@ inline Device_Info select_device_with_id(const uint id, const vector<Device_Info
 		return devices[0]; // is never executed, just to avoid compiler warnings
 	}
 }
+inline vector<Device_Info> get_numa_sub_devices(const Device_Info& info) { // splits an OpenCL CPU device into one sub-device per NUMA node with clCreateSubDevices(), returns an empty vector if the device can't be split
+	vector<Device_Info> sub_devices;
+	if(!info.is_cpu||info.is_native) return sub_devices;
+	if(!(info.cl_device.getInfo<CL_DEVICE_PARTITION_AFFINITY_DOMAIN>()&CL_DEVICE_AFFINITY_DOMAIN_NUMA)) return sub_devices;
+	const cl_device_partition_property properties[] = { CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0 };
+	cl::Device cl_device = info.cl_device; // createSubDevices() is not const
+	vector<cl::Device> cl_devices;
+	if(cl_device.createSubDevices(properties, &cl_devices)!=CL_SUCCESS||(uint)cl_devices.size()<2u) return sub_devices;
+	for(uint i=0u; i<(uint)cl_devices.size(); i++) {
+		cl::Context cl_context(cl_devices[i]); // separate cl::Context for each sub-device, same as for devices
+		Device_Info sub_device(cl_devices[i], cl_context, info.id); // sub-devices keep the ID and name of their device, so device selection by ID and grouping by name are unchanged
+		sub_device.memory = info.memory/(uint)cl_devices.size(); // every sub-device reports all system memory, but should only use the memory of its own node
+		sub_device.max_global_buffer = min(sub_device.max_global_buffer, sub_device.memory);
+		sub_devices.push_back(sub_device);
+	}
+	return sub_devices;
+}
+inline float measure_memory_bandwidth(const Device_Info& info) { // returns measured device memory bandwidth in GB/s from a short copy benchmark
+	if(info.is_native) return measure_native_memory_bandwidth();
+	const ulong N = min((ulong)min(info.max_global_buffer, info.memory/4u)*1048576ull/(ulong)sizeof(float), (ulong)16777216u); // up to 64 MB per buffer
+	if(N==0ull) return 0.0f;
+	cl::CommandQueue cl_queue(info.cl_context, info.cl_device);
+	const string code = "kernel void benchmark_copy(const global float* a, global float* b) { const uint n = get_global_id(0); b[n] = a[n]; }";
+	cl::Program::Sources cl_source;
+	cl_source.push_back({ code.c_str(), code.length() });
+	cl::Program cl_program(info.cl_context, cl_source);
+	if(cl_program.build({ info.cl_device }, "-w")) return 0.0f;
+	cl::Buffer a(info.cl_context, CL_MEM_READ_WRITE, N*sizeof(float)), b(info.cl_context, CL_MEM_READ_WRITE, N*sizeof(float));
+	cl::Kernel cl_kernel(cl_program, "benchmark_copy");
+	cl_kernel.setArg(0, a);
+	cl_kernel.setArg(1, b);
+	const cl::NDRange cl_range_global(N), cl_range_local(WORKGROUP_SIZE); // N is a multiple of WORKGROUP_SIZE
+	cl_queue.enqueueNDRangeKernel(cl_kernel, cl::NullRange, cl_range_global, cl_range_local); // warmup
+	cl_queue.finish();
+	const uint runs = 8u;
+	Clock clock;
+	for(uint i=0u; i<runs; i++) cl_queue.enqueueNDRangeKernel(cl_kernel, cl::NullRange, cl_range_global, cl_range_local);
+	cl_queue.finish();
+	return (float)(2.0*(double)(N*sizeof(float))*(double)runs/clock.stop()*1E-9); // one read and one write per element
+}
+
+class Device_Arena { // hands out aligned sub-buffers of a few large device buffers (blocks), so small and transient allocations don't each create a device buffer, and freed ranges are reused
+public:
+	struct Allocation {
+		cl::Buffer buffer; // sub-buffer, or the whole block for allocations larger than a block
+		uint block = 0u; // index of the block
+		ulong offset=0ull, size=0ull; // range within the block in Bytes, size is rounded up to the alignment
+	};
+private:
+	struct Block {
+		cl::Buffer buffer;
+		ulong size = 0ull; // in Bytes, 0 if the block has been released
+		bool dedicated = false; // holds a single allocation larger than a block and is released together with it
+		vector<std::pair<ulong, ulong>> free; // free ranges (offset, size) in Bytes, sorted by offset
+	};
+	cl::Context cl_context;
+	cl_mem_flags flags = CL_MEM_READ_WRITE;
+	ulong alignment=1ull, block_size=0ull; // in Bytes
+	vector<Block> blocks;
+	inline uint add_block(const ulong size, const bool dedicated, int& error) { // returns the index of the new block
+		uint b = 0u;
+		while(b<(uint)blocks.size()&&blocks[b].size>0ull) b++; // reuse the slot of a released block, so indices of other blocks stay valid
+		if(b==(uint)blocks.size()) blocks.push_back(Block());
+		blocks[b].buffer = cl::Buffer(cl_context, flags, size, nullptr, &error);
+		if(error) return b;
+		blocks[b].size = size;
+		blocks[b].dedicated = dedicated;
+		blocks[b].free.clear();
+		if(!dedicated) blocks[b].free.push_back(std::make_pair(0ull, size));
+		return b;
+	}
+public:
+	inline Device_Arena(const cl::Context& cl_context, const cl_mem_flags flags, const ulong alignment, const ulong block_size) {
+		this->cl_context = cl_context;
+		this->flags = flags;
+		this->alignment = alignment;
+		this->block_size = (block_size/alignment)*alignment;
+	}
+	inline Allocation allocate(const ulong bytes, ulong& reserved, int& error) { // reserved returns the Bytes of newly created device buffers
+		Allocation allocation;
+		reserved = 0ull;
+		error = 0;
+		allocation.size = (bytes+alignment-1ull)/alignment*alignment;
+		if(allocation.size>block_size) { // large fields get a block of their own, a sub-buffer would gain nothing
+			allocation.block = add_block(bytes, true, error);
+			if(error) return allocation;
+			reserved = bytes;
+			allocation.size = bytes;
+			allocation.buffer = blocks[allocation.block].buffer;
+			return allocation;
+		}
+		uint b=(uint)blocks.size(), i=0u; // block and free range
+		for(uint k=0u; k<(uint)blocks.size()&&b==(uint)blocks.size(); k++) { // first fit
+			if(blocks[k].dedicated||blocks[k].size==0ull) continue;
+			for(uint j=0u; j<(uint)blocks[k].free.size(); j++) if(blocks[k].free[j].second>=allocation.size) { b = k; i = j; break; }
+		}
+		if(b==(uint)blocks.size()) { // no free range is large enough, add a block
+			b = add_block(block_size, false, error);
+			if(error) return allocation;
+			reserved = block_size;
+			i = 0u;
+		}
+		std::pair<ulong, ulong>& range = blocks[b].free[i];
+		allocation.block = b;
+		allocation.offset = range.first;
+		range.first += allocation.size;
+		range.second -= allocation.size;
+		if(range.second==0ull) blocks[b].free.erase(blocks[b].free.begin()+i);
+		const cl_buffer_region region = { (size_t)allocation.offset, (size_t)bytes };
+		allocation.buffer = blocks[b].buffer.createSubBuffer(CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region, &error);
+		if(error) release(allocation);
+		return allocation;
+	}
+	inline ulong release(const Allocation& allocation) { // returns the range to its block, returns the Bytes of released device buffers
+		Block& block = blocks[allocation.block];
+		if(block.dedicated) {
+			const ulong size = block.size;
+			block = Block();
+			return size;
+		}
+		vector<std::pair<ulong, ulong>>& free = block.free;
+		uint i = 0u;
+		while(i<(uint)free.size()&&free[i].first<allocation.offset) i++;
+		free.insert(free.begin()+i, std::make_pair(allocation.offset, allocation.size));
+		if(i+1u<(uint)free.size()&&free[i].first+free[i].second==free[i+1u].first) { // merge with the following free range
+			free[i].second += free[i+1u].second;
+			free.erase(free.begin()+(i+1u));
+		}
+		if(i>0u&&free[i-1u].first+free[i-1u].second==free[i].first) { // merge with the preceding free range
+			free[i-1u].second += free[i].second;
+			free.erase(free.begin()+i);
+		}
+		return 0ull; // blocks stay allocated as a pool for later allocations
+	}
+};
 
 class Device {
 private:
@@ -161,18 +394,34 @@ private:
 		"\n	#ifdef cl_khr_int64_base_atomics"
 		"\n	#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable" // make sure cl_khr_int64_base_atomics extension is enabled
 		"\n	#endif"
+#ifdef STRICT_MATH
+		"\n	#pragma OPENCL FP_CONTRACT OFF" // don't fuse a*b+c into fma(a, b, c), the native C++ backend doesn't either
+#endif // STRICT_MATH
 	;}
 public:
 	Device_Info info;
+	std::shared_ptr<Native_Program> native_program; // only for the native CPU backend
+	std::shared_ptr<Device_Arena> arena; // device memory arena, only if info.arena_block>0
 	inline Device(const Device_Info& info, const string& opencl_c_code=get_opencl_c_code()) {
 		print_device_info(info);
 		this->info = info;
+		if(info.is_native) { // no OpenCL runtime involved, kernels are C++ functions configured by the same #define lines as the OpenCL C code
+			native_program = std::shared_ptr<Native_Program>(create_native_program(opencl_c_code), delete_native_program);
+			print_info("Native C++ kernels successfully configured.");
+			this->exists = true;
+			return;
+		}
 		this->cl_queue = cl::CommandQueue(info.cl_context, info.cl_device); // queue to push commands for the device
+		if(info.arena_block>0u) arena = std::make_shared<Device_Arena>(info.cl_context, CL_MEM_READ_WRITE|((int)info.intel_gpu_above_4gb_patch<<23), (ulong)info.memory_alignment, (ulong)min(info.arena_block, info.max_global_buffer)*1048576ull);
 		cl::Program::Sources cl_source;
 		const string kernel_code = enable_device_capabilities()+"\n"+opencl_c_code;
 		cl_source.push_back({ kernel_code.c_str(), kernel_code.length() });
 		this->cl_program = cl::Program(info.cl_context, cl_source);
+#ifndef STRICT_MATH
 		const string build_options = string("-cl-fast-relaxed-math")+(info.intel_gpu_above_4gb_patch ? " -cl-intel-greater-than-4GB-buffer-required" : "");
+#else // STRICT_MATH
+		const string build_options = string("-cl-fp32-correctly-rounded-divide-sqrt")+(info.intel_gpu_above_4gb_patch ? " -cl-intel-greater-than-4GB-buffer-required" : "");
+#endif // STRICT_MATH
 #ifndef LOG
 		int error = cl_program.build({ info.cl_device }, (build_options+" -w").c_str()); // compile OpenCL C code, disable warnings
 		if(error) print_warning(cl_program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(info.cl_device)); // print build log
@@ -189,9 +438,19 @@ public:
 #endif // PTX
 		this->exists = true;
 	}
+	inline Device(const Device_Info& info, const Device& device) { // share the compiled program and the memory arena of another Device with the same context, only the command queue is separate
+		this->info = info;
+		native_program = device.native_program;
+		arena = device.arena;
+		if(!info.is_native) {
+			this->cl_queue = cl::CommandQueue(info.cl_context, info.cl_device); // queue to push commands for the device
+			this->cl_program = device.cl_program;
+		}
+		this->exists = true;
+	}
 	inline Device() {} // default constructor
-	inline void barrier(const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { cl_queue.enqueueBarrierWithWaitList(event_waitlist, event_returned); }
-	inline void finish_queue() { cl_queue.finish(); }
+	inline void barrier(const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { if(!info.is_native) cl_queue.enqueueBarrierWithWaitList(event_waitlist, event_returned); } // native kernels run synchronously
+	inline void finish_queue() { if(!info.is_native) cl_queue.finish(); }
 	inline cl::Context get_cl_context() const { return info.cl_context; }
 	inline cl::Program get_cl_program() const { return cl_program; }
 	inline cl::CommandQueue get_cl_queue() const { return cl_queue; }
@@ -202,11 +461,17 @@ template<typename T> class Memory {
 private:
 	ulong N = 0ull; // buffer length
 	uint d = 1u; // buffer dimensions
-	bool host_buffer_exists = false;
+	std::atomic<bool> host_buffer_exists{false}; // only set once the host buffer holds valid data, host access from several threads checks it without locking
 	bool device_buffer_exists = false;
 	bool external_host_buffer = false;
+	bool shared_device_buffer = false; // device buffer belongs to another Memory, see share_device_buffer()
+	std::shared_ptr<Device_Arena> arena; // arena the device buffer is a sub-buffer of, nullptr for an own device buffer
+	bool lazy_host_buffer = false; // host buffer is a mirror of device memory that was released and is allocated again on the next readback, see release_host_buffer()
+	std::mutex host_buffer_mutex; // only one thread allocates and reads back a released host buffer
+	Device_Arena::Allocation allocation; // range of the sub-buffer in the arena
 	T* host_buffer = nullptr; // host buffer
 	cl::Buffer device_buffer; // device buffer
+	T* native_buffer = nullptr; // device buffer of the native CPU backend, a separate allocation in host memory
 	Device* device = nullptr; // pointer to linked Device
 	cl::CommandQueue cl_queue; // command queue
 	inline void initialize_auxiliary_pointers() {
@@ -218,9 +483,25 @@ private:
 	inline void allocate_device_buffer(Device& device, const bool allocate_device) {
 		this->device = &device;
 		this->cl_queue = device.get_cl_queue();
-		if(allocate_device) {
+		if(allocate_device&&device.arena!=nullptr) { // sub-buffer of the device memory arena
+			ulong reserved = 0ull;
+			int error = 0;
+			allocation = device.arena->allocate(capacity(), reserved, error);
+			device.info.memory_used += (uint)((reserved+1048575ull)/1048576ull); // track device memory usage, the arena counts whole blocks including their free ranges
+			if(device.info.memory_used>device.info.memory) print_error("Device \""+device.info.name+"\" does not have enough memory. Allocating another "+to_string((uint)((reserved+1048575ull)/1048576ull))+" MB would use a total of "+to_string(device.info.memory_used)+" MB / "+to_string(device.info.memory)+" MB.");
+			if(error) print_error("Device buffer allocation in the memory arena failed with error code "+to_string(error)+".");
+			device_buffer = allocation.buffer;
+			arena = device.arena;
+			device_buffer_exists = true;
+		} else if(allocate_device) {
 			device.info.memory_used += (uint)(capacity()/1048576ull); // track device memory usage
 			if(device.info.memory_used>device.info.memory) print_error("Device \""+device.info.name+"\" does not have enough memory. Allocating another "+to_string((uint)(capacity()/1048576ull))+" MB would use a total of "+to_string(device.info.memory_used)+" MB / "+to_string(device.info.memory)+" MB.");
+			if(device.info.is_native) {
+				native_buffer = host_allocate<T>(range(), device.info.host_policy);
+				if(device.info.host_policy.parallel_touch) host_fill(native_buffer, N, d, (T)0, device.info.host_policy); // place pages before write_to_device() touches all of them from one thread
+				device_buffer_exists = true;
+				return;
+			}
 			int error = 0;
 			device_buffer = cl::Buffer(device.get_cl_context(), CL_MEM_READ_WRITE|((int)device.info.intel_gpu_above_4gb_patch<<23), capacity(), nullptr, &error); // for Intel GPUs, set flag CL_MEM_ALLOW_UNRESTRICTED_SIZE_INTEL = (1<<23)
 			if(error==-61) print_error("Memory size is too large at "+to_string((uint)(capacity()/1048576ull))+" MB. Device \""+device.info.name+"\" accepts a maximum buffer size of "+to_string(device.info.max_global_buffer)+" MB.");
@@ -228,6 +509,20 @@ private:
 			device_buffer_exists = true;
 		}
 	}
+	inline void free_device_memory() { // track device memory usage and return an arena range, the device buffer handle itself is dropped by the caller
+		if(!device_buffer_exists||shared_device_buffer) return;
+		if(arena!=nullptr) device->info.memory_used -= (uint)((arena->release(allocation)+1048575ull)/1048576ull);
+		else device->info.memory_used -= (uint)(capacity()/1048576ull);
+		arena = nullptr;
+	}
+	inline void enqueue_read(const ulong offset, const ulong length, const bool blocking, const vector<Event>* event_waitlist, Event* event_returned) { // offset and length in elements
+		if(native_buffer!=nullptr) std::memcpy((void*)(host_buffer+offset), (const void*)(native_buffer+offset), length*sizeof(T)); // native kernels have already finished, so copies are always blocking
+		else cl_queue.enqueueReadBuffer(device_buffer, blocking, offset*sizeof(T), length*sizeof(T), (void*)(host_buffer+offset), event_waitlist, event_returned);
+	}
+	inline void enqueue_write(const ulong offset, const ulong length, const bool blocking, const vector<Event>* event_waitlist, Event* event_returned) { // offset and length in elements
+		if(native_buffer!=nullptr) std::memcpy((void*)(native_buffer+offset), (const void*)(host_buffer+offset), length*sizeof(T));
+		else cl_queue.enqueueWriteBuffer(device_buffer, blocking, offset*sizeof(T), length*sizeof(T), (void*)(host_buffer+offset), event_waitlist, event_returned);
+	}
 public:
 	T *x=nullptr, *y=nullptr, *z=nullptr, *w=nullptr; // host buffer auxiliary pointers for multi-dimensional array access (array of structures)
 	T *s0=nullptr, *s1=nullptr, *s2=nullptr, *s3=nullptr, *s4=nullptr, *s5=nullptr, *s6=nullptr, *s7=nullptr, *s8=nullptr, *s9=nullptr, *sA=nullptr, *sB=nullptr, *sC=nullptr, *sD=nullptr, *sE=nullptr, *sF=nullptr;
@@ -238,8 +533,8 @@ public:
 		this->d = dimensions;
 		allocate_device_buffer(device, allocate_device);
 		if(allocate_host) {
-			host_buffer = new T[N*(ulong)d];
-			for(ulong i=0ull; i<N*(ulong)d; i++) host_buffer[i] = value;
+			host_buffer = host_allocate<T>(range(), device.info.host_policy);
+			host_fill(host_buffer, N, d, value, device.info.host_policy);
 			initialize_auxiliary_pointers();
 			host_buffer_exists = true;
 		}
@@ -269,7 +564,17 @@ public:
 		cl_queue = memory.device->get_cl_queue();
 		if(memory.device_buffer_exists) {
 			device_buffer = memory.get_cl_buffer(); // transfer device_buffer pointer
-			device->info.memory_used += (uint)(capacity()/1048576ull); // track device memory usage
+			native_buffer = memory.native_buffer; // transfer native_buffer pointer
+			memory.native_buffer = nullptr;
+			shared_device_buffer = memory.shared_device_buffer;
+			if(memory.arena!=nullptr) { // the arena range moves along, memory must not release it
+				arena = memory.arena;
+				allocation = memory.allocation;
+				memory.arena = nullptr;
+				memory.device_buffer_exists = false;
+			} else if(!shared_device_buffer) {
+				device->info.memory_used += (uint)(capacity()/1048576ull); // track device memory usage
+			}
 			device_buffer_exists = true;
 		}
 		if(memory.host_buffer_exists) {
@@ -279,17 +584,17 @@ public:
 		}
 		return *this; // destructor of memory will be called automatically
 	}
-	inline T* const exchange_host_buffer(T* const host_buffer) { // sets host_buffer to new pointer and returns old pointer
+	inline T* const exchange_host_buffer(T* const host_buffer) { // sets host_buffer to new pointer and returns old pointer, both come from host_allocate()
 		T* const swap = this->host_buffer;
 		this->host_buffer = host_buffer;
 		return swap;
 	}
 	inline void add_host_buffer() { // makes only sense if there is no host buffer yet but an existing device buffer
 		if(!host_buffer_exists&&device_buffer_exists) {
-			host_buffer = new T[N*(ulong)d];
+			host_buffer = host_allocate<T>(range(), device->info.host_policy);
 			initialize_auxiliary_pointers();
+			host_buffer_exists = true; // before read_from_device(), which only reads into an existing host buffer
 			read_from_device();
-			host_buffer_exists = true;
 		} else if(!device_buffer_exists) {
 			print_error("There is no existing device buffer, so can't add host buffer.");
 		}
@@ -302,18 +607,61 @@ public:
 			print_error("There is no existing host buffer, so can't add device buffer.");
 		}
 	}
+	inline void share_device_buffer(const Memory<T>& memory) { // use the device buffer of another Memory of the same size instead of an own one, both then see the same device data, and only the owner counts towards device memory usage
+		if(!memory.device_buffer_exists||memory.native_buffer!=nullptr||memory.range()!=range()) print_error("Can only share an existing OpenCL device buffer of the same size.");
+		free_device_memory();
+		device_buffer = memory.device_buffer;
+		device_buffer_exists = true;
+		shared_device_buffer = true;
+	}
+	inline void swap_device_buffer(Memory<T>& memory) { // exchange the device buffers of two Memory objects of the same size without copying, kernels that have one of them as parameter have to be linked again
+		if(!device_buffer_exists||!memory.device_buffer_exists||memory.range()!=range()) print_error("Can only swap existing device buffers of the same size.");
+		std::swap(device_buffer, memory.device_buffer);
+		std::swap(native_buffer, memory.native_buffer);
+		std::swap(shared_device_buffer, memory.shared_device_buffer);
+		std::swap(arena, memory.arena);
+		std::swap(allocation, memory.allocation);
+	}
+	inline void release_host_buffer() { // free the host buffer of a field whose data is in device memory, it is allocated again on the next readback or host access through restore_host_buffer()
+		if(!host_buffer_exists||!device_buffer_exists||external_host_buffer) return;
+		delete_host_buffer();
+		lazy_host_buffer = true;
+	}
+	inline void ensure_host_buffer() { // allocate a released host buffer again, without reading from device, only if all of it is overwritten afterwards
+		if(host_buffer_exists||!lazy_host_buffer) return;
+		std::lock_guard<std::mutex> lock(host_buffer_mutex);
+		if(host_buffer_exists) return; // another thread was faster
+		host_buffer = host_allocate<T>(range(), device->info.host_policy);
+		initialize_auxiliary_pointers();
+		host_buffer_exists = true;
+	}
+	inline bool restore_host_buffer() { // allocate a released host buffer again and read all of it from device, returns true if this call did the readback
+		if(host_buffer_exists||!lazy_host_buffer) return false;
+		std::lock_guard<std::mutex> lock(host_buffer_mutex);
+		if(host_buffer_exists) return false; // another thread was faster
+		host_buffer = host_allocate<T>(range(), device->info.host_policy);
+		enqueue_read(0ull, range(), true, nullptr, nullptr); // a partial read would leave the rest of the buffer uninitialized
+		initialize_auxiliary_pointers();
+		host_buffer_exists = true; // only now other threads may use the host buffer
+		return true;
+	}
+	inline bool has_host_buffer() const { return host_buffer_exists; }
 	inline void delete_host_buffer() {
+		if(host_buffer_exists&&!external_host_buffer) host_free((void*)host_buffer);
 		host_buffer_exists = false;
-		if(!external_host_buffer) delete[] host_buffer;
+		host_buffer = nullptr; // don't leave a dangling pointer, the destructor calls delete_host_buffer() again
 		if(!device_buffer_exists) {
 			N = 0ull;
 			d = 1u;
 		}
 	}
 	inline void delete_device_buffer() {
-		if(device_buffer_exists) device->info.memory_used -= (uint)(capacity()/1048576ull); // track device memory usage
+		free_device_memory();
 		device_buffer_exists = false;
+		shared_device_buffer = false;
 		device_buffer = nullptr;
+		host_free((void*)native_buffer);
+		native_buffer = nullptr;
 		if(!host_buffer_exists) {
 			N = 0ull;
 			d = 1u;
@@ -324,7 +672,7 @@ public:
 		delete_host_buffer();
 	}
 	inline void reset(const T value=(T)0) {
-		if(host_buffer_exists) for(ulong i=0ull; i<N*(ulong)d; i++) host_buffer[i] = value;
+		if(host_buffer_exists) host_fill(host_buffer, N, d, value, device->info.host_policy);
 		write_to_device();
 	}
 	inline const ulong length() const { return N; }
@@ -340,31 +688,34 @@ public:
 	inline const T operator()(const ulong i) const { return host_buffer[i]; }
 	inline const T operator()(const ulong i, const uint dimension) const { return host_buffer[i+(ulong)dimension*N]; } // array of structures
 	inline void read_from_device(const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) {
-		if(host_buffer_exists&&device_buffer_exists) cl_queue.enqueueReadBuffer(device_buffer, blocking, 0u, capacity(), (void*)host_buffer, event_waitlist, event_returned);
+		if(restore_host_buffer()) return; // the whole buffer has just been read
+		if(host_buffer_exists&&device_buffer_exists) enqueue_read(0ull, range(), blocking, event_waitlist, event_returned);
 	}
 	inline void write_to_device(const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) {
-		if(host_buffer_exists&&device_buffer_exists) cl_queue.enqueueWriteBuffer(device_buffer, blocking, 0u, capacity(), (void*)host_buffer, event_waitlist, event_returned);
+		if(host_buffer_exists&&device_buffer_exists) enqueue_write(0ull, range(), blocking, event_waitlist, event_returned);
 	}
 	inline void read_from_device(const ulong offset, const ulong length, const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) {
+		if(restore_host_buffer()) return; // a released host buffer is read completely, as host access trusts all of it afterwards
 		if(host_buffer_exists&&device_buffer_exists) {
 			const ulong safe_offset=min(offset, range()), safe_length=min(length, range()-safe_offset);
-			if(safe_length>0ull) cl_queue.enqueueReadBuffer(device_buffer, blocking, safe_offset*sizeof(T), safe_length*sizeof(T), (void*)(host_buffer+safe_offset), event_waitlist, event_returned);
+			if(safe_length>0ull) enqueue_read(safe_offset, safe_length, blocking, event_waitlist, event_returned);
 		}
 	}
 	inline void write_to_device(const ulong offset, const ulong length, const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) {
 		if(host_buffer_exists&&device_buffer_exists) {
 			const ulong safe_offset=min(offset, range()), safe_length=min(length, range()-safe_offset);
-			if(safe_length>0ull) cl_queue.enqueueWriteBuffer(device_buffer, blocking, safe_offset*sizeof(T), safe_length*sizeof(T), (void*)(host_buffer+safe_offset), event_waitlist, event_returned);
+			if(safe_length>0ull) enqueue_write(safe_offset, safe_length, blocking, event_waitlist, event_returned);
 		}
 	}
 	inline void read_from_device_1d(const ulong x0, const ulong x1, const int dimension=-1, const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { // read 1D domain from device, either for all vector dimensions (-1) or for a specified dimension
+		if(restore_host_buffer()) return; // a released host buffer is read completely, as host access trusts all of it afterwards
 		if(host_buffer_exists&&device_buffer_exists) {
 			const uint i0=(uint)max(0, dimension), i1=dimension<0 ? d : i0+1u;
 			for(uint i=i0; i<i1; i++) {
 				const ulong safe_offset=min((ulong)i*N+x0, range()), safe_length=min(x1-x0, range()-safe_offset);
-				if(safe_length>0ull) cl_queue.enqueueReadBuffer(device_buffer, false, safe_offset*sizeof(T), safe_length*sizeof(T), (void*)(host_buffer+safe_offset), event_waitlist, event_returned);
+				if(safe_length>0ull) enqueue_read(safe_offset, safe_length, false, event_waitlist, event_returned);
 			}
-			if(blocking) cl_queue.finish();
+			if(blocking) finish_queue();
 		}
 	}
 	inline void write_to_device_1d(const ulong x0, const ulong x1, const int dimension=-1, const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { // write 1D domain to device, either for all vector dimensions (-1) or for a specified dimension
@@ -372,22 +723,23 @@ public:
 			const uint i0=(uint)max(0, dimension), i1=dimension<0 ? d : i0+1u;
 			for(uint i=i0; i<i1; i++) {
 				const ulong safe_offset=min((ulong)i*N+x0, range()), safe_length=min(x1-x0, range()-safe_offset);
-				if(safe_length>0ull) cl_queue.enqueueWriteBuffer(device_buffer, false, safe_offset*sizeof(T), safe_length*sizeof(T), (void*)(host_buffer+safe_offset), event_waitlist, event_returned);
+				if(safe_length>0ull) enqueue_write(safe_offset, safe_length, false, event_waitlist, event_returned);
 			}
-			if(blocking) cl_queue.finish();
+			if(blocking) finish_queue();
 		}
 	}
 	inline void read_from_device_2d(const ulong x0, const ulong x1, const ulong y0, const ulong y1, const ulong Nx, const ulong Ny, const int dimension=-1, const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { // read 2D domain from device, either for all vector dimensions (-1) or for a specified dimension
+		if(restore_host_buffer()) return; // a released host buffer is read completely, as host access trusts all of it afterwards
 		if(host_buffer_exists&&device_buffer_exists) {
 			for(uint y=y0; y<y1; y++) {
 				const ulong n = x0+y*Nx;
 				const uint i0=(uint)max(0, dimension), i1=dimension<0 ? d : i0+1u;
 				for(uint i=i0; i<i1; i++) {
 					const ulong safe_offset=min((ulong)i*N+n, range()), safe_length=min(x1-x0, range()-safe_offset);
-					if(safe_length>0ull) cl_queue.enqueueReadBuffer(device_buffer, false, safe_offset*sizeof(T), safe_length*sizeof(T), (void*)(host_buffer+safe_offset), event_waitlist, event_returned);
+					if(safe_length>0ull) enqueue_read(safe_offset, safe_length, false, event_waitlist, event_returned);
 				}
 			}
-			if(blocking) cl_queue.finish();
+			if(blocking) finish_queue();
 		}
 	}
 	inline void write_to_device_2d(const ulong x0, const ulong x1, const ulong y0, const ulong y1, const ulong Nx, const ulong Ny, const int dimension=-1, const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { // write 2D domain to device, either for all vector dimensions (-1) or for a specified dimension
@@ -397,13 +749,14 @@ public:
 				const uint i0=(uint)max(0, dimension), i1=dimension<0 ? d : i0+1u;
 				for(uint i=i0; i<i1; i++) {
 					const ulong safe_offset=min((ulong)i*N+n, range()), safe_length=min(x1-x0, range()-safe_offset);
-					if(safe_length>0ull) cl_queue.enqueueWriteBuffer(device_buffer, false, safe_offset*sizeof(T), safe_length*sizeof(T), (void*)(host_buffer+safe_offset), event_waitlist, event_returned);
+					if(safe_length>0ull) enqueue_write(safe_offset, safe_length, false, event_waitlist, event_returned);
 				}
 			}
-			if(blocking) cl_queue.finish();
+			if(blocking) finish_queue();
 		}
 	}
 	inline void read_from_device_3d(const ulong x0, const ulong x1, const ulong y0, const ulong y1, const ulong z0, const ulong z1, const ulong Nx, const ulong Ny, const ulong Nz, const int dimension=-1, const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { // read 3D domain from device, either for all vector dimensions (-1) or for a specified dimension
+		if(restore_host_buffer()) return; // a released host buffer is read completely, as host access trusts all of it afterwards
 		if(host_buffer_exists&&device_buffer_exists) {
 			for(uint z=z0; z<z1; z++) {
 				for(uint y=y0; y<y1; y++) {
@@ -411,11 +764,11 @@ public:
 					const uint i0=(uint)max(0, dimension), i1=dimension<0 ? d : i0+1u;
 					for(uint i=i0; i<i1; i++) {
 						const ulong safe_offset=min((ulong)i*N+n, range()), safe_length=min(x1-x0, range()-safe_offset);
-						if(safe_length>0ull) cl_queue.enqueueReadBuffer(device_buffer, false, safe_offset*sizeof(T), safe_length*sizeof(T), (void*)(host_buffer+safe_offset), event_waitlist, event_returned);
+						if(safe_length>0ull) enqueue_read(safe_offset, safe_length, false, event_waitlist, event_returned);
 					}
 				}
 			}
-			if(blocking) cl_queue.finish();
+			if(blocking) finish_queue();
 		}
 	}
 	inline void write_to_device_3d(const ulong x0, const ulong x1, const ulong y0, const ulong y1, const ulong z0, const ulong z1, const ulong Nx, const ulong Ny, const ulong Nz, const int dimension=-1, const bool blocking=true, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { // write 3D domain to device, either for all vector dimensions (-1) or for a specified dimension
@@ -426,19 +779,20 @@ public:
 					const uint i0=(uint)max(0, dimension), i1=dimension<0 ? d : i0+1u;
 					for(uint i=i0; i<i1; i++) {
 						const ulong safe_offset=min((ulong)i*N+n, range()), safe_length=min(x1-x0, range()-safe_offset);
-						if(safe_length>0ull) cl_queue.enqueueWriteBuffer(device_buffer, false, safe_offset*sizeof(T), safe_length*sizeof(T), (void*)(host_buffer+safe_offset), event_waitlist, event_returned);
+						if(safe_length>0ull) enqueue_write(safe_offset, safe_length, false, event_waitlist, event_returned);
 					}
 				}
 			}
-			if(blocking) cl_queue.finish();
+			if(blocking) finish_queue();
 		}
 	}
 	inline void enqueue_read_from_device(const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { read_from_device(false, event_waitlist, event_returned); }
 	inline void enqueue_write_to_device(const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { write_to_device(false, event_waitlist, event_returned); }
 	inline void enqueue_read_from_device(const ulong offset, const ulong length, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { read_from_device(offset, length, false, event_waitlist, event_returned); }
 	inline void enqueue_write_to_device(const ulong offset, const ulong length, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { write_to_device(offset, length, false, event_waitlist, event_returned); }
-	inline void finish_queue() { cl_queue.finish(); }
+	inline void finish_queue() { if(native_buffer==nullptr) cl_queue.finish(); }
 	inline const cl::Buffer& get_cl_buffer() const { return device_buffer; }
+	inline T* const get_native_buffer() const { return native_buffer; }
 };
 
 class Kernel {
@@ -448,11 +802,32 @@ private:
 	cl::Kernel cl_kernel;
 	cl::NDRange cl_range_global, cl_range_local;
 	cl::CommandQueue cl_queue;
+	std::shared_ptr<Native_Program> native_program; // only for the native CPU backend
+	string native_name; // kernel name, for the error message if there is no C++ implementation
+	int native_kernel = -1; // C++ implementation of the kernel
+	vector<void*> native_buffers; // native kernel parameters, either a buffer or a constant at every position
+	vector<ulong> native_constants;
+	inline void link_native_parameter(const uint position, void* const buffer, const void* constant, const size_t size) {
+		if(position>=(uint)native_buffers.size()) {
+			native_buffers.resize(position+1u, nullptr);
+			native_constants.resize(position+1u, 0ull);
+		}
+		native_buffers[position] = buffer;
+		native_constants[position] = 0ull;
+		if(constant!=nullptr) std::memcpy((void*)&native_constants[position], constant, size); // constants are at most 8 Bytes
+	}
+	inline void initialize_native(const Device& device, const string& name) {
+		native_program = device.native_program;
+		native_name = name;
+		native_kernel = get_native_kernel(name);
+	}
 	template<typename T> inline void link_parameter(const uint position, const Memory<T>& memory) {
-		cl_kernel.setArg(position, memory.get_cl_buffer());
+		if(native_program) link_native_parameter(position, (void*)memory.get_native_buffer(), nullptr, 0u);
+		else cl_kernel.setArg(position, memory.get_cl_buffer());
 	}
 	template<typename T> inline void link_parameter(const uint position, const T& constant) {
-		cl_kernel.setArg(position, sizeof(T), (void*)&constant);
+		if(native_program) link_native_parameter(position, nullptr, (const void*)&constant, sizeof(T));
+		else cl_kernel.setArg(position, sizeof(T), (void*)&constant);
 	}
 	inline void link_parameters(const uint starting_position) {
 		number_of_parameters = max(number_of_parameters, starting_position);
@@ -464,18 +839,28 @@ private:
 public:
 	template<class... T> inline Kernel(const Device& device, const ulong N, const string& name, const T&... parameters) { // accepts Memory<T> objects and fundamental data type constants
 		if(!device.is_initialized()) print_error("No Device selected. Call Device constructor.");
-		cl_kernel = cl::Kernel(device.get_cl_program(), name.c_str());
+		if(device.info.is_native) initialize_native(device, name);
+		else cl_kernel = cl::Kernel(device.get_cl_program(), name.c_str());
 		link_parameters(number_of_parameters, parameters...); // expand variadic template to link kernel parameters
 		set_ranges(N);
 		cl_queue = device.get_cl_queue();
 	}
 	template<class... T> inline Kernel(const Device& device, const ulong N, const uint workgroup_size, const string& name, const T&... parameters) { // accepts Memory<T> objects and fundamental data type constants
 		if(!device.is_initialized()) print_error("No Device selected. Call Device constructor.");
-		cl_kernel = cl::Kernel(device.get_cl_program(), name.c_str());
+		if(device.info.is_native) initialize_native(device, name);
+		else cl_kernel = cl::Kernel(device.get_cl_program(), name.c_str());
 		link_parameters(number_of_parameters, parameters...); // expand variadic template to link kernel parameters
 		set_ranges(N, (ulong)workgroup_size);
 		cl_queue = device.get_cl_queue();
 	}
+	template<class... T> inline Kernel(const Device& device, const uint3 N, const string& name, const T&... parameters) { // 3D range, the kernel gets x/y/z from get_global_id(0/1/2); for 2D, N.z is 1
+		if(!device.is_initialized()) print_error("No Device selected. Call Device constructor.");
+		if(device.info.is_native) initialize_native(device, name);
+		else cl_kernel = cl::Kernel(device.get_cl_program(), name.c_str());
+		link_parameters(number_of_parameters, parameters...); // expand variadic template to link kernel parameters
+		set_ranges(N);
+		cl_queue = device.get_cl_queue();
+	}
 	inline Kernel() {} // default constructor
 	inline Kernel& set_ranges(const ulong N, const ulong workgroup_size=(ulong)WORKGROUP_SIZE) {
 		this->N = N;
@@ -483,6 +868,13 @@ public:
 		cl_range_local = cl::NDRange(workgroup_size);
 		return *this;
 	}
+	inline Kernel& set_ranges(const uint3 N, const uint3 workgroup_shape=WORKGROUP_SHAPE) {
+		this->N = (ulong)N.x*(ulong)N.y*(ulong)N.z; // native kernels run on the linear index n = x+(y+z*Ny)*Nx
+		const uint3 w = uint3(min(workgroup_shape.x, N.x), min(workgroup_shape.y, N.y), min(workgroup_shape.z, N.z)); // don't pad thin dimensions to a full workgroup
+		cl_range_global = cl::NDRange(((N.x+w.x-1u)/w.x)*w.x, ((N.y+w.y-1u)/w.y)*w.y, ((N.z+w.z-1u)/w.z)*w.z); // make global range a multiple of local range in every dimension
+		cl_range_local = cl::NDRange(w.x, w.y, w.z);
+		return *this;
+	}
 	inline const ulong range() const { return N; }
 	inline uint get_number_of_parameters() const { return number_of_parameters; }
 	template<class... T> inline Kernel& add_parameters(const T&... parameters) { // add parameters to the list of existing parameters
@@ -494,6 +886,11 @@ public:
 		return *this;
 	}
 	inline Kernel& enqueue_run(const uint t=1u, const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) {
+		if(native_program) {
+			if(native_kernel<0) print_error("Kernel \""+native_name+"\" is not available on the native C++ CPU backend. Use an OpenCL device instead.");
+			for(uint i=0u; i<t; i++) run_native_kernel(*native_program, native_kernel, N, native_buffers, native_constants);
+			return *this;
+		}
 		for(uint i=0u; i<t; i++) {
 			cl_queue.enqueueNDRangeKernel(cl_kernel, cl::NullRange, cl_range_global, cl_range_local, event_waitlist, event_returned);
 		}
@@ -508,7 +905,7 @@ public:
 		return run(t, event_waitlist, event_returned);
 	}
 	inline Kernel& finish_queue() {
-		cl_queue.finish();
+		if(!native_program) cl_queue.finish();
 		return *this;
 	}
 };
\ No newline at end of file
@@ -125,7 +125,10 @@ void fx3d::Scene::configure(const nlohmann::json &config) {
 
 	/* Create LBM */
 
-	this->lbm = new LBM(Nx, Ny, Nz, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho);
+	if (auto_domains)
+		this->lbm = new LBM(Nx, Ny, Nz, domains, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho);
+	else
+		this->lbm = new LBM(Nx, Ny, Nz, Dx, Dy, Dz, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho);
 
 	/* Obstacles and fluid bodies */
 
@@ -187,6 +190,22 @@ void fx3d::Scene::config_sim_params(const nlohmann::json &config) {
 		Nx = sim_config.contains("Nx") ? sim_config["Nx"] : Nx;
 		Ny = sim_config.contains("Ny") ? sim_config["Ny"] : Ny;
 		Nz = sim_config.contains("Nz") ? sim_config["Nz"] : Nz;
+		Dx = sim_config.contains("Dx") ? sim_config["Dx"] : Dx;
+		Dy = sim_config.contains("Dy") ? sim_config["Dy"] : Dy;
+		Dz = sim_config.contains("Dz") ? sim_config["Dz"] : Dz;
+		if (sim_config.contains("domains")) {
+			auto_domains = true;
+			domains = sim_config["domains"].is_number() ? (uint)sim_config["domains"] : 0u; // "domains": "auto" uses all suitable devices
+		}
+		if (sim_config.contains("processes")) { // split the domains across processes, every process runs with the same file except for "rank"
+			Settings::SetProcesses(sim_config.contains("rank") ? (uint)sim_config["rank"] : 0u, (uint)sim_config["processes"]);
+			if (sim_config.contains("transport"))
+				Settings::SetTransport(sim_config["transport"] == "tcp" ? ProcessTransport::TRANSPORT_TCP : ProcessTransport::TRANSPORT_SHM);
+			if (sim_config.contains("hosts"))
+				Settings::SetTransportHosts(sim_config["hosts"].get<std::string>());
+			if (sim_config.contains("port"))
+				Settings::SetTransportPort((uint)sim_config["port"]);
+		}
 		nu = sim_config.contains("nu") ? sim_config["nu"] : nu;
 		sigma = sim_config.contains("sigma") ? sim_config["sigma"] : sigma;
 		alpha = sim_config.contains("alpha") ? sim_config["alpha"] : alpha;
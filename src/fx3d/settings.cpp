@@ -21,19 +21,109 @@ fx3d::CollisionType fx3d::Settings::m_CollType  = fx3d::CollisionType::SRT;
 // fx3d::VelocitySet fx3d::Settings::m_VSet        = (fx3d::VelocitySet)0;
 // fx3d::CollisionType fx3d::Settings::m_CollType         = (fx3d::CollisionType)0;
 fx3d::DDFCompression fx3d::Settings::m_Compr    = (fx3d::DDFCompression)0;
+fx3d::DDFLayout fx3d::Settings::m_DDFLayout     = fx3d::DDFLayout::DDF_SOA;
+fx3d::DDFOrdering fx3d::Settings::m_DDFOrdering = fx3d::DDFOrdering::ORDER_LINEAR;
 fx3d::Feature fx3d::Settings::m_Features        = (fx3d::Feature)0;
+fx3d::DomainBalancing fx3d::Settings::m_Balancing = fx3d::DomainBalancing::UNIFORM;
+unsigned int fx3d::Settings::m_RepartitionPeriod = 0u;
+float fx3d::Settings::m_RepartitionThreshold    = 0.1f;
+fx3d::HaloCompression fx3d::Settings::m_HaloCompression = fx3d::HaloCompression::HALO_NONE;
+unsigned int fx3d::Settings::m_HaloExchangePeriod = 1u;
+bool fx3d::Settings::m_NativeBackend            = false;
+unsigned int fx3d::Settings::m_TemporalBlocking = 1u;
+bool fx3d::Settings::m_BoundaryLists            = false;
+bool fx3d::Settings::m_NeighborMasks            = false;
+bool fx3d::Settings::m_OutOfCore                = false;
+unsigned int fx3d::Settings::m_DeviceMemoryLimit = 0u;
+unsigned int fx3d::Settings::m_DeviceArena      = 0u;
+bool fx3d::Settings::m_LazyHostMirrors          = false;
+fx3d::HostPages fx3d::Settings::m_HostPages     = fx3d::HostPages::PAGES_DEFAULT;
+bool fx3d::Settings::m_NumaPlacement            = false;
+bool fx3d::Settings::m_ParallelFirstTouch       = false;
+bool fx3d::Settings::m_DeviceFission            = false;
+unsigned int fx3d::Settings::m_ProcessRank     = 0u;
+unsigned int fx3d::Settings::m_ProcessCount    = 1u;
+fx3d::ProcessTransport fx3d::Settings::m_Transport = fx3d::ProcessTransport::TRANSPORT_SHM;
+std::string fx3d::Settings::m_TransportHosts    = "127.0.0.1";
+unsigned int fx3d::Settings::m_TransportPort   = 47000u;
+std::string fx3d::Settings::m_TransportSession  = "fx3d";
 
 
 
 fx3d::VelocitySet fx3d::Settings::GetVelocitySet() { return m_VSet; }
 fx3d::CollisionType fx3d::Settings::GetCollisionType() { return m_CollType; }
 fx3d::DDFCompression fx3d::Settings::GetDDFCompression() { return m_Compr; }
+fx3d::DDFLayout fx3d::Settings::GetDDFLayout() { return m_DDFLayout; }
+fx3d::DDFOrdering fx3d::Settings::GetDDFOrdering() { return m_DDFOrdering; }
 unsigned int fx3d::Settings::GetVSetSize() { return m_VSetSize; }
 unsigned int fx3d::Settings::GetVSetDims() { return m_VSetDims; }
 unsigned int fx3d::Settings::GetVSetTransfer() { return m_VSetTransfer; }
+fx3d::DomainBalancing fx3d::Settings::GetDomainBalancing() { return m_Balancing; }
+unsigned int fx3d::Settings::GetRepartitionPeriod() { return m_RepartitionPeriod; }
+float fx3d::Settings::GetRepartitionThreshold() { return m_RepartitionThreshold; }
+fx3d::HaloCompression fx3d::Settings::GetHaloCompression() { return m_HaloCompression; }
+unsigned int fx3d::Settings::GetHaloExchangePeriod() { return m_HaloExchangePeriod; }
+bool fx3d::Settings::GetNativeBackend() { return m_NativeBackend; }
+unsigned int fx3d::Settings::GetTemporalBlocking() { return m_TemporalBlocking; }
+bool fx3d::Settings::GetBoundaryLists() { return m_BoundaryLists; }
+bool fx3d::Settings::GetNeighborMasks() { return m_NeighborMasks; }
+bool fx3d::Settings::GetOutOfCore() { return m_OutOfCore; }
+unsigned int fx3d::Settings::GetDeviceMemoryLimit() { return m_DeviceMemoryLimit; }
+unsigned int fx3d::Settings::GetDeviceArena() { return m_DeviceArena; }
+bool fx3d::Settings::GetLazyHostMirrors() { return m_LazyHostMirrors; }
+fx3d::HostPages fx3d::Settings::GetHostPages() { return m_HostPages; }
+bool fx3d::Settings::GetNumaPlacement() { return m_NumaPlacement; }
+bool fx3d::Settings::GetParallelFirstTouch() { return m_ParallelFirstTouch; }
+bool fx3d::Settings::GetDeviceFission() { return m_DeviceFission; }
+unsigned int fx3d::Settings::GetProcessRank() { return m_ProcessRank; }
+unsigned int fx3d::Settings::GetProcessCount() { return m_ProcessCount; }
+fx3d::ProcessTransport fx3d::Settings::GetTransport() { return m_Transport; }
+std::string fx3d::Settings::GetTransportHosts() { return m_TransportHosts; }
+unsigned int fx3d::Settings::GetTransportPort() { return m_TransportPort; }
+std::string fx3d::Settings::GetTransportSession() { return m_TransportSession; }
 
 void fx3d::Settings::SetCollisionType(fx3d::CollisionType CType) { m_CollType = CType; }
 void fx3d::Settings::SetDDFCompression(fx3d::DDFCompression Compr) { m_Compr = Compr; }
+void fx3d::Settings::SetDDFLayout(fx3d::DDFLayout Layout) { m_DDFLayout = Layout; }
+void fx3d::Settings::SetDDFOrdering(fx3d::DDFOrdering Ordering) { m_DDFOrdering = Ordering; }
+void fx3d::Settings::SetDomainBalancing(fx3d::DomainBalancing Balancing) { m_Balancing = Balancing; }
+void fx3d::Settings::SetRepartitionPeriod(unsigned int Steps) { m_RepartitionPeriod = Steps; }
+void fx3d::Settings::SetRepartitionThreshold(float Imbalance) { m_RepartitionThreshold = Imbalance; }
+void fx3d::Settings::SetHaloCompression(fx3d::HaloCompression Compression) { m_HaloCompression = Compression; }
+void fx3d::Settings::SetHaloExchangePeriod(unsigned int Steps)
+{
+    if (Steps == 0u)
+        print_error("Halo exchange period has to be at least 1 time step.");
+    m_HaloExchangePeriod = Steps;
+}
+void fx3d::Settings::SetNativeBackend(bool Enable) { m_NativeBackend = Enable; }
+void fx3d::Settings::SetTemporalBlocking(unsigned int Steps)
+{
+    if (Steps == 0u)
+        print_error("Temporal blocking has to advance at least 1 time step per pass.");
+    m_TemporalBlocking = Steps;
+}
+void fx3d::Settings::SetBoundaryLists(bool Enable) { m_BoundaryLists = Enable; }
+void fx3d::Settings::SetNeighborMasks(bool Enable) { m_NeighborMasks = Enable; }
+void fx3d::Settings::SetOutOfCore(bool Enable) { m_OutOfCore = Enable; }
+void fx3d::Settings::SetDeviceMemoryLimit(unsigned int MB) { m_DeviceMemoryLimit = MB; }
+void fx3d::Settings::SetDeviceArena(unsigned int BlockMB) { m_DeviceArena = BlockMB; }
+void fx3d::Settings::SetLazyHostMirrors(bool Enable) { m_LazyHostMirrors = Enable; }
+void fx3d::Settings::SetHostPages(fx3d::HostPages Pages) { m_HostPages = Pages; }
+void fx3d::Settings::SetNumaPlacement(bool Enable) { m_NumaPlacement = Enable; }
+void fx3d::Settings::SetParallelFirstTouch(bool Enable) { m_ParallelFirstTouch = Enable; }
+void fx3d::Settings::SetDeviceFission(bool Enable) { m_DeviceFission = Enable; }
+void fx3d::Settings::SetProcesses(unsigned int Rank, unsigned int Count)
+{
+    if (Count == 0u || Rank >= Count)
+        print_error("Process rank "+to_string(Rank)+" is out of range for "+to_string(Count)+" processes.");
+    m_ProcessRank = Rank;
+    m_ProcessCount = Count;
+}
+void fx3d::Settings::SetTransport(fx3d::ProcessTransport Transport) { m_Transport = Transport; }
+void fx3d::Settings::SetTransportHosts(const std::string& Hosts) { m_TransportHosts = Hosts; }
+void fx3d::Settings::SetTransportPort(unsigned int Port) { m_TransportPort = Port; }
+void fx3d::Settings::SetTransportSession(const std::string& Session) { m_TransportSession = Session; }
 void fx3d::Settings::SetVelocitySet(fx3d::VelocitySet VSet)
 { 
     m_VSet = VSet;
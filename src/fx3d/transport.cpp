@@ -0,0 +1,265 @@
+#include <fx3d/transport.hpp>
+#include <fx3d/settings.hpp>
+#include <atomic>
+#include <cstring>
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+using namespace fx3d;
+
+#define TRANSPORT_TIMEOUT 60.0 // seconds to wait for all other processes to show up
+
+void HaloTransport::barrier() { // peers are visited in ascending order on every process, so all pairwise exchanges follow one global order and cannot deadlock
+	char send=0, receive=0;
+	for(uint peer=0u; peer<size; peer++) if(peer!=rank) exchange(peer, &send, &receive, 1ull);
+}
+void HaloTransport::sum(vector<float>& values) {
+	const vector<float> local = values; // send the own contribution to every peer, not the partial sums
+	vector<float> received(values.size());
+	for(uint peer=0u; peer<size; peer++) {
+		if(peer==rank) continue;
+		exchange(peer, local.data(), received.data(), (ulong)local.size()*sizeof(float));
+		for(size_t i=0; i<values.size(); i++) values[i] += received[i];
+	}
+}
+
+#if !defined(_WIN32)
+
+struct SharedMemoryTransport::Ring { // lives at the start of a shared memory segment and is followed by the ring data
+	std::atomic<ulong> head; // total Bytes written by the producer
+	std::atomic<ulong> tail; // total Bytes read by the consumer
+	std::atomic<uint> ready; // set by the consumer once the ring is initialized
+	ulong capacity; // size of the ring data in Bytes
+	char* data() { return (char*)(this+1); }
+};
+static_assert(std::atomic<ulong>::is_always_lock_free, "Shared memory rings require lock-free 64-bit atomics.");
+
+SharedMemoryTransport::SharedMemoryTransport(const uint rank, const uint size, const string& session, const ulong capacity) {
+	this->rank = rank;
+	this->size = size;
+	this->capacity = capacity;
+	rings_send = vector<Ring*>(size, nullptr);
+	rings_receive = vector<Ring*>(size, nullptr);
+	const size_t segment = sizeof(Ring)+(size_t)capacity;
+	for(uint peer=0u; peer<size; peer++) { // every process creates the rings it receives from
+		if(peer==rank) continue;
+		const string name = "/"+session+"_"+to_string(peer)+"_"+to_string(rank); // source_destination
+		shm_unlink(name.c_str()); // remove leftovers of a crashed run
+		const int fd = shm_open(name.c_str(), O_CREAT|O_EXCL|O_RDWR, 0600);
+		if(fd<0||ftruncate(fd, (off_t)segment)!=0) print_error("Could not create shared memory segment \""+name+"\": "+string(strerror(errno)));
+		void* memory = mmap(nullptr, segment, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(memory==MAP_FAILED) print_error("Could not map shared memory segment \""+name+"\": "+string(strerror(errno)));
+		Ring* ring = new(memory) Ring();
+		ring->head.store(0ull, std::memory_order_relaxed);
+		ring->tail.store(0ull, std::memory_order_relaxed);
+		ring->capacity = capacity;
+		ring->ready.store(1u, std::memory_order_release);
+		rings_receive[peer] = ring;
+		names_receive.push_back(name);
+	}
+	for(uint peer=0u; peer<size; peer++) { // then opens the rings it sends to, as soon as the receiving process has created them
+		if(peer==rank) continue;
+		const string name = "/"+session+"_"+to_string(rank)+"_"+to_string(peer);
+		Clock clock;
+		int fd = -1;
+		struct stat status;
+		while((fd=shm_open(name.c_str(), O_RDWR, 0600))<0||fstat(fd, &status)!=0||(size_t)status.st_size<segment) {
+			if(fd>=0) close(fd);
+			if(clock.stop()>TRANSPORT_TIMEOUT) print_error("Process "+to_string(peer)+" did not create shared memory segment \""+name+"\" in time.");
+			sleep(0.001);
+		}
+		void* memory = mmap(nullptr, segment, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(memory==MAP_FAILED) print_error("Could not map shared memory segment \""+name+"\": "+string(strerror(errno)));
+		Ring* ring = (Ring*)memory;
+		while(ring->ready.load(std::memory_order_acquire)!=1u) sleep(0.001);
+		rings_send[peer] = ring;
+	}
+	print_info("Process "+to_string(rank)+" of "+to_string(size)+" connected over shared memory ("+to_string((uint)(capacity/1048576ull))+" MB rings).");
+}
+SharedMemoryTransport::~SharedMemoryTransport() {
+	const size_t segment = sizeof(Ring)+(size_t)capacity;
+	for(uint peer=0u; peer<size; peer++) {
+		if(rings_send[peer]!=nullptr) munmap((void*)rings_send[peer], segment);
+		if(rings_receive[peer]!=nullptr) munmap((void*)rings_receive[peer], segment);
+	}
+	for(const string& name : names_receive) shm_unlink(name.c_str());
+}
+void SharedMemoryTransport::exchange(const uint peer, const void* send, void* receive, const ulong bytes) {
+	Ring* out = rings_send[peer];
+	Ring* in = rings_receive[peer];
+	ulong sent=0ull, received=0ull;
+	while(sent<bytes||received<bytes) { // rings are smaller than large halos, so write and read alternately until both directions are done
+		bool progress = false;
+		if(sent<bytes) {
+			const ulong head=out->head.load(std::memory_order_relaxed), tail=out->tail.load(std::memory_order_acquire);
+			const ulong n = min(bytes-sent, capacity-(head-tail)); // free space in ring
+			if(n>0ull) {
+				const ulong offset=head%capacity, first=min(n, capacity-offset); // ring data may wrap around
+				memcpy(out->data()+offset, (const char*)send+sent, (size_t)first);
+				memcpy(out->data(), (const char*)send+sent+first, (size_t)(n-first));
+				out->head.store(head+n, std::memory_order_release);
+				sent += n;
+				progress = true;
+			}
+		}
+		if(received<bytes) {
+			const ulong tail=in->tail.load(std::memory_order_relaxed), head=in->head.load(std::memory_order_acquire);
+			const ulong n = min(bytes-received, head-tail); // available data in ring
+			if(n>0ull) {
+				const ulong offset=tail%capacity, first=min(n, capacity-offset);
+				memcpy((char*)receive+received, in->data()+offset, (size_t)first);
+				memcpy((char*)receive+received+first, in->data(), (size_t)(n-first));
+				in->tail.store(tail+n, std::memory_order_release);
+				received += n;
+				progress = true;
+			}
+		}
+		if(!progress) std::this_thread::yield(); // peer has not caught up yet
+	}
+}
+
+static void socket_send_all(const int fd, const void* data, const size_t bytes) { // blocking send, only used for the connection handshake
+	size_t sent = 0;
+	while(sent<bytes) {
+		const ssize_t n = ::send(fd, (const char*)data+sent, bytes-sent, 0);
+		if(n<0&&errno==EINTR) continue;
+		if(n<=0) print_error("TCP handshake failed: "+string(strerror(errno)));
+		sent += (size_t)n;
+	}
+}
+static void socket_receive_all(const int fd, void* data, const size_t bytes) { // blocking receive, only used for the connection handshake
+	size_t received = 0;
+	while(received<bytes) {
+		const ssize_t n = ::recv(fd, (char*)data+received, bytes-received, 0);
+		if(n<0&&errno==EINTR) continue;
+		if(n<=0) print_error("TCP handshake failed: "+string(n==0 ? "connection closed" : strerror(errno)));
+		received += (size_t)n;
+	}
+}
+
+SocketTransport::SocketTransport(const uint rank, const uint size, const vector<string>& hosts, const uint port) {
+	this->rank = rank;
+	this->size = size;
+	sockets = vector<int>(size, -1);
+	if(hosts.size()!=1u&&hosts.size()!=(size_t)size) print_error("TCP transport needs either one host for all processes or one host per process, but "+to_string((uint)hosts.size())+" hosts are given for "+to_string(size)+" processes.");
+	const int listener = socket(AF_INET, SOCK_STREAM, 0);
+	const int enable = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons((ushort)(port+rank));
+	if(listener<0||bind(listener, (sockaddr*)&address, sizeof(address))!=0||listen(listener, (int)size)!=0) print_error("Could not listen on TCP port "+to_string(port+rank)+": "+string(strerror(errno)));
+	for(uint peer=0u; peer<rank; peer++) { // connect to all lower ranks, their listening sockets accept the connection before they call accept()
+		const string& host = hosts[hosts.size()==1u ? 0u : peer];
+		Clock clock;
+		int fd = -1;
+		while(fd<0) {
+			addrinfo hints, * result = nullptr;
+			memset(&hints, 0, sizeof(hints));
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_STREAM;
+			if(getaddrinfo(host.c_str(), to_string(port+peer).c_str(), &hints, &result)!=0||result==nullptr) print_error("Could not resolve host \""+host+"\" of process "+to_string(peer)+".");
+			fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+			if(fd>=0&&connect(fd, result->ai_addr, result->ai_addrlen)!=0) {
+				close(fd);
+				fd = -1;
+			}
+			freeaddrinfo(result);
+			if(fd<0) {
+				if(clock.stop()>TRANSPORT_TIMEOUT) print_error("Could not connect to process "+to_string(peer)+" at "+host+":"+to_string(port+peer)+".");
+				sleep(0.01);
+			}
+		}
+		socket_send_all(fd, &rank, sizeof(uint)); // tell the peer which rank is connecting
+		sockets[peer] = fd;
+	}
+	for(uint i=rank+1u; i<size; i++) { // accept connections from all higher ranks, in any order
+		const int fd = accept(listener, nullptr, nullptr);
+		if(fd<0) print_error("Could not accept TCP connection: "+string(strerror(errno)));
+		uint peer = 0u;
+		socket_receive_all(fd, &peer, sizeof(uint));
+		if(peer<=rank||peer>=size||sockets[peer]>=0) print_error("Unexpected TCP connection from process "+to_string(peer)+".");
+		sockets[peer] = fd;
+	}
+	close(listener);
+	for(uint peer=0u; peer<size; peer++) {
+		if(peer==rank) continue;
+		setsockopt(sockets[peer], IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)); // halos are sent in one piece, don't wait for more data
+		fcntl(sockets[peer], F_SETFL, fcntl(sockets[peer], F_GETFL, 0)|O_NONBLOCK);
+	}
+	print_info("Process "+to_string(rank)+" of "+to_string(size)+" connected over TCP.");
+}
+SocketTransport::~SocketTransport() {
+	for(uint peer=0u; peer<size; peer++) if(sockets[peer]>=0) close(sockets[peer]);
+}
+void SocketTransport::exchange(const uint peer, const void* send, void* receive, const ulong bytes) {
+#ifdef MSG_NOSIGNAL
+	const int send_flags = MSG_NOSIGNAL; // report a lost connection as error instead of SIGPIPE
+#else // MSG_NOSIGNAL
+	const int send_flags = 0;
+#endif // MSG_NOSIGNAL
+	const int fd = sockets[peer];
+	ulong sent=0ull, received=0ull;
+	while(sent<bytes||received<bytes) { // send and receive at the same time, otherwise both processes could block in send() with full socket buffers
+		pollfd descriptor;
+		descriptor.fd = fd;
+		descriptor.events = (short)((sent<bytes ? POLLOUT : 0)|(received<bytes ? POLLIN : 0));
+		descriptor.revents = 0;
+		if(poll(&descriptor, 1, -1)<0) {
+			if(errno==EINTR) continue;
+			print_error("TCP exchange with process "+to_string(peer)+" failed: "+string(strerror(errno)));
+		}
+		if(sent<bytes&&(descriptor.revents&POLLOUT)) {
+			const ssize_t n = ::send(fd, (const char*)send+sent, (size_t)(bytes-sent), send_flags);
+			if(n>0) sent += (ulong)n;
+			else if(errno!=EAGAIN&&errno!=EWOULDBLOCK&&errno!=EINTR) print_error("TCP exchange with process "+to_string(peer)+" failed: "+string(strerror(errno)));
+		}
+		if(received<bytes&&(descriptor.revents&(POLLIN|POLLHUP|POLLERR))) {
+			const ssize_t n = ::recv(fd, (char*)receive+received, (size_t)(bytes-received), 0);
+			if(n>0) received += (ulong)n;
+			else if(n==0) print_error("Process "+to_string(peer)+" closed the connection.");
+			else if(errno!=EAGAIN&&errno!=EWOULDBLOCK&&errno!=EINTR) print_error("TCP exchange with process "+to_string(peer)+" failed: "+string(strerror(errno)));
+		}
+	}
+}
+
+#else // _WIN32
+
+struct SharedMemoryTransport::Ring {};
+SharedMemoryTransport::SharedMemoryTransport(const uint rank, const uint size, const string& session, const ulong capacity) {
+	print_error("Multi-process domain decomposition is only supported on POSIX systems.");
+}
+SharedMemoryTransport::~SharedMemoryTransport() {}
+void SharedMemoryTransport::exchange(const uint peer, const void* send, void* receive, const ulong bytes) {}
+SocketTransport::SocketTransport(const uint rank, const uint size, const vector<string>& hosts, const uint port) {
+	print_error("Multi-process domain decomposition is only supported on POSIX systems.");
+}
+SocketTransport::~SocketTransport() {}
+void SocketTransport::exchange(const uint peer, const void* send, void* receive, const ulong bytes) {}
+
+#endif // _WIN32
+
+HaloTransport* fx3d::create_transport() {
+	const uint rank=Settings::GetProcessRank(), size=Settings::GetProcessCount();
+	if(size<=1u) return nullptr;
+	if(Settings::GetTransport()==ProcessTransport::TRANSPORT_TCP) {
+		vector<string> hosts;
+		for(const string& host : split_regex(Settings::GetTransportHosts(), ",")) if(trim(host)!="") hosts.push_back(trim(host));
+		return new SocketTransport(rank, size, hosts, Settings::GetTransportPort());
+	}
+	return new SharedMemoryTransport(rank, size, Settings::GetTransportSession());
+}
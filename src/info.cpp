@@ -19,7 +19,8 @@ void Info::initialize(LBM* lbm) {
 	collision += " (FP32/FP32)";
 #endif // FP32
 	cpu_mem_required = (uint)(lbm->get_N()*(ulong)bytes_per_cell_host()/1048576ull); // reset to get valid values for consecutive simulations
-	gpu_mem_required = lbm->lbm[0]->get_device().info.memory_used;
+	gpu_mem_required = 0u;
+	for(uint d=0u; d<lbm->get_D(); d++) if(lbm->lbm[d]!=nullptr) gpu_mem_required = max(gpu_mem_required, lbm->lbm[d]->get_device().info.memory_used); // domains can have different sizes
 	print_info("Allocating memory. This may take a few seconds.");
 }
 void Info::append(const ulong steps, const ulong t) {
@@ -65,7 +66,9 @@ void Info::print_initialize() {
 	println("| Grid Domains    | "+alignr(57u, to_string(lbm->get_Dx())+" x "+to_string(lbm->get_Dy())+" x "+to_string(lbm->get_Dz())+" = "+to_string(lbm->get_D()))+" |");
 	println("| LBM Type        | "+alignr(57u, /***************/ "D"+to_string(lbm->get_velocity_set()==9?2:3)+"Q"+to_string(lbm->get_velocity_set())+" "+collision)+" |");
 	println("| Memory Usage    | "+alignr(54u, /*******/ "CPU "+to_string(cpu_mem_required)+" MB, GPU "+to_string(lbm->get_D())+"x "+to_string(gpu_mem_required))+" MB |");
-	println("| Max Alloc Size  | "+alignr(54u, /*************/ (uint)(lbm->get_N()/(ulong)lbm->get_D()*(ulong)(lbm->get_velocity_set()*sizeof(fpxx))/1048576ull))+" MB |");
+	ulong max_domain_N = 0ull;
+	for(uint d=0u; d<lbm->get_D(); d++) if(lbm->lbm[d]!=nullptr) max_domain_N = max(max_domain_N, lbm->lbm[d]->get_N()); // domains can have different sizes
+	println("| Max Alloc Size  | "+alignr(54u, /*************/ (uint)(max_domain_N*(ulong)(lbm->get_velocity_set()*sizeof(fpxx))/1048576ull))+" MB |");
 	println("| Time Steps      | "+alignr(57u, /***************************************************************/ (steps==max_ulong ? "infinite" : to_string(steps)))+" |");
 	println("| Kin. Viscosity  | "+alignr(57u, /*************************************************************************************/ to_string(lbm->get_nu(), 8u))+" |");
 	println("| Relaxation Time | "+alignr(57u, /************************************************************************************/ to_string(lbm->get_tau(), 8u))+" |");
@@ -759,11 +759,11 @@ string opencl_c_container() { return R( // ########################## begin of O
 		else if(xyz.x<0 || xyz.y<0 || xyz.z<0 || xyz.x>=(int)Nx-1 || xyz.y>=(int)Ny-1 || xyz.z>=(int)Nz-1) continue;
 		const uint x0 =  (uint)xyz.x; // cube stencil
 		const uint xp =  (uint)xyz.x+1u;
-		const uint y0 =  (uint)xyz.y    *Nx;
-		const uint yp = ((uint)xyz.y+1u)*Nx;
-		const uint z0 =  (uint)xyz.z    *Ny*Nx;
-		const uint zp = ((uint)xyz.z+1u)*Ny*Nx;
-		uint j[8];
+		const uxx y0 = (uxx)(uint)xyz.y     *Nx;
+		const uxx yp = (uxx)((uint)xyz.y+1u)*Nx;
+		const uxx z0 = (uxx)(uint)xyz.z     *Ny*Nx;
+		const uxx zp = (uxx)((uint)xyz.z+1u)*Ny*Nx;
+		uxx j[8];
 		j[0] = x0+y0+z0; // 000
 		j[1] = xp+y0+z0; // +00
 		j[2] = xp+y0+zp; // +0+
@@ -789,10 +789,10 @@ string opencl_c_container() { return R( // ########################## begin of O
 				if(intersect>0.0f) { // intersection found (there can only be exactly 1 intersection)
 					const uint xq =  ((uint)xyz.x   +2u)%Nx; // central difference stencil on each cube corner point
 					const uint xm =  ((uint)xyz.x+Nx-1u)%Nx;
-					const uint yq = (((uint)xyz.y   +2u)%Ny)*Nx;
-					const uint ym = (((uint)xyz.y+Ny-1u)%Ny)*Nx;
-					const uint zq = (((uint)xyz.z   +2u)%Nz)*Ny*Nx;
-					const uint zm = (((uint)xyz.z+Nz-1u)%Nz)*Ny*Nx;
+					const uxx yq = (uxx)(((uint)xyz.y   +2u)%Ny)*Nx;
+					const uxx ym = (uxx)(((uint)xyz.y+Ny-1u)%Ny)*Nx;
+					const uxx zq = (uxx)(((uint)xyz.z   +2u)%Nz)*Ny*Nx;
+					const uxx zm = (uxx)(((uint)xyz.z+Nz-1u)%Nz)*Ny*Nx;
 					float3 n[8];
 					n[0] = (float3)(phi[xm+y0+z0]-v[1], phi[x0+ym+z0]-v[4], phi[x0+y0+zm]-v[3]); // central difference stencil on each cube corner point
 					n[1] = (float3)(v[0]-phi[xq+y0+z0], phi[xp+ym+z0]-v[5], phi[xp+y0+zm]-v[2]); // compute normal vectors from gradient
@@ -921,11 +921,11 @@ string opencl_c_container() { return R( // ########################## begin of O
 		else if(xyz.x<=1 || xyz.y<=1 || xyz.z<=1 || xyz.x>=(int)Nx-2 || xyz.y>=(int)Ny-2 || xyz.z>=(int)Nz-2) continue;
 		const uint x0 =  (uint)xyz.x; // cube stencil
 		const uint xp =  (uint)xyz.x+1u;
-		const uint y0 =  (uint)xyz.y    *Nx;
-		const uint yp = ((uint)xyz.y+1u)*Nx;
-		const uint z0 =  (uint)xyz.z    *Ny*Nx;
-		const uint zp = ((uint)xyz.z+1u)*Ny*Nx;
-		uint j[8];
+		const uxx y0 = (uxx)(uint)xyz.y     *Nx;
+		const uxx yp = (uxx)((uint)xyz.y+1u)*Nx;
+		const uxx z0 = (uxx)(uint)xyz.z     *Ny*Nx;
+		const uxx zp = (uxx)((uint)xyz.z+1u)*Ny*Nx;
+		uxx j[8];
 		j[0] = x0+y0+z0; // 000
 		j[1] = xp+y0+z0; // +00
 		j[2] = xp+y0+zp; // +0+
@@ -988,12 +988,18 @@ string opencl_c_container() { return R( // ########################## begin of O
 
 // ################################################## LBM code ##################################################
 
-)+R(uint3 coordinates(const uint n) { // disassemble 1D index to 3D coordinates (n -> x,y,z)
-	const uint t = n%(def_Nx*def_Ny);
-	return (uint3)(t%def_Nx, t/def_Nx, n/(def_Nx*def_Ny)); // n = x+(y+z*Ny)*Nx
+)+R(uint3 coordinates(const uxx n) { // disassemble 1D index to 3D coordinates (n -> x,y,z)
+	const uxx t = n%((uxx)def_Nx*def_Ny);
+	return (uint3)((uint)(t%def_Nx), (uint)(t/def_Nx), (uint)(n/((uxx)def_Nx*def_Ny))); // n = x+(y+z*Ny)*Nx
 }
-)+R(uint index(const uint3 xyz) { // assemble 1D index from 3D coordinates (x,y,z -> n)
-	return xyz.x+(xyz.y+xyz.z*def_Ny)*def_Nx; // n = x+(y+z*Ny)*Nx
+)+R(uxx index(const uint3 xyz) { // assemble 1D index from 3D coordinates (x,y,z -> n)
+	return (uxx)xyz.x+((uxx)xyz.y+(uxx)xyz.z*def_Ny)*def_Nx; // n = x+(y+z*Ny)*Nx
+}
+)+R(uint3 global_xyz() { // 3D coordinates of this work-item in kernels that run on a 3D range over the lattice, no integer division needed
+	return (uint3)((uint)get_global_id(0), (uint)get_global_id(1), (uint)get_global_id(2));
+}
+)+R(bool is_outside(const uint3 xyz) { // 3D ranges are padded to multiples of the workgroup shape in every direction
+	return xyz.x>=def_Nx||xyz.y>=def_Ny||xyz.z>=def_Nz;
 }
 )+R(float3 position(const uint3 xyz) { // 3D coordinates to 3D position
 	return (float3)((float)xyz.x+0.5f-0.5f*(float)def_Nx, (float)xyz.y+0.5f-0.5f*(float)def_Ny, (float)xyz.z+0.5f-0.5f*(float)def_Nz);
@@ -1008,10 +1014,18 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+R(float3 mirror_distance(const float3 d) { // mirror distance vector into periodic boundaries
 	return mirror_position(d);
 }
-)+R(bool is_halo(const uint n) {
-	const uint3 xyz = coordinates(n);
+)+R(bool is_halo_xyz(const uint3 xyz) {
+	return ((def_Dx>1u)&(xyz.x<def_Hx||xyz.x>=def_Nx-def_Hx))||((def_Dy>1u)&(xyz.y<def_Hy||xyz.y>=def_Ny-def_Hy))||((def_Dz>1u)&(xyz.z<def_Hz||xyz.z>=def_Nz-def_Hz));
+}
+)+R(bool is_halo(const uxx n) {
+	return is_halo_xyz(coordinates(n));
+}
+)+R(bool is_halo_outer_xyz(const uint3 xyz) { // outermost halo layer, has no neighbors to stream from, with a single halo layer this is the same as is_halo()
 	return ((def_Dx>1u)&(xyz.x==0u||xyz.x>=def_Nx-1u))||((def_Dy>1u)&(xyz.y==0u||xyz.y>=def_Ny-1u))||((def_Dz>1u)&(xyz.z==0u||xyz.z>=def_Nz-1u));
 }
+)+R(bool is_halo_outer(const uxx n) {
+	return is_halo_outer_xyz(coordinates(n));
+}
 )+R(bool is_halo_q(const uint3 xyz) {
 	return ((def_Dx>1u)&(xyz.x==0u||xyz.x>=def_Nx-2u))||((def_Dy>1u)&(xyz.y==0u||xyz.y>=def_Ny-2u))||((def_Dz>1u)&(xyz.z==0u||xyz.z>=def_Nz-2u)); // halo data is kept up-to-date, so allow using halo data for rendering
 }
@@ -1029,8 +1043,54 @@ string opencl_c_container() { return R( // ########################## begin of O
 	return (b&0x80000000)>>16 | (e>112)*((((e-112)<<11)&0x7800)|m>>12) | ((e<113)&(e>100))*((((0x007FF800+m)>>(124-e))+1)>>1); // sign : normalized : denormalized (assume [-2,2])
 }
 
-)+R(ulong index_f(const uint n, const uint i) { // 64-bit indexing (maximum 2^32 lattice points (1624^3 lattice resolution, 225GB)
-	return (ulong)i*def_N+(ulong)n; // SoA (229% faster on GPU)
+)+"#if defined(DDF_BRICK)||defined(DDF_MORTON)"+R(
+)+R(uint cell_in_tile(const uint x, const uint y, const uint z) { // position of a lattice point within its brick/tile, x/y/z are local coordinates in the tile
+)+"#ifndef DDF_MORTON"+R(
+	return x+(y+z*def_By)*def_Bx;
+)+"#else"+R( // DDF_MORTON
+	uint cell=0u, k=0u; // interleave coordinate bits (Morton/Z-order curve), tile edges are powers of 2 up to 4, so the loop is unrolled at compile time
+	for(uint b=1u; b<4u; b<<=1u) {
+		if(b<def_Bx) cell |= ((x/b)&1u)<<k++;
+		if(b<def_By) cell |= ((y/b)&1u)<<k++;
+		if(b<def_Bz) cell |= ((z/b)&1u)<<k++;
+	}
+	return cell;
+)+"#endif"+R( // DDF_MORTON
+}
+)+R(ulong index_tiled(const uxx n, const uint i, const uint q) { // DDFs stored in bricks/tiles of def_Bx*def_By*def_Bz lattice points, so neighbor accesses stay within few cache lines and pages
+	const uint3 xyz = coordinates(n);
+	const uxx brick = (uxx)(xyz.x/def_Bx)+((uxx)(xyz.y/def_By)+(uxx)(xyz.z/def_Bz)*(def_Ny/def_By))*(def_Nx/def_Bx);
+	const uint cell = cell_in_tile(xyz.x%def_Bx, xyz.y%def_By, xyz.z%def_Bz);
+)+"#ifdef DDF_BRICK"+R(
+	return ((ulong)brick*(ulong)q+(ulong)i)*(ulong)(def_Bx*def_By*def_Bz)+(ulong)cell; // AoSoA: all q DDFs of a brick are contiguous
+)+"#else"+R( // DDF_BRICK
+	return (ulong)i*def_N+(ulong)brick*(ulong)(def_Bx*def_By*def_Bz)+(ulong)cell; // SoA with lattice points reordered tile by tile
+)+"#endif"+R( // DDF_BRICK
+}
+)+"#endif"+R( // DDF_BRICK||DDF_MORTON
+)+R(ulong index_f(const uxx n, const uint i) { // 64-bit DDF indexing, n is only 64-bit if the domain has 2^32 or more lattice points (1624^3 lattice resolution, 225GB)
+)+"#ifndef DDF_SPLIT"+R(
+	const uint k=i, q=def_velocity_set; // direction within its buffer, number of directions in the buffer
+)+"#else"+R( // DDF_SPLIT
+	const uint k=i%def_fi_group, q=i/def_fi_group<def_fi_buffers-1u ? def_fi_group : def_velocity_set-(def_fi_buffers-1u)*def_fi_group; // index relative to buffer ddf(fi, i), the last buffer holds the remaining directions
+)+"#endif"+R( // DDF_SPLIT
+)+"#if !defined(DDF_BRICK)&&!defined(DDF_MORTON)"+R(
+	return (ulong)k*def_N+(ulong)n; // SoA (229% faster on GPU)
+)+"#else"+R( // DDF_BRICK||DDF_MORTON
+	return index_tiled(n, k, q);
+)+"#endif"+R( // DDF_BRICK||DDF_MORTON
+}
+)+R(ulong index_g(const uxx n, const uint i) { // index of thermal DDFs (D3Q7), same layout as index_f()
+)+"#ifndef DDF_SPLIT"+R(
+	const uint k=i, q=7u; // direction within its buffer, number of directions in the buffer
+)+"#else"+R( // DDF_SPLIT
+	const uint k=i%def_gi_group, q=i/def_gi_group<def_gi_buffers-1u ? def_gi_group : 7u-(def_gi_buffers-1u)*def_gi_group; // index relative to buffer ddf(gi, i)
+)+"#endif"+R( // DDF_SPLIT
+)+"#if !defined(DDF_BRICK)&&!defined(DDF_MORTON)"+R(
+	return (ulong)k*def_N+(ulong)n; // SoA
+)+"#else"+R( // DDF_BRICK||DDF_MORTON
+	return index_tiled(n, k, q);
+)+"#endif"+R( // DDF_BRICK||DDF_MORTON
 }
 )+R(float c(const uint i) { // avoid constant keyword by encapsulating data in function which gets inlined by compiler
 	const float c[3u*def_velocity_set] = {
@@ -1072,22 +1132,21 @@ string opencl_c_container() { return R( // ########################## begin of O
 	};
 	return w[i];
 }
-)+R(void calculate_indices(const uint n, uint* x0, uint* xp, uint* xm, uint* y0, uint* yp, uint* ym, uint* z0, uint* zp, uint* zm) {
-	const uint3 xyz = coordinates(n);
-	*x0 =   xyz.x; // pre-calculate indices (periodic boundary conditions)
-	*xp =  (xyz.x       +1u)%def_Nx;
-	*xm =  (xyz.x+def_Nx-1u)%def_Nx;
-	*y0 =   xyz.y                   *def_Nx;
-	*yp = ((xyz.y       +1u)%def_Ny)*def_Nx;
-	*ym = ((xyz.y+def_Ny-1u)%def_Ny)*def_Nx;
-	*z0 =   xyz.z                   *def_Ny*def_Nx;
-	*zp = ((xyz.z       +1u)%def_Nz)*def_Ny*def_Nx;
-	*zm = ((xyz.z+def_Nz-1u)%def_Nz)*def_Ny*def_Nx;
+)+R(void calculate_indices(const uint3 xyz, uxx* x0, uxx* xp, uxx* xm, uxx* y0, uxx* yp, uxx* ym, uxx* z0, uxx* zp, uxx* zm) {
+	*x0 =        xyz.x; // pre-calculate indices (periodic boundary conditions)
+	*xp =       (xyz.x       +1u)%def_Nx;
+	*xm =       (xyz.x+def_Nx-1u)%def_Nx;
+	*y0 = (uxx)  xyz.y                   *def_Nx;
+	*yp = (uxx)((xyz.y       +1u)%def_Ny)*def_Nx;
+	*ym = (uxx)((xyz.y+def_Ny-1u)%def_Ny)*def_Nx;
+	*z0 = (uxx)  xyz.z                   *def_Ny*def_Nx;
+	*zp = (uxx)((xyz.z       +1u)%def_Nz)*def_Ny*def_Nx;
+	*zm = (uxx)((xyz.z+def_Nz-1u)%def_Nz)*def_Ny*def_Nx;
 } // calculate_indices()
-)+R(void neighbors(const uint n, uint* j) { // calculate neighbor indices
-	uint x0, xp, xm, y0, yp, ym, z0, zp, zm;
-	calculate_indices(n, &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
-	j[0] = n;
+)+R(void neighbors_xyz(const uint3 xyz, uxx* j) { // calculate neighbor indices
+	uxx x0, xp, xm, y0, yp, ym, z0, zp, zm;
+	calculate_indices(xyz, &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
+	j[0] = x0+y0+z0;
 )+"#if defined(D2Q9)"+R(
 	j[ 1] = xp+y0; j[ 2] = xm+y0; // +00 -00
 	j[ 3] = x0+yp; j[ 4] = x0+ym; // 0+0 0-0
@@ -1126,16 +1185,19 @@ string opencl_c_container() { return R( // ########################## begin of O
 	j[23] = xp+ym+zp; j[24] = xm+yp+zm; // +-+ -+-
 	j[25] = xm+yp+zp; j[26] = xp+ym+zm; // -++ +--
 )+"#endif"+R( // D3Q27
-} // neighbors()
+} // neighbors_xyz()
+)+R(void neighbors(const uxx n, uxx* j) { // calculate neighbor indices
+	neighbors_xyz(coordinates(n), j);
+}
 
-)+R(float3 load_u(const uint n, const global float* u) {
+)+R(float3 load_u(const uxx n, const global float* u) {
 	return (float3)(u[n], u[def_N+(ulong)n], u[2ul*def_N+(ulong)n]);
 }
 )+R(float3 closest_u(const float3 p, const global float* u) { // return velocity of closest lattice point to point p
 	const uint x = (uint)(p.x+1.5f*(float)def_Nx)%def_Nx;
 	const uint y = (uint)(p.y+1.5f*(float)def_Ny)%def_Ny;
 	const uint z = (uint)(p.z+1.5f*(float)def_Nz)%def_Nz;
-	const uint n = x+(y+z*def_Ny)*def_Nx;
+	const uxx n = index((uint3)(x, y, z));
 	return load_u(n, u);
 } // closest_u()
 )+R(float3 interpolate_u(const float3 p, const global float* u) { // trilinear interpolation of velocity at point p
@@ -1146,7 +1208,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 	for(uint c=0u; c<8u; c++) { // count over eight corner points
 		const uint i=(c&0x04u)>>2, j=(c&0x02u)>>1, k=c&0x01u; // disassemble c into corner indices ijk
 		const uint x=(xb+i)%def_Nx, y=(yb+j)%def_Ny, z=(zb+k)%def_Nz; // calculate corner lattice positions
-		const uint n = x+(y+z*def_Ny)*def_Nx; // calculate lattice linear index
+		const uxx n = index((uint3)(x, y, z)); // calculate lattice linear index
 		un[c] = load_u(n, u); // load velocity from lattice point
 	}
 	return (x0*y0*z0)*un[0]+(x0*y0*z1)*un[1]+(x0*y1*z0)*un[2]+(x0*y1*z1)*un[3]+(x1*y0*z0)*un[4]+(x1*y0*z1)*un[5]+(x1*y1*z0)*un[6]+(x1*y1*z1)*un[7]; // perform trilinear interpolation
@@ -1162,10 +1224,10 @@ string opencl_c_container() { return R( // ########################## begin of O
 	const float s2 = 2.0f*(sq(s_xx2)+sq(s_yy2)+sq(s_zz2))+sq(s_xy)+sq(s_xz)+sq(s_yz); // ||s||_2^2
 	return 0.25f*(omega2-s2); // Q = 1/2*(||omega||_2^2-||s||_2^2), addidional factor 1/2 from cental finite differences of velocity
 } // calculate_Q_cached()
-)+R(float calculate_Q(const uint n, const global float* u) { // Q-criterion
-	uint x0, xp, xm, y0, yp, ym, z0, zp, zm;
-	calculate_indices(n, &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
-	uint j[6];
+)+R(float calculate_Q(const uxx n, const global float* u) { // Q-criterion
+	uxx x0, xp, xm, y0, yp, ym, z0, zp, zm;
+	calculate_indices(coordinates(n), &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
+	uxx j[6];
 	j[0] = xp+y0+z0; j[1] = xm+y0+z0; // +00 -00
 	j[2] = x0+yp+z0; j[3] = x0+ym+z0; // 0+0 0-0
 	j[4] = x0+y0+zp; j[5] = x0+y0+zm; // 00+ 00-
@@ -1268,19 +1330,33 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#endif"+R( // VOLUME_FORCE
 
 )+"#ifdef MOVING_BOUNDARIES"+R(
-)+R(void apply_moving_boundaries(float* fhn, const uint* j, const global float* u, const global uchar* flags) { // apply Dirichlet velocity boundaries if necessary (Krueger p.180, rho_solid=1)
-	uint ji; // reads velocities of only neighboring boundary nodes, which do not change during simulation
+)+R(uint solid_neighbors_mask(const uxx* j, const global uchar* flags) { // bit i is set if neighbor i is solid, def_velocity_set is at most 27
+	uint mask = 0u;
+	for(uint i=1u; i<def_velocity_set; i++) mask |= (uint)((flags[j[i]]&TYPE_BO)==TYPE_S)<<i;
+	return mask;
+}
+)+R(void apply_moving_boundaries(float* fhn, const uxx* j, const global float* u, const uint solid) { // apply Dirichlet velocity boundaries if necessary (Krueger p.180, rho_solid=1), bit i of solid is set if neighbor i is solid
+	uxx ji; // reads velocities of only neighboring boundary nodes, which do not change during simulation
 	for(uint i=1u; i<def_velocity_set; i+=2u) { // loop is entirely unrolled by compiler, no unnecessary memory access is happening
 		const float w6 = -6.0f*w(i); // w(i) = w(i+1) if i is odd
-		ji = j[i+1u]; fhn[i   ] = (flags[ji]&TYPE_BO)==TYPE_S ? fma(w6, c(i+1u)*u[ji]+c(def_velocity_set+i+1u)*u[def_N+(ulong)ji]+c(2u*def_velocity_set+i+1u)*u[2ul*def_N+(ulong)ji], fhn[i   ]) : fhn[i   ]; // boundary : regular
-		ji = j[i   ]; fhn[i+1u] = (flags[ji]&TYPE_BO)==TYPE_S ? fma(w6, c(i   )*u[ji]+c(def_velocity_set+i   )*u[def_N+(ulong)ji]+c(2u*def_velocity_set+i   )*u[2ul*def_N+(ulong)ji], fhn[i+1u]) : fhn[i+1u];
+		ji = j[i+1u]; fhn[i   ] = (solid>>(i+1u))&1u ? fma(w6, c(i+1u)*u[ji]+c(def_velocity_set+i+1u)*u[def_N+(ulong)ji]+c(2u*def_velocity_set+i+1u)*u[2ul*def_N+(ulong)ji], fhn[i   ]) : fhn[i   ]; // boundary : regular
+		ji = j[i   ]; fhn[i+1u] = (solid>>i)&1u ? fma(w6, c(i   )*u[ji]+c(def_velocity_set+i   )*u[def_N+(ulong)ji]+c(2u*def_velocity_set+i   )*u[2ul*def_N+(ulong)ji], fhn[i+1u]) : fhn[i+1u];
 	}
 } // apply_moving_boundaries()
+)+"#ifdef NEIGHBOR_MASKS"+R(
+)+R(kernel void update_neighbor_masks(const global uchar* flags, global uint* solid_neighbors) { // rebuild solid neighbor masks, only necessary when solids change
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)) return;
+	uxx j[def_velocity_set]; // neighbor indices
+	neighbors_xyz(xyz, j); // calculate neighbor indices
+	solid_neighbors[index(xyz)] = solid_neighbors_mask(j, flags);
+}
+)+"#endif"+R( // NEIGHBOR_MASKS
 )+"#endif"+R( // MOVING_BOUNDARIES
 
 )+"#ifdef SURFACE"+R(
-)+R(void average_neighbors_non_gas(const uint n, const global float* rho, const global float* u, const global uchar* flags, float* rhon, float* uxn, float* uyn, float* uzn) { // calculate average density and velocity of neighbors of node n
-	uint j[def_velocity_set]; // neighbor indices
+)+R(void average_neighbors_non_gas(const uxx n, const global float* rho, const global float* u, const global uchar* flags, float* rhon, float* uxn, float* uyn, float* uzn) { // calculate average density and velocity of neighbors of node n
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	float rhot=0.0f, uxt=0.0f, uyt=0.0f, uzt=0.0f, counter=0.0f; // average over all fluid/interface neighbors
 	for(uint i=1u; i<def_velocity_set; i++) {
@@ -1298,8 +1374,8 @@ string opencl_c_container() { return R( // ########################## begin of O
 	*uyn  = counter>0.0f ? uyt /counter : 0.0f;
 	*uzn  = counter>0.0f ? uzt /counter : 0.0f;
 }
-)+R(void average_neighbors_fluid(const uint n, const global float* rho, const global float* u, const global uchar* flags, float* rhon, float* uxn, float* uyn, float* uzn) { // calculate average density and velocity of neighbors of node n
-	uint j[def_velocity_set]; // neighbor indices
+)+R(void average_neighbors_fluid(const uxx n, const global float* rho, const global float* u, const global uchar* flags, float* rhon, float* uxn, float* uyn, float* uzn) { // calculate average density and velocity of neighbors of node n
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	float rhot=0.0f, uxt=0.0f, uyt=0.0f, uzt=0.0f, counter=0.0f; // average over all fluid/interface neighbors
 	for(uint i=1u; i<def_velocity_set; i++) {
@@ -1357,13 +1433,13 @@ string opencl_c_container() { return R( // ########################## begin of O
 	const float d = plic_cube_reduced(V, n1, n2, n3); // calculate PLIC with reduced symmetry
 	return l*copysign(0.5f-d, V0-0.5f); // rescale result and apply symmetry for V0>0.5
 }
-)+R(void get_remaining_neighbor_phij(const uint n, const float* phit, const global float* phi, float* phij) { // get remaining phij for D3Q27 neighborhood
+)+R(void get_remaining_neighbor_phij(const uxx n, const float* phit, const global float* phi, float* phij) { // get remaining phij for D3Q27 neighborhood
 )+"#ifndef D3Q27"+R(
-	uint x0, xp, xm, y0, yp, ym, z0, zp, zm;
-	calculate_indices(n, &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
+	uxx x0, xp, xm, y0, yp, ym, z0, zp, zm;
+	calculate_indices(coordinates(n), &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
 )+"#endif"+R( // D3Q27
 )+"#if defined(D3Q15)"+R(
-	uint j[12]; // calculate neighbor indices
+	uxx j[12]; // calculate neighbor indices
 	j[ 0] = xp+yp+z0; j[ 1] = xm+ym+z0; // ++0 --0
 	j[ 2] = xp+y0+zp; j[ 3] = xm+y0+zm; // +0+ -0-
 	j[ 4] = x0+yp+zp; j[ 5] = x0+ym+zm; // 0++ 0--
@@ -1374,7 +1450,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 	for(uint i=7u; i<19u; i++) phij[i] = phi[j[i-7u]];
 	for(uint i=19u; i<27u; i++) phij[i] = phit[i-12u];
 )+"#elif defined(D3Q19)"+R(
-	uint j[8]; // calculate remaining neighbor indices
+	uxx j[8]; // calculate remaining neighbor indices
 	j[0] = xp+yp+zp; j[1] = xm+ym+zm; // +++ ---
 	j[2] = xp+yp+zm; j[3] = xm+ym+zp; // ++- --+
 	j[4] = xp+ym+zp; j[5] = xm+yp+zm; // +-+ -+-
@@ -1393,10 +1469,8 @@ string opencl_c_container() { return R( // ########################## begin of O
 	};
 	return c[i];
 }
-)+R(float calculate_curvature(const uint n, const float* phit, const global float* phi) { // calculate surface curvature, always use D3Q27 stencil here, source: https://doi.org/10.3390/computation10020021
+)+R(float calculate_curvature_phij(const float* phij) { // calculate surface curvature from the D3Q27 (3D) or D2Q9 (2D) fill level neighborhood, source: https://doi.org/10.3390/computation10020021
 )+"#ifndef D2Q9"+R(
-	float phij[27];
-	get_remaining_neighbor_phij(n, phit, phi, phij); // complete neighborhood from whatever velocity set is selected to D3Q27
 	const float3 bz = calculate_normal_py(phij); // new coordinate system: bz is normal to surface, bx and by are tangent to surface
 	const float3 rn = (float3)(0.56270900f, 0.32704452f, 0.75921047f); // random normalized vector that is just by random chance not collinear with bz
 	const float3 by = normalize(cross(bz, rn)); // normalize() is necessary here because bz and rn are not perpendicular
@@ -1429,15 +1503,15 @@ string opencl_c_container() { return R( // ########################## begin of O
 	const float A=x[0], B=x[1], C=x[2], H=x[3], I=x[4];
 	const float K = (A*(I*I+1.0f)+B*(H*H+1.0f)-C*H*I)*cb(rsqrt(H*H+I*I+1.0f)); // mean curvature of Monge patch (x, y, f(x, y))
 )+"#else"+R( // D2Q9
-	const float3 by = calculate_normal_py(phit); // new coordinate system: bz is normal to surface, bx and by are tangent to surface
+	const float3 by = calculate_normal_py(phij); // new coordinate system: bz is normal to surface, bx and by are tangent to surface
 	const float3 bx = cross(by, (float3)(0.0f, 0.0f, 1.0f)); // normalize() is necessary here because bz and rn are not perpendicular
 	uint number = 0u; // number of neighboring interface points
 	float2 p[6]; // number of neighboring interface points is less or equal than than 8 minus 1 gas and minus 1 fluid point = 6
-	const float center_offset = plic_cube(phit[0], by); // calculate z-offset PLIC of center point only once
+	const float center_offset = plic_cube(phij[0], by); // calculate z-offset PLIC of center point only once
 	for(uint i=1u; i<9u; i++) { // iterate over neighbors, no loop unrolling here (50% better perfoemance without loop unrolling)
-		if(phit[i]>0.0f&&phit[i]<1.0f) { // limit neighbors to interface nodes
+		if(phij[i]>0.0f&&phij[i]<1.0f) { // limit neighbors to interface nodes
 			const float3 ei = (float3)(c(i), c(9u+i), 0.0f); // assume neighbor normal vector is the same as center normal vector
-			const float offset = plic_cube(phit[i], by)-center_offset;
+			const float offset = plic_cube(phij[i], by)-center_offset;
 			p[number++] = (float2)(dot(ei, bx), dot(ei, by)+offset); // do coordinate system transformation into (x, f(x)) and apply PLIC pffsets
 		}
 	}
@@ -1455,17 +1529,46 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#endif"+R( // D2Q9
 	return clamp(K, -1.0f, 1.0f); // prevent extreme pressures in the case of almost degenerate matrices
 }
+)+R(float calculate_curvature(const uxx n, const float* phit, const global float* phi) { // calculate surface curvature, always use D3Q27 stencil here
+)+"#ifndef D2Q9"+R(
+	float phij[27];
+	get_remaining_neighbor_phij(n, phit, phi, phij); // complete neighborhood from whatever velocity set is selected to D3Q27
+	return calculate_curvature_phij(phij);
+)+"#else"+R( // D2Q9
+	return calculate_curvature_phij(phit);
+)+"#endif"+R( // D2Q9
+}
+)+"#ifdef SURFACE_LOCAL"+R(
+)+R(void load_surface_tile(const global float* phi, const global uchar* flags, local float* phi_tile, local uchar* flags_tile) { // stage phi and flags of the workgroup tile plus one layer of neighbors in local memory, all work-items of the workgroup have to call this
+	const uint gx=(uint)(get_group_id(0)*get_local_size(0)), gy=(uint)(get_group_id(1)*get_local_size(1)), gz=(uint)(get_group_id(2)*get_local_size(2)); // first lattice point of the workgroup
+	const uint lid = (uint)(get_local_id(0)+(get_local_id(1)+get_local_id(2)*get_local_size(1))*get_local_size(0));
+	const uint lsize = (uint)(get_local_size(0)*get_local_size(1)*get_local_size(2));
+	for(uint i=lid; i<def_tile_N; i+=lsize) { // every value is loaded from global memory only once per workgroup
+		const uint tx=i%def_tile_x, ty=(i/def_tile_x)%def_tile_y, tz=i/(def_tile_x*def_tile_y);
+		const uxx m = index((uint3)((gx+tx+def_Nx-1u)%def_Nx, (gy+ty+def_Ny-1u)%def_Ny, (gz+tz+def_Nz-1u)%def_Nz)); // periodic wrap like in neighbors()
+		phi_tile[i] = phi[m];
+		flags_tile[i] = flags[m];
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+}
+)+R(uint tile_neighbor(const float cx, const float cy, const float cz) { // index of the neighbor in direction (cx, cy, cz) of this work-item in the workgroup tile
+	return (uint)((int)get_local_id(0)+1+(int)cx)+((uint)((int)get_local_id(1)+1+(int)cy)+(uint)((int)get_local_id(2)+1+(int)cz)*def_tile_y)*def_tile_x;
+}
+)+"#endif"+R( // SURFACE_LOCAL
 )+"#endif"+R( // SURFACE
 
 )+"#ifdef TEMPERATURE"+R(
-)+R(void neighbors_temperature(const uint n, uint* j7) { // calculate neighbor indices
-	uint x0, xp, xm, y0, yp, ym, z0, zp, zm;
-	calculate_indices(n, &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
-	j7[0] = n;
+)+R(void neighbors_temperature_xyz(const uint3 xyz, uxx* j7) { // calculate neighbor indices
+	uxx x0, xp, xm, y0, yp, ym, z0, zp, zm;
+	calculate_indices(xyz, &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
+	j7[0] = x0+y0+z0;
 	j7[1] = xp+y0+z0; j7[2] = xm+y0+z0; // +00 -00
 	j7[3] = x0+yp+z0; j7[4] = x0+ym+z0; // 0+0 0-0
 	j7[5] = x0+y0+zp; j7[6] = x0+y0+zm; // 00+ 00-
 }
+)+R(void neighbors_temperature(const uxx n, uxx* j7) { // calculate neighbor indices
+	neighbors_temperature_xyz(coordinates(n), j7);
+}
 )+R(void calculate_g_eq(const float T, const float ux, const float uy, const float uz, float* geq) { // calculate g_equilibrium from density and velocity field (perturbation method / DDF-shifting)
 	const float wsT4=0.5f*T, wsTm1=0.125f*(T-1.0f); // 0.125f*T*4.0f (straight directions in D3Q7), wsTm1 is arithmetic optimization to minimize digit extinction, lattice speed of sound is 1/2 for D3Q7 and not 1/sqrt(3)
 	geq[0] = fma(0.25f, T, -0.25f); // 000
@@ -1473,48 +1576,54 @@ string opencl_c_container() { return R( // ########################## begin of O
 	geq[3] = fma(wsT4, uy, wsTm1); geq[4] = fma(wsT4, -uy, wsTm1); // 0+0 0-0
 	geq[5] = fma(wsT4, uz, wsTm1); geq[6] = fma(wsT4, -uz, wsTm1); // 00+ 00-
 }
-)+R(void load_g(const uint n, float* ghn, const global fpxx* gi, const uint* j7, const ulong t) {
-	ghn[0] = load(gi, index_f(n, 0u)); // Esoteric-Pull
+)+R(void load_g(const uxx n, float* ghn, ddfs(const global fpxx*, gi), const uxx* j7, const ulong t) {
+	ghn[0] = load(ddf(gi, 0u), index_g(n, 0u)); // Esoteric-Pull
 	for(uint i=1u; i<7u; i+=2u) {
-		ghn[i   ] = load(gi, index_f(n    , t%2ul ? i    : i+1u));
-		ghn[i+1u] = load(gi, index_f(j7[i], t%2ul ? i+1u : i   ));
+		ghn[i   ] = load(ddf(gi, t%2ul ? i    : i+1u), index_g(n    , t%2ul ? i    : i+1u));
+		ghn[i+1u] = load(ddf(gi, t%2ul ? i+1u : i   ), index_g(j7[i], t%2ul ? i+1u : i   ));
 	}
 }
-)+R(void store_g(const uint n, const float* ghn, global fpxx* gi, const uint* j7, const ulong t) {
-	store(gi, index_f(n, 0u), ghn[0]); // Esoteric-Pull
+)+R(void store_g(const uxx n, const float* ghn, ddfs(global fpxx*, gi), const uxx* j7, const ulong t) {
+	store(ddf(gi, 0u), index_g(n, 0u), ghn[0]); // Esoteric-Pull
 	for(uint i=1u; i<7u; i+=2u) {
-		store(gi, index_f(j7[i], t%2ul ? i+1u : i   ), ghn[i   ]);
-		store(gi, index_f(n    , t%2ul ? i    : i+1u), ghn[i+1u]);
+		store(ddf(gi, t%2ul ? i+1u : i   ), index_g(j7[i], t%2ul ? i+1u : i   ), ghn[i   ]);
+		store(ddf(gi, t%2ul ? i    : i+1u), index_g(n    , t%2ul ? i    : i+1u), ghn[i+1u]);
 	}
 }
 )+"#endif"+R( // TEMPERATURE
 
-)+R(void load_f(const uint n, float* fhn, const global fpxx* fi, const uint* j, const ulong t) {
-	fhn[0] = load(fi, index_f(n, 0u)); // Esoteric-Pull
+)+R(void load_f(const uxx n, float* fhn, ddfs(const global fpxx*, fi), const uxx* j, const ulong t) {
+	fhn[0] = load(ddf(fi, 0u), index_f(n, 0u)); // Esoteric-Pull
 	for(uint i=1u; i<def_velocity_set; i+=2u) {
-		fhn[i   ] = load(fi, index_f(n   , t%2ul ? i    : i+1u));
-		fhn[i+1u] = load(fi, index_f(j[i], t%2ul ? i+1u : i   ));
+		fhn[i   ] = load(ddf(fi, t%2ul ? i    : i+1u), index_f(n   , t%2ul ? i    : i+1u));
+		fhn[i+1u] = load(ddf(fi, t%2ul ? i+1u : i   ), index_f(j[i], t%2ul ? i+1u : i   ));
 	}
 }
-)+R(void store_f(const uint n, const float* fhn, global fpxx* fi, const uint* j, const ulong t) {
-	store(fi, index_f(n, 0u), fhn[0]); // Esoteric-Pull
+)+R(void store_f(const uxx n, const float* fhn, ddfs(global fpxx*, fi), const uxx* j, const ulong t) {
+	store(ddf(fi, 0u), index_f(n, 0u), fhn[0]); // Esoteric-Pull
 	for(uint i=1u; i<def_velocity_set; i+=2u) {
-		store(fi, index_f(j[i], t%2ul ? i+1u : i   ), fhn[i   ]);
-		store(fi, index_f(n   , t%2ul ? i    : i+1u), fhn[i+1u]);
+		store(ddf(fi, t%2ul ? i+1u : i   ), index_f(j[i], t%2ul ? i+1u : i   ), fhn[i   ]);
+		store(ddf(fi, t%2ul ? i    : i+1u), index_f(n   , t%2ul ? i    : i+1u), fhn[i+1u]);
 	}
 }
 
 )+"#ifdef SURFACE"+R(
-)+R(void load_f_outgoing(const uint n, float* fon, const global fpxx* fi, const uint* j, const ulong t) { // load outgoing DDFs, even: 1:1 like stream-out odd, odd: 1:1 like stream-out even
+)+"#ifdef SURFACE_LIST"+R(
+)+R(void append_surface_list(const uxx n, global uxx* surface_list, volatile global uint* surface_count, const uint offset) { // add lattice point with a flag change to the list for surface_1() and surface_2(), behind the offset first list entries
+	const uint i = offset+atomic_inc(surface_count);
+	if(i<def_surface_list) surface_list[i] = n; // on overflow, surface_1() and surface_2() scan the whole lattice instead
+}
+)+"#endif"+R( // SURFACE_LIST
+)+R(void load_f_outgoing(const uxx n, float* fon, ddfs(const global fpxx*, fi), const uxx* j, const ulong t) { // load outgoing DDFs, even: 1:1 like stream-out odd, odd: 1:1 like stream-out even
 	for(uint i=1u; i<def_velocity_set; i+=2u) { // Esoteric-Pull
-		fon[i   ] = load(fi, index_f(j[i], t%2ul ? i    : i+1u));
-		fon[i+1u] = load(fi, index_f(n   , t%2ul ? i+1u : i   ));
+		fon[i   ] = load(ddf(fi, t%2ul ? i    : i+1u), index_f(j[i], t%2ul ? i    : i+1u));
+		fon[i+1u] = load(ddf(fi, t%2ul ? i+1u : i   ), index_f(n   , t%2ul ? i+1u : i   ));
 	}
 }
-)+R(void store_f_reconstructed(const uint n, const float* fhn, global fpxx* fi, const uint* j, const ulong t, const uchar* flagsj_su) { // store reconstructed gas DDFs, even: 1:1 like stream-in even, odd: 1:1 like stream-in odd
+)+R(void store_f_reconstructed(const uxx n, const float* fhn, ddfs(global fpxx*, fi), const uxx* j, const ulong t, const uchar* flagsj_su) { // store reconstructed gas DDFs, even: 1:1 like stream-in even, odd: 1:1 like stream-in odd
 	for(uint i=1u; i<def_velocity_set; i+=2u) { // Esoteric-Pull
-		if(flagsj_su[i+1u]==TYPE_G) store(fi, index_f(n   , t%2ul ? i    : i+1u), fhn[i   ]); // only store reconstructed gas DDFs to locations from which
-		if(flagsj_su[i   ]==TYPE_G) store(fi, index_f(j[i], t%2ul ? i+1u : i   ), fhn[i+1u]); // they are going to be streamed in during next stream_collide()
+		if(flagsj_su[i+1u]==TYPE_G) store(ddf(fi, t%2ul ? i    : i+1u), index_f(n   , t%2ul ? i    : i+1u), fhn[i   ]); // only store reconstructed gas DDFs to locations from which
+		if(flagsj_su[i   ]==TYPE_G) store(ddf(fi, t%2ul ? i+1u : i   ), index_f(j[i], t%2ul ? i+1u : i   ), fhn[i+1u]); // they are going to be streamed in during next stream_collide()
 	}
 }
 )+"#endif"+R( // SURFACE
@@ -1527,13 +1636,15 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#endif"+R( // SURFACE
 )+"#ifdef TEMPERATURE"+R(
 	, global fpxx* gi, const global float* T // argument order is important
+	ddfs_tail(global fpxx*, gi)
 )+"#endif"+R( // TEMPERATURE
+	ddfs_tail(global fpxx*, fi) // further DDF buffers if the DDFs are split, always the last arguments
 )+") {"+R( // initialize()
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute initialize() on halo
+	const uxx n = get_global_id(0); // n = x+(y+z*Ny)*Nx
+	if(n>=(uxx)def_N||is_halo(n)) return; // don't execute initialize() on halo
 	uchar flagsn = flags[n];
 	const uchar flagsn_bo = flagsn&TYPE_BO; // extract boundary flags
-	uint j[def_velocity_set]; // neighbor indices
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	uchar flagsj[def_velocity_set]; // cache neighbor flags for multiple readings
 	for(uint i=1u; i<def_velocity_set; i++) flagsj[i] = flags[j[i]];
@@ -1597,21 +1708,21 @@ string opencl_c_container() { return R( // ########################## begin of O
 	{ // separate block to avoid variable name conflicts
 		float geq[7];
 		calculate_g_eq(T[n], u[n], u[def_N+(ulong)n], u[2ul*def_N+(ulong)n], geq);
-		uint j7[7]; // neighbors of D3Q7 subset
+		uxx j7[7]; // neighbors of D3Q7 subset
 		neighbors_temperature(n, j7);
-		store_g(n, geq, gi, j7, 1ul);
+		store_g(n, geq, ddfs_pass(gi), j7, 1ul);
 	}
 )+"#endif"+R( // TEMPERATURE
-	store_f(n, feq, fi, j, 1ul); // write to fi
+	store_f(n, feq, ddfs_pass(fi), j, 1ul); // write to fi
 } // initialize()
 
 )+"#ifdef MOVING_BOUNDARIES"+R(
 )+R(kernel void update_moving_boundaries(const global float* u, global uchar* flags) { // mark/unmark nodes next to TYPE_S nodes with velocity!=0 with TYPE_MS
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute update_moving_boundaries() on halo
+	const uxx n = get_global_id(0); // n = x+(y+z*Ny)*Nx
+	if(n>=(uxx)def_N||is_halo(n)) return; // don't execute update_moving_boundaries() on halo
 	const uchar flagsn = flags[n];
 	const uchar flagsn_bo = flagsn&TYPE_BO; // extract boundary flags
-	uint j[def_velocity_set]; // neighbor indices
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	uchar flagsj[def_velocity_set]; // cache neighbor flags for multiple readings
 	for(uint i=1u; i<def_velocity_set; i++) flagsj[i] = flags[j[i]];
@@ -1627,38 +1738,71 @@ string opencl_c_container() { return R( // ########################## begin of O
 
 
 
-)+R(kernel void stream_collide)+"("+R(global fpxx* fi, global float* rho, global float* u, global uchar* flags, const ulong t, const float fx, const float fy, const float fz // ) { // main LBM kernel
+)+R(bool is_boundary_listed(const uchar flagsn) { // lattice points that need boundary branches in stream_collide_cell(), with BOUNDARY_LISTS these are computed by stream_collide_boundaries() from a list
+	const uchar flagsn_bo = flagsn&TYPE_BO;
+	bool listed = false;
+)+"#ifdef EQUILIBRIUM_BOUNDARIES"+R(
+	listed = listed||flagsn_bo==TYPE_E;
+)+"#endif"+R( // EQUILIBRIUM_BOUNDARIES
+)+"#ifdef MOVING_BOUNDARIES"+R(
+	listed = listed||flagsn_bo==TYPE_MS;
+)+"#endif"+R( // MOVING_BOUNDARIES
+)+"#ifdef TEMPERATURE"+R(
+	listed = listed||(flagsn&TYPE_T);
+)+"#endif"+R( // TEMPERATURE
+	return listed&&flagsn_bo!=TYPE_S; // solid lattice points are never computed
+}
+)+R(bool bulk_only() { // stream_collide() computes only bulk lattice points and the boundary branches are compiled out
+)+"#ifdef BOUNDARY_LISTS"+R(
+	return true;
+)+"#else"+R( // BOUNDARY_LISTS
+	return false;
+)+"#endif"+R( // BOUNDARY_LISTS
+}
+
+)+R(void stream_collide_cell)+"("+R(const uint3 xyz, const bool bulk, ddfs(global fpxx*, fi), global float* rho, global float* u, global uchar* flags, const ulong t, const float fx, const float fy, const float fz // ) { // stream and collide lattice point at xyz, bulk is a compile-time constant that removes the boundary branches for lattice points that are known not to be on the boundary list
 )+"#ifdef FORCE_FIELD"+R(
-	, const global float* F // argument order is important
+	, const global float* F
 )+"#endif"+R( // FORCE_FIELD
+)+"#ifdef NEIGHBOR_MASKS"+R(
+	, const global uint* solid_neighbors
+)+"#endif"+R( // NEIGHBOR_MASKS
 )+"#ifdef SURFACE"+R(
-	, const global float* mass // argument order is important
+	, const global float* mass
+)+"#ifdef SURFACE_LIST"+R(
+	, global uxx* surface_list, volatile global uint* surface_count
+)+"#endif"+R( // SURFACE_LIST
 )+"#endif"+R( // SURFACE
 )+"#ifdef TEMPERATURE"+R(
-	, global fpxx* gi, global float* T // argument order is important
+	, ddfs(global fpxx*, gi), global float* T
 )+"#endif"+R( // TEMPERATURE
-)+") {"+R( // stream_collide()
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute stream_collide() on halo
+)+") {"+R( // stream_collide_cell()
+	const uxx n = index(xyz); // n = x+(y+z*Ny)*Nx
+	if(is_halo_outer_xyz(xyz)) return; // don't execute stream_collide() on halo, inner layers of wide halos are computed redundantly to avoid communication
 	const uchar flagsn = flags[n]; // cache flags[n] for multiple readings
 	const uchar flagsn_bo=flagsn&TYPE_BO, flagsn_su=flagsn&TYPE_SU; // extract boundary and surface flags
 	if(flagsn_bo==TYPE_S||flagsn_su==TYPE_G) return; // if node is solid boundary or gas, just return
+	if(bulk&&is_boundary_listed(flagsn)) return; // computed by stream_collide_boundaries()
 
-	uint j[def_velocity_set]; // neighbor indices
-	neighbors(n, j); // calculate neighbor indices
+	uxx j[def_velocity_set]; // neighbor indices
+	neighbors_xyz(xyz, j); // calculate neighbor indices
 
 	float fhn[def_velocity_set]; // local DDFs
-	load_f(n, fhn, fi, j, t); // perform streaming (part 2)
+	load_f(n, fhn, ddfs_pass(fi), j, t); // perform streaming (part 2)
 
 )+"#ifdef MOVING_BOUNDARIES"+R(
-	if(flagsn_bo==TYPE_MS) apply_moving_boundaries(fhn, j, u, flags); // apply Dirichlet velocity boundaries if necessary (reads velocities of only neighboring boundary nodes, which do not change during simulation)
+)+"#ifndef NEIGHBOR_MASKS"+R(
+	if(!bulk&&flagsn_bo==TYPE_MS) apply_moving_boundaries(fhn, j, u, solid_neighbors_mask(j, flags)); // apply Dirichlet velocity boundaries if necessary (reads velocities of only neighboring boundary nodes, which do not change during simulation)
+)+"#else"+R( // NEIGHBOR_MASKS
+	if(!bulk&&flagsn_bo==TYPE_MS) apply_moving_boundaries(fhn, j, u, solid_neighbors[n]); // one word instead of the flags of all neighbors
+)+"#endif"+R( // NEIGHBOR_MASKS
 )+"#endif"+R( // MOVING_BOUNDARIES
 
 	float rhon, uxn, uyn, uzn; // calculate local density and velocity for collision
 )+"#ifndef EQUILIBRIUM_BOUNDARIES"+R(
 	calculate_rho_u(fhn, &rhon, &uxn, &uyn, &uzn); // calculate density and velocity fields from fi
 )+"#else"+R( // EQUILIBRIUM_BOUNDARIES
-	if(flagsn_bo==TYPE_E) {
+	if(!bulk&&flagsn_bo==TYPE_E) {
 		rhon = rho[               n]; // apply preset velocity/density
 		uxn  = u[                 n];
 		uyn  = u[    def_N+(ulong)n];
@@ -1689,17 +1833,20 @@ string opencl_c_container() { return R( // ########################## begin of O
 		const float massn = mass[n]; // load mass
 		     if(massn>rhon || TYPE_NO_G) flags[n] = (flagsn&~TYPE_SU)|TYPE_IF; // set flag interface->fluid
 		else if(massn<0.0f || TYPE_NO_F) flags[n] = (flagsn&~TYPE_SU)|TYPE_IG; // set flag interface->gas
+)+"#ifdef SURFACE_LIST"+R(
+		if(massn>rhon||TYPE_NO_G||massn<0.0f||TYPE_NO_F) append_surface_list(n, surface_list, surface_count, 0u); // surface_1() and surface_2() only visit lattice points with flag changes
+)+"#endif"+R( // SURFACE_LIST
 	}
 )+"#endif"+R( // SURFACE
 
 )+"#ifdef TEMPERATURE"+R(
 	{ // separate block to avoid variable name conflicts
-		uint j7[7]; // neighbors of D3Q7 subset
-		neighbors_temperature(n, j7);
+		uxx j7[7]; // neighbors of D3Q7 subset
+		neighbors_temperature_xyz(xyz, j7);
 		float ghn[7]; // read from gA and stream to gh (D3Q7 subset, periodic boundary conditions)
-		load_g(n, ghn, gi, j7, t); // perform streaming (part 2)
+		load_g(n, ghn, ddfs_pass(gi), j7, t); // perform streaming (part 2)
 		float Tn;
-		if(flagsn&TYPE_T) {
+		if(!bulk&&(flagsn&TYPE_T)) {
 			Tn = T[n]; // apply preset temperature
 		} else {
 			Tn = 0.0f;
@@ -1708,7 +1855,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 		}
 		float geq[7]; // cache f_equilibrium[n]
 		calculate_g_eq(Tn, uxn, uyn, uzn, geq); // calculate equilibrium DDFs
-		if(flagsn&TYPE_T) {
+		if(!bulk&&(flagsn&TYPE_T)) {
 			for(uint i=0u; i<7u; i++) ghn[i] = geq[i]; // just write geq to ghn (no collision)
 		} else {
 )+"#ifdef UPDATE_FIELDS"+R(
@@ -1716,7 +1863,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#endif"+R( // UPDATE_FIELDS
 			for(uint i=0u; i<7u; i++) ghn[i] = fma(1.0f-def_w_T, ghn[i], def_w_T*geq[i]); // perform collision
 		}
-		store_g(n, ghn, gi, j7, t); // perform streaming (part 1)
+		store_g(n, ghn, ddfs_pass(gi), j7, t); // perform streaming (part 1)
 		fxn -= fx*def_beta*(Tn-def_T_avg);
 		fyn -= fy*def_beta*(Tn-def_T_avg);
 		fzn -= fz*def_beta*(Tn-def_T_avg);
@@ -1747,7 +1894,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#endif"+R( // UPDATE_FIELDS
 )+"#else"+R( // EQUILIBRIUM_BOUNDARIES
 )+"#ifdef UPDATE_FIELDS"+R(
-	if(flagsn_bo!=TYPE_E) { // only update fields for non-TYPE_E nodes
+	if(bulk||flagsn_bo!=TYPE_E) { // only update fields for non-TYPE_E nodes
 		rho[               n] = rhon; // update density field
 		u[                 n] = uxn; // update velocity field
 		u[    def_N+(ulong)n] = uyn;
@@ -1784,7 +1931,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#ifndef EQUILIBRIUM_BOUNDARIES"+R(
 	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = fma(1.0f-w, fhn[i], fma(w, feq[i], Fin[i])); // perform collision (SRT)
 )+"#else"+R( // EQUILIBRIUM_BOUNDARIES
-	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = flagsn_bo==TYPE_E ? feq[i] : fma(1.0f-w, fhn[i], fma(w, feq[i], Fin[i])); // perform collision (SRT)
+	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = !bulk&&flagsn_bo==TYPE_E ? feq[i] : fma(1.0f-w, fhn[i], fma(w, feq[i], Fin[i])); // perform collision (SRT)
 )+"#endif"+R( // EQUILIBRIUM_BOUNDARIES
 )+"#elif defined(TRT)"+R(
 	const float wp = w; // TRT: inverse of "+" relaxation time
@@ -1812,28 +1959,338 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#ifndef EQUILIBRIUM_BOUNDARIES"+R(
 	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = fma(0.5f*wp, feq[i]-fhn[i]+feb[i]-fhb[i], fma(0.5f*wm, feq[i]-feb[i]-fhn[i]+fhb[i], fhn[i]+Fin[i])); // perform collision (TRT)
 )+"#else"+R( // EQUILIBRIUM_BOUNDARIES
-	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = flagsn_bo==TYPE_E ? feq[i] : fma(0.5f*wp, feq[i]-fhn[i]+feb[i]-fhb[i], fma(0.5f*wm, feq[i]-feb[i]-fhn[i]+fhb[i], fhn[i]+Fin[i])); // perform collision (TRT)
+	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = !bulk&&flagsn_bo==TYPE_E ? feq[i] : fma(0.5f*wp, feq[i]-fhn[i]+feb[i]-fhb[i], fma(0.5f*wm, feq[i]-feb[i]-fhn[i]+fhb[i], fhn[i]+Fin[i])); // perform collision (TRT)
 )+"#endif"+R( // EQUILIBRIUM_BOUNDARIES
 )+"#endif"+R( // TRT
 
-	store_f(n, fhn, fi, j, t); // perform streaming (part 1)
+	store_f(n, fhn, ddfs_pass(fi), j, t); // perform streaming (part 1)
+} // stream_collide_cell()
+
+)+R(kernel void stream_collide)+"("+R(global fpxx* fi, global float* rho, global float* u, global uchar* flags, const ulong t, const float fx, const float fy, const float fz // ) { // main LBM kernel
+)+"#ifdef FORCE_FIELD"+R(
+	, const global float* F // argument order is important
+)+"#endif"+R( // FORCE_FIELD
+)+"#ifdef NEIGHBOR_MASKS"+R(
+	, const global uint* solid_neighbors // argument order is important
+)+"#endif"+R( // NEIGHBOR_MASKS
+)+"#ifdef SURFACE"+R(
+	, const global float* mass // argument order is important
+)+"#ifdef SURFACE_LIST"+R(
+	, global uxx* surface_list, volatile global uint* surface_count // argument order is important
+)+"#endif"+R( // SURFACE_LIST
+)+"#endif"+R( // SURFACE
+)+"#ifdef TEMPERATURE"+R(
+	, global fpxx* gi, global float* T // argument order is important
+	ddfs_tail(global fpxx*, gi)
+)+"#endif"+R( // TEMPERATURE
+	ddfs_tail(global fpxx*, fi) // further DDF buffers if the DDFs are split, always the last arguments
+)+") {"+R( // stream_collide()
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)) return;
+	stream_collide_cell)+"("+R(xyz, bulk_only(), ddfs_pass(fi), rho, u, flags, t, fx, fy, fz
+)+"#ifdef FORCE_FIELD"+R(
+		, F
+)+"#endif"+R( // FORCE_FIELD
+)+"#ifdef NEIGHBOR_MASKS"+R(
+		, solid_neighbors
+)+"#endif"+R( // NEIGHBOR_MASKS
+)+"#ifdef SURFACE"+R(
+		, mass
+)+"#ifdef SURFACE_LIST"+R(
+		, surface_list, surface_count
+)+"#endif"+R( // SURFACE_LIST
+)+"#endif"+R( // SURFACE
+)+"#ifdef TEMPERATURE"+R(
+		, ddfs_pass(gi), T
+)+"#endif"+R( // TEMPERATURE
+)+");"+R(
 } // stream_collide()
 
+)+"#ifdef BOUNDARY_LISTS"+R(
+)+R(kernel void list_boundary_cells(const global uchar* flags, global uxx* list, volatile global uint* count, const uint capacity) { // collect lattice points for stream_collide_boundaries(), count has to be reset to 0 before, the list is incomplete if count exceeds capacity
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)||is_halo_outer_xyz(xyz)) return;
+	const uxx n = index(xyz);
+	if(!is_boundary_listed(flags[n])) return;
+	const uint i = atomic_inc(count);
+	if(i<capacity) list[i] = n;
+} // list_boundary_cells()
+)+R(kernel void stream_collide_boundaries)+"("+R(const global uxx* list, global fpxx* fi, global float* rho, global float* u, global uchar* flags, const ulong t, const float fx, const float fy, const float fz // ) { // stream_collide() for the lattice points on the boundary list, 1D range with one work-item per list entry
+)+"#ifdef FORCE_FIELD"+R(
+	, const global float* F // argument order is important
+)+"#endif"+R( // FORCE_FIELD
+)+"#ifdef NEIGHBOR_MASKS"+R(
+	, const global uint* solid_neighbors // argument order is important
+)+"#endif"+R( // NEIGHBOR_MASKS
+)+"#ifdef SURFACE"+R(
+	, const global float* mass // argument order is important
+)+"#ifdef SURFACE_LIST"+R(
+	, global uxx* surface_list, volatile global uint* surface_count // argument order is important
+)+"#endif"+R( // SURFACE_LIST
+)+"#endif"+R( // SURFACE
+)+"#ifdef TEMPERATURE"+R(
+	, global fpxx* gi, global float* T // argument order is important
+	ddfs_tail(global fpxx*, gi)
+)+"#endif"+R( // TEMPERATURE
+	ddfs_tail(global fpxx*, fi) // further DDF buffers if the DDFs are split, always the last arguments
+)+") {"+R( // stream_collide_boundaries()
+	const uxx n = list[get_global_id(0)];
+	if(!is_boundary_listed(flags[n])) return; // the boundary flag was removed after the list was built, stream_collide() has already computed this lattice point
+	stream_collide_cell)+"("+R(coordinates(n), false, ddfs_pass(fi), rho, u, flags, t, fx, fy, fz
+)+"#ifdef FORCE_FIELD"+R(
+		, F
+)+"#endif"+R( // FORCE_FIELD
+)+"#ifdef NEIGHBOR_MASKS"+R(
+		, solid_neighbors
+)+"#endif"+R( // NEIGHBOR_MASKS
+)+"#ifdef SURFACE"+R(
+		, mass
+)+"#ifdef SURFACE_LIST"+R(
+		, surface_list, surface_count
+)+"#endif"+R( // SURFACE_LIST
+)+"#endif"+R( // SURFACE
+)+"#ifdef TEMPERATURE"+R(
+		, ddfs_pass(gi), T
+)+"#endif"+R( // TEMPERATURE
+)+");"+R(
+} // stream_collide_boundaries()
+)+"#endif"+R( // BOUNDARY_LISTS
+
+)+"#ifdef def_V"+R( // explicitly vectorized stream_collide() for CPU devices, one work-item computes def_V consecutive lattice points along x with floatV vector types
+)+R(floatV load_custom_V(const global ushort* p) { // FP16C has no vector conversion, decompress lane by lane
+	float x[def_V];
+	for(uint k=0u; k<def_V; k++) x[k] = half_to_float_custom(p[k]);
+	return vloadV(0, x);
+}
+)+R(void store_custom_V(global ushort* p, const floatV x) { // FP16C has no vector conversion, compress lane by lane
+	float y[def_V];
+	vstoreV(x, 0, y);
+	for(uint k=0u; k<def_V; k++) p[k] = float_to_half_custom(y[k]);
+}
+)+R(void store_f_V(global fpxx* fi, const ulong o, const floatV x, const intV keep) { // vector store of DDFs, lanes set in keep retain the value in memory
+	storeV(fi, o, any(keep) ? select(x, loadV(fi, o), keep) : x);
+}
+)+R(void store_field_V(global float* p, const ulong o, const floatV x, const intV keep) { // vector store of a field, lanes set in keep retain the value in memory
+	vstoreV(any(keep) ? select(x, vloadV(0, p+o), keep) : x, 0, p+o);
+}
+)+R(floatV momentum_V(const floatV* f, const uint d) { // component d of momentum, same order of summation as in calculate_rho_u()
+	floatV m = (floatV)0.0f;
+	for(uint i=1u; i<def_velocity_set; i+=2u) { // loop is entirely unrolled by compiler, directions with c=0 vanish
+		const float ci = c(d*def_velocity_set+i);
+		if(ci>0.0f) m = m+f[i]-f[i+1u];
+		if(ci<0.0f) m = m+f[i+1u]-f[i];
+	}
+	return m;
+}
+)+R(void calculate_rho_u_V(const floatV* f, floatV* rhon, floatV* uxn, floatV* uyn, floatV* uzn) { // vector version of calculate_rho_u()
+	floatV rho = f[0];
+	for(uint i=1u; i<def_velocity_set; i++) rho += f[i]; // calculate density from fi
+	rho += 1.0f; // add 1.0f last to avoid digit extinction effects when summing up fi (perturbation method / DDF-shifting)
+	*rhon = rho;
+	*uxn = momentum_V(f, 0u)/rho;
+	*uyn = momentum_V(f, 1u)/rho;
+	*uzn = momentum_V(f, 2u)/rho;
+}
+)+R(void calculate_f_eq_V(const floatV rho, floatV ux, floatV uy, floatV uz, floatV* feq) { // vector version of calculate_f_eq()
+	const floatV c3=-3.0f*(ux*ux+uy*uy+uz*uz), rhom1=rho-1.0f; // c3 = -2*sq(u)/(2*sq(c)), rhom1 is arithmetic optimization to minimize digit extinction
+	ux *= 3.0f;
+	uy *= 3.0f;
+	uz *= 3.0f;
+	feq[0] = def_w0*fma(rho, 0.5f*c3, rhom1); // 000 (identical for all velocity sets)
+	for(uint i=1u; i<def_velocity_set; i+=2u) { // loop is entirely unrolled by compiler, directions with c=0 vanish
+		const floatV ui = c(i)*ux+c(def_velocity_set+i)*uy+c(2u*def_velocity_set+i)*uz; // velocity projected onto direction i
+		const floatV rhow=w(i)*rho, rhom1w=w(i)*rhom1;
+		feq[i   ] = fma(rhow, fma((floatV)0.5f, fma(ui, ui, c3),  ui), rhom1w);
+		feq[i+1u] = fma(rhow, fma((floatV)0.5f, fma(ui, ui, c3), -ui), rhom1w);
+	}
+}
+)+"#ifdef VOLUME_FORCE"+R(
+)+R(void calculate_forcing_terms_V(const floatV ux, const floatV uy, const floatV uz, const floatV fx, const floatV fy, const floatV fz, floatV* Fin) { // vector version of calculate_forcing_terms()
+)+"#ifdef D2Q9"+R(
+	const floatV uF = -0.33333334f*fma(ux, fx, uy*fy); // 2D
+)+"#else"+R( // D2Q9
+	const floatV uF = -0.33333334f*fma(ux, fx, fma(uy, fy, uz*fz)); // 3D
+)+"#endif"+R( // D2Q9
+	Fin[0] = 9.0f*def_w0*uF ; // 000 (identical for all velocity sets)
+	for(uint i=1u; i<def_velocity_set; i++) { // loop is entirely unrolled by compiler, no unnecessary FLOPs are happening
+		Fin[i] = 9.0f*w(i)*fma(c(i)*fx+c(def_velocity_set+i)*fy+c(2u*def_velocity_set+i)*fz, c(i)*ux+c(def_velocity_set+i)*uy+c(2u*def_velocity_set+i)*uz+0.33333334f, uF);
+	}
+}
+)+"#endif"+R( // VOLUME_FORCE
+
+)+R(kernel void stream_collide_vectorized)+"("+R(global fpxx* fi, global float* rho, global float* u, global uchar* flags, const ulong t, const float fx, const float fy, const float fz // ) { // main LBM kernel for CPU devices, same arguments as stream_collide()
+)+"#ifdef FORCE_FIELD"+R(
+	, const global float* F // argument order is important
+)+"#endif"+R( // FORCE_FIELD
+)+"#ifdef NEIGHBOR_MASKS"+R(
+	, const global uint* solid_neighbors // argument order is important
+)+"#endif"+R( // NEIGHBOR_MASKS
+	ddfs_tail(global fpxx*, fi) // further DDF buffers if the DDFs are split, always the last arguments
+)+") {"+R( // stream_collide_vectorized()
+	const uint3 xyz0 = global_xyz()*(uint3)(def_V, 1u, 1u); // 3D range over row segments, segment x/def_V of a row covers x...x+def_V-1
+	if(is_outside(xyz0)) return;
+	const uint x0 = xyz0.x; // first lattice point of the segment
+	const uxx n0 = index(xyz0);
+	bool vectorize = x0>0u&&x0+def_V<def_Nx; // no lane is at the row ends, so x-neighbors do not wrap around and neighbors of lane k are the neighbors of lane 0 plus k
+	const ucharV flagsn_bo = vectorize ? vloadV(0, flags+n0)&(uchar)TYPE_BO : (ucharV)0; // extract boundary flags of all lanes
+)+"#ifdef MOVING_BOUNDARIES"+R(
+	vectorize = vectorize&&!any(flagsn_bo==(uchar)TYPE_MS); // lattice points next to moving solids read velocities of their boundary neighbors individually
+)+"#endif"+R( // MOVING_BOUNDARIES
+	if(!vectorize) { // row ends, partial segments and segments next to moving solids are computed lane by lane
+		for(uint k=0u; k<def_V&&x0+k<def_Nx; k++) stream_collide_cell)+"("+R(xyz0+(uint3)(k, 0u, 0u), false, ddfs_pass(fi), rho, u, flags, t, fx, fy, fz
+)+"#ifdef FORCE_FIELD"+R(
+			, F
+)+"#endif"+R( // FORCE_FIELD
+)+"#ifdef NEIGHBOR_MASKS"+R(
+			, solid_neighbors
+)+"#endif"+R( // NEIGHBOR_MASKS
+		)+");"+R(
+		return;
+	}
+	if(is_halo_outer_xyz(xyz0)) return; // all lanes are in the same y/z halo layer
+	const intV solid = convert_intV(flagsn_bo==(uchar)TYPE_S); // masked lanes: solid boundaries are not streamed and collided
+	if(all(solid)) return;
+
+	uxx j[def_velocity_set]; // neighbor indices of lane 0
+	neighbors_xyz(xyz0, j); // calculate neighbor indices
+
+	floatV fhn[def_velocity_set]; // local DDFs
+	fhn[0] = loadV(ddf(fi, 0u), index_f(n0, 0u)); // perform streaming (part 2), Esoteric-Pull
+	for(uint i=1u; i<def_velocity_set; i+=2u) {
+		fhn[i   ] = loadV(ddf(fi, t%2ul ? i    : i+1u), index_f(n0  , t%2ul ? i    : i+1u));
+		fhn[i+1u] = loadV(ddf(fi, t%2ul ? i+1u : i   ), index_f(j[i], t%2ul ? i+1u : i   ));
+	}
+
+	floatV rhon, uxn, uyn, uzn; // calculate local density and velocity for collision
+	calculate_rho_u_V(fhn, &rhon, &uxn, &uyn, &uzn); // calculate density and velocity fields from fi
+	intV keep = solid; // lanes that do not update rho and u
+)+"#ifdef EQUILIBRIUM_BOUNDARIES"+R(
+	const intV equilibrium = convert_intV(flagsn_bo==(uchar)TYPE_E);
+	if(any(equilibrium)) {
+		rhon = select(rhon, vloadV(0, rho+n0), equilibrium); // apply preset velocity/density
+		uxn = select(uxn, vloadV(0, u+n0), equilibrium);
+		uyn = select(uyn, vloadV(0, u+def_N+(ulong)n0), equilibrium);
+		uzn = select(uzn, vloadV(0, u+2ul*def_N+(ulong)n0), equilibrium);
+		keep |= equilibrium;
+	}
+)+"#endif"+R( // EQUILIBRIUM_BOUNDARIES
+	floatV fxn=(floatV)fx, fyn=(floatV)fy, fzn=(floatV)fz; // force starts as constant volume force
+	floatV Fin[def_velocity_set]; // forcing terms
+)+"#ifdef FORCE_FIELD"+R(
+	fxn += vloadV(0, F+n0); // apply force field
+	fyn += vloadV(0, F+def_N+(ulong)n0);
+	fzn += vloadV(0, F+2ul*def_N+(ulong)n0);
+)+"#endif"+R( // FORCE_FIELD
+
+)+"#ifdef VOLUME_FORCE"+R( // apply force and collision operator
+	{ // separate block to avoid variable name conflicts
+		const floatV rho2 = 0.5f/rhon; // apply external volume force (Guo forcing, Krueger p.233f)
+		uxn = clamp(fma(fxn, rho2, uxn), -def_c, def_c); // limit velocity (for stability purposes)
+		uyn = clamp(fma(fyn, rho2, uyn), -def_c, def_c); // force term: F*dt/(2*rho)
+		uzn = clamp(fma(fzn, rho2, uzn), -def_c, def_c);
+		calculate_forcing_terms_V(uxn, uyn, uzn, fxn, fyn, fzn, Fin); // calculate volume force terms Fin from velocity field (Guo forcing, Krueger p.233f)
+	}
+)+"#else"+R( // VOLUME_FORCE
+	uxn = clamp(uxn, -def_c, def_c); // limit velocity (for stability purposes)
+	uyn = clamp(uyn, -def_c, def_c);
+	uzn = clamp(uzn, -def_c, def_c);
+	for(uint i=0u; i<def_velocity_set; i++) Fin[i] = (floatV)0.0f;
+)+"#endif"+R( // VOLUME_FORCE
+
+)+"#ifdef UPDATE_FIELDS"+R(
+	store_field_V(rho, n0, rhon, keep); // update density field
+	store_field_V(u, n0, uxn, keep); // update velocity field
+	store_field_V(u, def_N+(ulong)n0, uyn, keep);
+	store_field_V(u, 2ul*def_N+(ulong)n0, uzn, keep);
+)+"#endif"+R( // UPDATE_FIELDS
+
+	floatV feq[def_velocity_set]; // equilibrium DDFs
+	calculate_f_eq_V(rhon, uxn, uyn, uzn, feq); // calculate equilibrium DDFs
+	floatV w = (floatV)def_w; // LBM relaxation rate w = dt/tau = dt/(nu/c^2+dt/2) = 1/(3*nu+1/2)
+
+)+"#ifdef SUBGRID"+R(
+	{ // Smagorinsky-Lilly subgrid turbulence model, see stream_collide_cell()
+		const floatV tau0 = 1.0f/w;
+		floatV Hxx=(floatV)0.0f, Hyy=(floatV)0.0f, Hzz=(floatV)0.0f, Hxy=(floatV)0.0f, Hxz=(floatV)0.0f, Hyz=(floatV)0.0f; // non-equilibrium stress tensor
+		for(uint i=1u; i<def_velocity_set; i++) {
+			const floatV fneqi = fhn[i]-feq[i];
+			const float cxi=c(i), cyi=c(def_velocity_set+i), czi=c(2u*def_velocity_set+i);
+			Hxx += cxi*cxi*fneqi;
+			Hxy += cxi*cyi*fneqi; Hyy += cyi*cyi*fneqi;
+			Hxz += cxi*czi*fneqi; Hyz += cyi*czi*fneqi; Hzz += czi*czi*fneqi;
+		}
+		const floatV Q = Hxx*Hxx+Hyy*Hyy+Hzz*Hzz+2.0f*(Hxy*Hxy+Hxz*Hxz+Hyz*Hyz);
+		w = 2.0f/(tau0+sqrt(tau0*tau0+0.76421222f*sqrt(Q)/rhon));
+	}
+)+"#endif"+R( // SUBGRID
+
+)+"#if defined(SRT)"+R(
+)+"#ifdef VOLUME_FORCE"+R(
+	const floatV c_tau = fma(w, (floatV)-0.5f, (floatV)1.0f);
+	for(uint i=0u; i<def_velocity_set; i++) Fin[i] *= c_tau;
+)+"#endif"+R( // VOLUME_FORCE
+	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = fma(1.0f-w, fhn[i], fma(w, feq[i], Fin[i])); // perform collision (SRT)
+)+"#elif defined(TRT)"+R(
+	const floatV wp = w; // TRT: inverse of "+" relaxation time
+	const floatV wm = 1.0f/(0.1875f/(1.0f/w-0.5f)+0.5f); // TRT: inverse of "-" relaxation time
+)+"#ifdef VOLUME_FORCE"+R(
+	const floatV c_taup=fma(wp, (floatV)-0.25f, (floatV)0.5f), c_taum=fma(wm, (floatV)-0.25f, (floatV)0.5f);
+	floatV Fib[def_velocity_set]; // F_bar
+	Fib[0] = Fin[0];
+	for(uint i=1u; i<def_velocity_set; i+=2u) {
+		Fib[i   ] = Fin[i+1u];
+		Fib[i+1u] = Fin[i   ];
+	}
+	for(uint i=0u; i<def_velocity_set; i++) Fin[i] = fma(c_taup, Fin[i]+Fib[i], c_taum*(Fin[i]-Fib[i]));
+)+"#endif"+R( // VOLUME_FORCE
+	floatV fhb[def_velocity_set]; // fhn in inverse directions
+	floatV feb[def_velocity_set]; // feq in inverse directions
+	fhb[0] = fhn[0];
+	feb[0] = feq[0];
+	for(uint i=1u; i<def_velocity_set; i+=2u) {
+		fhb[i   ] = fhn[i+1u];
+		fhb[i+1u] = fhn[i   ];
+		feb[i   ] = feq[i+1u];
+		feb[i+1u] = feq[i   ];
+	}
+	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = fma(0.5f*wp, feq[i]-fhn[i]+feb[i]-fhb[i], fma(0.5f*wm, feq[i]-feb[i]-fhn[i]+fhb[i], fhn[i]+Fin[i])); // perform collision (TRT)
+)+"#endif"+R( // TRT
+)+"#ifdef EQUILIBRIUM_BOUNDARIES"+R(
+	for(uint i=0u; i<def_velocity_set; i++) fhn[i] = select(fhn[i], feq[i], equilibrium); // equilibrium boundaries are set to feq without collision
+)+"#endif"+R( // EQUILIBRIUM_BOUNDARIES
+
+	store_f_V(ddf(fi, 0u), index_f(n0, 0u), fhn[0], solid); // perform streaming (part 1), Esoteric-Pull
+	for(uint i=1u; i<def_velocity_set; i+=2u) {
+		store_f_V(ddf(fi, t%2ul ? i+1u : i   ), index_f(j[i], t%2ul ? i+1u : i   ), fhn[i   ], solid);
+		store_f_V(ddf(fi, t%2ul ? i    : i+1u), index_f(n0  , t%2ul ? i    : i+1u), fhn[i+1u], solid);
+	}
+} // stream_collide_vectorized()
+)+"#endif"+R( // def_V
+
 )+"#ifdef SURFACE"+R(
-)+R(kernel void surface_0(global fpxx* fi, const global float* rho, const global float* u, const global uchar* flags, global float* mass, const global float* massex, const global float* phi, const ulong t, const float fx, const float fy, const float fz) { // capture outgoing DDFs before streaming
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute surface_0() on halo
+)+R(kernel void surface_0(global fpxx* fi, const global float* rho, const global float* u, const global uchar* flags, global float* mass, const global float* massex, const global float* phi, const ulong t, const float fx, const float fy, const float fz ddfs_tail(global fpxx*, fi)) { // capture outgoing DDFs before streaming
+)+"#ifndef SURFACE_LOCAL"+R(
+	const uxx n = get_global_id(0); // n = x+(y+z*Ny)*Nx
+	if(n>=(uxx)def_N||is_halo(n)) return; // don't execute surface_0() on halo
+)+"#else"+R( // SURFACE_LOCAL
+	local float phi_tile[def_tile_N]; // fill level of the workgroup tile and its neighbors, neighboring work-items share most of their neighborhood
+	local uchar flags_tile[def_tile_N];
+	load_surface_tile(phi, flags, phi_tile, flags_tile); // before any work-item returns
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)||is_halo_xyz(xyz)) return; // don't execute surface_0() on halo
+	const uxx n = index(xyz); // n = x+(y+z*Ny)*Nx
+)+"#endif"+R( // SURFACE_LOCAL
 	const uchar flagsn = flags[n]; // cache flags[n] for multiple readings
 	const uchar flagsn_bo=flagsn&TYPE_BO, flagsn_su=flagsn&TYPE_SU; // extract boundary and surface flags
 	if(flagsn_bo==TYPE_S||flagsn_su==TYPE_G) return; // node processed here is fluid or interface
 
-	uint j[def_velocity_set]; // neighbor indices
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	float fhn[def_velocity_set]; // incoming DDFs
-	load_f(n, fhn, fi, j, t); // load incoming DDFs
+	load_f(n, fhn, ddfs_pass(fi), j, t); // load incoming DDFs
 	float fon[def_velocity_set]; // outgoing DDFs
 	fon[0] = fhn[0]; // fon[0] is already loaded in fhn[0]
-	load_f_outgoing(n, fon, fi, j, t); // load outgoing DDFs
+	load_f_outgoing(n, fon, ddfs_pass(fi), j, t); // load outgoing DDFs
 
 	float massn = mass[n];
 	for(uint i=1u; i<def_velocity_set; i++) {
@@ -1843,7 +2300,11 @@ string opencl_c_container() { return R( // ########################## begin of O
 		for(uint i=1u; i<def_velocity_set; i++) massn += fhn[i]-fon[i]; // neighbor is fluid or interface node
 	} else if(flagsn_su==TYPE_I) { // node is interface
 		float phij[def_velocity_set]; // cache fill level of neighbor lattice points
+)+"#ifndef SURFACE_LOCAL"+R(
 		for(uint i=1u; i<def_velocity_set; i++) phij[i] = phi[j[i]]; // cache fill level of neighbor lattice points
+)+"#else"+R( // SURFACE_LOCAL
+		for(uint i=1u; i<def_velocity_set; i++) phij[i] = phi_tile[tile_neighbor(c(i), c(def_velocity_set+i), c(2u*def_velocity_set+i))]; // cache fill level of neighbor lattice points
+)+"#endif"+R( // SURFACE_LOCAL
 		float rhon, uxn, uyn, uzn, rho_laplace=0.0f; // no surface tension if rho_laplace is not overwritten later
 )+"#ifndef EQUILIBRIUM_BOUNDARIES"+R(
 		calculate_rho_u(fon, &rhon, &uxn, &uyn, &uzn); // calculate density and velocity fields from fon (not fhn)
@@ -1861,7 +2322,16 @@ string opencl_c_container() { return R( // ########################## begin of O
 		uyn = clamp(uyn, -def_c, def_c);
 		uzn = clamp(uzn, -def_c, def_c);
 		phij[0] = calculate_phi(rhon, massn, flagsn); // don't load phi[n] from memory, instead recalculate it with mass corrected by excess mass
+)+"#if defined(SURFACE_LOCAL)&&!defined(D2Q9)"+R(
+		if(def_6_sigma!=0.0f) { // complete D3Q27 neighborhood from local memory
+			float phi27[27];
+			phi27[0] = phij[0];
+			for(uint i=1u; i<27u; i++) phi27[i] = phi_tile[tile_neighbor(c_D3Q27(i), c_D3Q27(27u+i), c_D3Q27(2u*27u+i))];
+			rho_laplace = def_6_sigma*calculate_curvature_phij(phi27); // surface tension least squares fit (PLIC, most accurate)
+		}
+)+"#else"+R( // SURFACE_LOCAL&&!D2Q9
 		rho_laplace = def_6_sigma==0.0f ? 0.0f : def_6_sigma*calculate_curvature(n, phij, phi); // surface tension least squares fit (PLIC, most accurate)
+)+"#endif"+R( // SURFACE_LOCAL&&!D2Q9
 		float feg[def_velocity_set]; // reconstruct f from neighbor gas lattice points
 		const float rho2tmp = 0.5f/rhon; // apply external volume force (Guo forcing, Krueger p.233f)
 		const float uxntmp = clamp(fma(fx, rho2tmp, uxn), -def_c, def_c); // limit velocity (for stability purposes)
@@ -1869,7 +2339,11 @@ string opencl_c_container() { return R( // ########################## begin of O
 		const float uzntmp = clamp(fma(fz, rho2tmp, uzn), -def_c, def_c);
 		calculate_f_eq(1.0f-rho_laplace, uxntmp, uyntmp, uzntmp, feg); // calculate gas equilibrium DDFs with constant ambient pressure
 		uchar flagsj_su[def_velocity_set]; // cache neighbor flags for multiple readings
+)+"#ifndef SURFACE_LOCAL"+R(
 		for(uint i=1u; i<def_velocity_set; i++) flagsj_su[i] = flags[j[i]]&TYPE_SU;
+)+"#else"+R( // SURFACE_LOCAL
+		for(uint i=1u; i<def_velocity_set; i++) flagsj_su[i] = flags_tile[tile_neighbor(c(i), c(def_velocity_set+i), c(2u*def_velocity_set+i))]&TYPE_SU;
+)+"#endif"+R( // SURFACE_LOCAL
 		for(uint i=1u; i<def_velocity_set; i+=2u) { // calculate mass exchange between current node and fluid/interface nodes
 			massn += flagsj_su[i   ]&(TYPE_F|TYPE_I) ? flagsj_su[i   ]==TYPE_F ? fhn[i+1]-fon[i   ] : 0.5f*(phij[i   ]+phij[0])*(fhn[i+1 ]-fon[i   ]) : 0.0f; // neighbor is fluid or interface node
 			massn += flagsj_su[i+1u]&(TYPE_F|TYPE_I) ? flagsj_su[i+1u]==TYPE_F ? fhn[i  ]-fon[i+1u] : 0.5f*(phij[i+1u]+phij[0])*(fhn[i   ]-fon[i+1u]) : 0.0f; // fluid : interface : gas
@@ -1878,40 +2352,45 @@ string opencl_c_container() { return R( // ########################## begin of O
 			fhn[i   ] = feg[i+1u]-fon[i+1u]+feg[i   ];
 			fhn[i+1u] = feg[i   ]-fon[i   ]+feg[i+1u];
 		}
-		store_f_reconstructed(n, fhn, fi, j, t, flagsj_su); // store reconstructed gas DDFs that are streamed in during the following stream_collide()
+		store_f_reconstructed(n, fhn, ddfs_pass(fi), j, t, flagsj_su); // store reconstructed gas DDFs that are streamed in during the following stream_collide()
 	}
 	mass[n] = massn;
 }
-)+R(kernel void surface_1(global uchar* flags) { // prevent neighbors from interface->fluid nodes to become/be gas nodes
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N) return; // execute surface_1() also on halo
+)+R(void surface_1_cell)+"("+R(const uxx n, global uchar* flags // ) { // prevent neighbors from interface->fluid nodes to become/be gas nodes
+)+"#ifdef SURFACE_LIST"+R(
+	, global uxx* surface_list, volatile global uint* surface_count, const uint count
+)+"#endif"+R( // SURFACE_LIST
+)+") {"+R( // surface_1_cell()
 	const uchar flagsn_sus = flags[n]&(TYPE_SU|TYPE_S); // extract SURFACE flags
 	if(flagsn_sus==TYPE_IF) { // flag interface->fluid is set
-		uint j[def_velocity_set]; // neighbor indices
+		uxx j[def_velocity_set]; // neighbor indices
 		neighbors(n, j); // calculate neighbor indices
 		for(uint i=1u; i<def_velocity_set; i++) {
 			const uchar flagsji = flags[j[i]];
 			const uchar flagsji_su = flagsji&(TYPE_SU|TYPE_S); // extract SURFACE flags
 			const uchar flagsji_r = flagsji&~TYPE_SU; // extract all non-SURFACE flags
 			if(flagsji_su==TYPE_IG) flags[j[i]] = flagsji_r|TYPE_I; // prevent interface neighbor nodes from becoming gas
-			else if(flagsji_su==TYPE_G) flags[j[i]] = flagsji_r|TYPE_GI; // neighbor node was gas and must change to interface
+			else if(flagsji_su==TYPE_G) {
+				flags[j[i]] = flagsji_r|TYPE_GI; // neighbor node was gas and must change to interface
+)+"#ifdef SURFACE_LIST"+R(
+				append_surface_list(j[i], surface_list, surface_count+1, count); // surface_2() initializes the DDFs of the new interface node, surface_1() counts its own entries behind those of stream_collide()
+)+"#endif"+R( // SURFACE_LIST
+			}
 		}
 	}
-} // possible types at the end of surface_1(): TYPE_F / TYPE_I / TYPE_G / TYPE_IF / TYPE_IG / TYPE_GI
-)+R(kernel void surface_2(global fpxx* fi, const global float* rho, const global float* u, global uchar* flags, const ulong t) {  // apply flag changes and calculate excess mass
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N) return; // execute surface_2() also on halo
+} // surface_1_cell()
+)+R(void surface_2_cell(const uxx n, ddfs(global fpxx*, fi), const global float* rho, const global float* u, global uchar* flags, const ulong t) { // apply flag changes and calculate excess mass
 	const uchar flagsn_sus = flags[n]&(TYPE_SU|TYPE_S); // extract SURFACE flags
 	if(flagsn_sus==TYPE_GI) { // initialize the fi of gas nodes that should become interface
 		float rhon, uxn, uyn, uzn; // average over all fluid/interface neighbors
 		average_neighbors_non_gas(n, rho, u, flags, &rhon, &uxn, &uyn, &uzn); // get average rho/u from all fluid/interface neighbors
 		float feq[def_velocity_set];
 		calculate_f_eq(rhon, uxn, uyn, uzn, feq); // calculate equilibrium DDFs
-		uint j[def_velocity_set];
+		uxx j[def_velocity_set];
 		neighbors(n, j);
-		store_f(n, feq, fi, j, t); // write feq to fi in video memory
+		store_f(n, feq, ddfs_pass(fi), j, t); // write feq to fi in video memory
 	} else if(flagsn_sus==TYPE_IG) { // flag interface->gas is set
-		uint j[def_velocity_set]; // neighbor indices
+		uxx j[def_velocity_set]; // neighbor indices
 		neighbors(n, j); // calculate neighbor indices
 		for(uint i=1u; i<def_velocity_set; i++) {
 			const uchar flagsji = flags[j[i]];
@@ -1922,10 +2401,59 @@ string opencl_c_container() { return R( // ########################## begin of O
 			}
 		}
 	}
+} // surface_2_cell()
+)+R(kernel void surface_1)+"("+R(global uchar* flags // ) {
+)+"#ifdef SURFACE_LIST"+R(
+	, global uxx* surface_list, volatile global uint* surface_count // argument order is important
+)+"#endif"+R( // SURFACE_LIST
+)+") {"+R( // surface_1()
+)+"#ifndef SURFACE_LIST"+R(
+	const uxx n = get_global_id(0); // n = x+(y+z*Ny)*Nx
+	if(n>=(uxx)def_N) return; // execute surface_1() also on halo
+	surface_1_cell(n, flags);
+)+"#else"+R( // SURFACE_LIST
+	if(get_global_id(0)>=(uxx)def_surface_list) return; // the range is padded to a multiple of the workgroup size, padding work-items would scan lattice points twice
+	const uint count = surface_count[0]; // lattice points with flag changes in stream_collide(), surface_1() appends to surface_count[1], so count is the same for all work-items
+	if(count<=def_surface_list) {
+		if(get_global_id(0)<count) surface_1_cell(surface_list[get_global_id(0)], flags, surface_list, surface_count, count);
+	} else { // list has overflown, scan the whole lattice
+		for(uxx n=get_global_id(0); n<(uxx)def_N; n+=def_surface_list) surface_1_cell(n, flags, surface_list, surface_count, count);
+	}
+)+"#endif"+R( // SURFACE_LIST
+} // possible types at the end of surface_1(): TYPE_F / TYPE_I / TYPE_G / TYPE_IF / TYPE_IG / TYPE_GI
+)+R(kernel void surface_2)+"("+R(global fpxx* fi, const global float* rho, const global float* u, global uchar* flags, const ulong t // ) { // apply flag changes and calculate excess mass
+)+"#ifdef SURFACE_LIST"+R(
+	, const global uxx* surface_list, const global uint* surface_count // argument order is important
+)+"#endif"+R( // SURFACE_LIST
+	ddfs_tail(global fpxx*, fi) // further DDF buffers if the DDFs are split, always the last arguments
+)+") {"+R( // surface_2()
+)+"#ifndef SURFACE_LIST"+R(
+	const uxx n = get_global_id(0); // n = x+(y+z*Ny)*Nx
+	if(n>=(uxx)def_N) return; // execute surface_2() also on halo
+	surface_2_cell(n, ddfs_pass(fi), rho, u, flags, t);
+)+"#else"+R( // SURFACE_LIST
+	if(get_global_id(0)>=(uxx)def_surface_list) return; // the range is padded to a multiple of the workgroup size, padding work-items would scan lattice points twice
+	const uint count = surface_count[0]+surface_count[1]; // lattice points with flag changes in stream_collide() and surface_1()
+	if(count<=def_surface_list) {
+		if(get_global_id(0)<count) surface_2_cell(surface_list[get_global_id(0)], ddfs_pass(fi), rho, u, flags, t);
+	} else { // list has overflown, scan the whole lattice
+		for(uxx n=get_global_id(0); n<(uxx)def_N; n+=def_surface_list) surface_2_cell(n, ddfs_pass(fi), rho, u, flags, t);
+	}
+)+"#endif"+R( // SURFACE_LIST
 } // possible types at the end of surface_2(): TYPE_F / TYPE_I / TYPE_G / TYPE_IF / TYPE_IG / TYPE_GI
-)+R(kernel void surface_3(const global float* rho, global uchar* flags, global float* mass, global float* massex, global float* phi) { // apply flag changes and calculate excess mass
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute surface_3() on halo
+)+R(kernel void surface_3)+"("+R(const global float* rho, global uchar* flags, global float* mass, global float* massex, global float* phi // ) { // apply flag changes and calculate excess mass
+)+"#ifdef SURFACE_LIST"+R(
+	, global uint* surface_count // argument order is important
+)+"#endif"+R( // SURFACE_LIST
+)+") {"+R( // surface_3()
+	const uxx n = get_global_id(0); // n = x+(y+z*Ny)*Nx
+)+"#ifdef SURFACE_LIST"+R(
+	if(n==0u) { // all flag changes are applied here, the list is refilled by the next stream_collide()
+		surface_count[0] = 0u;
+		surface_count[1] = 0u;
+	}
+)+"#endif"+R( // SURFACE_LIST
+	if(n>=(uxx)def_N||is_halo(n)) return; // don't execute surface_3() on halo
 	const uchar flagsn_sus = flags[n]&(TYPE_SU|TYPE_S); // extract SURFACE flags
 	if(flagsn_sus&TYPE_S) return;
 	const float rhon = rho[n]; // density of node n
@@ -1960,7 +2488,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 		massn = clamp(massn, 0.0f, rhon);
 		phin = calculate_phi(rhon, massn, TYPE_I); // calculate fill level for next step (only necessary for interface nodes)
 	}
-	uint j[def_velocity_set]; // neighbor indices
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	uint counter = 0u; // count (fluid|interface) neighbors
 	for(uint i=1u; i<def_velocity_set; i++) { // simple model: distribute excess mass equally to all interface and fluid neighbors
@@ -1981,21 +2509,24 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#endif"+R( // FORCE_FIELD
 )+"#ifdef TEMPERATURE"+R(
 	, const global fpxx* gi, global float* T // argument order is important
+	ddfs_tail(const global fpxx*, gi)
 )+"#endif"+R( // TEMPERATURE
+	ddfs_tail(const global fpxx*, fi) // further DDF buffers if the DDFs are split, always the last arguments
 )+") {"+R( // update_fields()
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute update_fields() on halo
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)||is_halo_xyz(xyz)) return; // don't execute update_fields() on halo
+	const uxx n = index(xyz); // n = x+(y+z*Ny)*Nx
 	const uchar flagsn = flags[n];
 	const uchar flagsn_bo=flagsn&TYPE_BO, flagsn_su=flagsn&TYPE_SU; // extract boundary and surface flags
 	if(flagsn_bo==TYPE_S||flagsn_su==TYPE_G) return; // don't update fields for boundary or gas lattice points
 
-	uint j[def_velocity_set]; // neighbor indices
-	neighbors(n, j); // calculate neighbor indices
+	uxx j[def_velocity_set]; // neighbor indices
+	neighbors_xyz(xyz, j); // calculate neighbor indices
 	float fhn[def_velocity_set]; // local DDFs
-	load_f(n, fhn, fi, j, t); // perform streaming (part 2)
+	load_f(n, fhn, ddfs_pass(fi), j, t); // perform streaming (part 2)
 
 )+"#ifdef MOVING_BOUNDARIES"+R(
-	if(flagsn_bo==TYPE_MS) apply_moving_boundaries(fhn, j, u, flags); // apply Dirichlet velocity boundaries if necessary (reads velocities of only neighboring boundary nodes, which do not change during simulation)
+	if(flagsn_bo==TYPE_MS) apply_moving_boundaries(fhn, j, u, solid_neighbors_mask(j, flags)); // apply Dirichlet velocity boundaries if necessary (reads velocities of only neighboring boundary nodes, which do not change during simulation)
 )+"#endif"+R( // MOVING_BOUNDARIES
 
 	float rhon, uxn, uyn, uzn; // calculate local density and velocity for collision
@@ -2012,10 +2543,10 @@ string opencl_c_container() { return R( // ########################## begin of O
 
 )+"#ifdef TEMPERATURE"+R(
 	{ // separate block to avoid variable name conflicts
-		uint j7[7]; // neighbors of D3Q7 subset
-		neighbors_temperature(n, j7);
+		uxx j7[7]; // neighbors of D3Q7 subset
+		neighbors_temperature_xyz(xyz, j7);
 		float ghn[7]; // read from gA and stream to gh (D3Q7 subset, periodic boundary conditions)
-		load_g(n, ghn, gi, j7, t); // perform streaming (part 2)
+		load_g(n, ghn, ddfs_pass(gi), j7, t); // perform streaming (part 2)
 		float Tn;
 		if(flagsn&TYPE_T) {
 			Tn = T[n]; // apply preset temperature
@@ -2060,14 +2591,14 @@ string opencl_c_container() { return R( // ########################## begin of O
 } // update_fields()
 
 )+"#ifdef FORCE_FIELD"+R(
-)+R(kernel void calculate_force_on_boundaries(const global fpxx* fi, const global uchar* flags, const ulong t, global float* F) { // calculate force from the fluid on solid boundaries from fi directly
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute calculate_force_on_boundaries() on halo
+)+R(kernel void calculate_force_on_boundaries(const global fpxx* fi, const global uchar* flags, const ulong t, global float* F ddfs_tail(const global fpxx*, fi)) { // calculate force from the fluid on solid boundaries from fi directly
+	const uxx n = get_global_id(0); // n = x+(y+z*Ny)*Nx
+	if(n>=(uxx)def_N||is_halo(n)) return; // don't execute calculate_force_on_boundaries() on halo
 	if((flags[n]&TYPE_BO)!=TYPE_S) return; // only continue for solid boundary nodes
-	uint j[def_velocity_set]; // neighbor indices
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	float fhn[def_velocity_set]; // local DDFs
-	load_f(n, fhn, fi, j, t); // perform streaming (part 2)
+	load_f(n, fhn, ddfs_pass(fi), j, t); // perform streaming (part 2)
 	float Fb=1.0f, fx=0.0f, fy=0.0f, fz=0.0f;
 	calculate_rho_u(fhn, &Fb, &fx, &fy, &fz); // abuse calculate_rho_u() method for calculating force
 	F[                 n] = 2.0f*fx*Fb; // 2 times because fi are reflected on solid boundary nodes (bounced-back)
@@ -2075,8 +2606,8 @@ string opencl_c_container() { return R( // ########################## begin of O
 	F[2ul*def_N+(ulong)n] = 2.0f*fz*Fb;
 } // calculate_force_on_boundaries()
 )+R(kernel void reset_force_field(global float* F) { // reset force field
-	const uint n = get_global_id(0); // n = x+(y+z*Ny)*Nx
-	if(n>=(uint)def_N) return; // execute reset_force_field() also on halo
+	const uxx n = get_global_id(0); // n = x+(y+z*Ny)*Nx
+	if(n>=(uxx)def_N) return; // execute reset_force_field() also on halo
 	F[                 n] = 0.0f;
 	F[    def_N+(ulong)n] = 0.0f;
 	F[2ul*def_N+(ulong)n] = 0.0f;
@@ -2088,7 +2619,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 	for(uint c=0u; c<8u; c++) { // count over eight corner points
 		const uint i=(c&0x04u)>>2, j=(c&0x02u)>>1, k=c&0x01u; // disassemble c into corner indices ijk
 		const uint x=(xb+i)%def_Nx, y=(yb+j)%def_Ny, z=(zb+k)%def_Nz; // calculate corner lattice positions
-		const uint n = x+(y+z*def_Ny)*def_Nx; // calculate lattice linear index
+		const uxx n = index((uint3)(x, y, z)); // calculate lattice linear index
 		const float d = (1.0f-fabs(x1-(float)i))*(1.0f-fabs(y1-(float)j))*(1.0f-fabs(z1-(float)k)); // force spreading
 		atomic_add_f(&F[                 n], Fn.x*d); // F[                 n] += Fn.x*d;
 		atomic_add_f(&F[    def_N+(ulong)n], Fn.y*d); // F[    def_N+(ulong)n] += Fn.y*d;
@@ -2107,7 +2638,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 	for(uint c=0u; c<8u; c++) { // count over eight corner points
 		const uint i=(c&0x04u)>>2, j=(c&0x02u)>>1, k=c&0x01u; // disassemble c into corner indices ijk
 		const uint x=(xb+i)%def_Nx, y=(yb+j)%def_Ny, z=(zb+k)%def_Nz; // calculate corner lattice positions
-		const uint n = x+(y+z*def_Ny)*def_Nx; // calculate lattice linear index
+		const uxx n = index((uint3)(x, y, z)); // calculate lattice linear index
 		if(flags[n]&(TYPE_S|TYPE_G)) {
 			boundary_force += (float3)(0.5f, 0.5f, 0.5f)-(float3)((float)i, (float)j, (float)k);
 			boundary_distance = fmin(boundary_distance, length((float3)(x1, y1, z1)-(float3)((float)i, (float)j, (float)k)));
@@ -2148,20 +2679,20 @@ string opencl_c_container() { return R( // ########################## begin of O
 	const uint A[3] = { def_Ax, def_Ay, def_Az };
 	return A[direction];
 }
-)+R(uint index_extract_p(const uint a, const uint direction) {
-	const uint3 coordinates[3] = { (uint3)(def_Nx-2u, a%def_Ny, a/def_Ny), (uint3)(a/def_Nz, def_Ny-2u, a%def_Nz), (uint3)(a%def_Nx, a/def_Nx, def_Nz-2u) };
+)+R(uxx index_extract_p(const uint a, const uint direction, const uint l) { // layer l counts away from the domain boundary, l=0 is the outermost interior layer
+	const uint3 coordinates[3] = { (uint3)(def_Nx-def_halo_width-1u-l, a%def_Ny, a/def_Ny), (uint3)(a/def_Nz, def_Ny-def_halo_width-1u-l, a%def_Nz), (uint3)(a%def_Nx, a/def_Nx, def_Nz-def_halo_width-1u-l) };
 	return index(coordinates[direction]);
 }
-)+R(uint index_extract_m(const uint a, const uint direction) {
-	const uint3 coordinates[3] = { (uint3)(       1u, a%def_Ny, a/def_Ny), (uint3)(a/def_Nz,        1u, a%def_Nz), (uint3)(a%def_Nx, a/def_Nx,        1u) };
+)+R(uxx index_extract_m(const uint a, const uint direction, const uint l) {
+	const uint3 coordinates[3] = { (uint3)(def_halo_width+l, a%def_Ny, a/def_Ny), (uint3)(a/def_Nz, def_halo_width+l, a%def_Nz), (uint3)(a%def_Nx, a/def_Nx, def_halo_width+l) };
 	return index(coordinates[direction]);
 }
-)+R(uint index_insert_p(const uint a, const uint direction) {
-	const uint3 coordinates[3] = { (uint3)(def_Nx-1u, a%def_Ny, a/def_Ny), (uint3)(a/def_Nz, def_Ny-1u, a%def_Nz), (uint3)(a%def_Nx, a/def_Nx, def_Nz-1u) };
+)+R(uxx index_insert_p(const uint a, const uint direction, const uint l) { // l=0 is the innermost halo layer
+	const uint3 coordinates[3] = { (uint3)(def_Nx-def_halo_width+l, a%def_Ny, a/def_Ny), (uint3)(a/def_Nz, def_Ny-def_halo_width+l, a%def_Nz), (uint3)(a%def_Nx, a/def_Nx, def_Nz-def_halo_width+l) };
 	return index(coordinates[direction]);
 }
-)+R(uint index_insert_m(const uint a, const uint direction) {
-	const uint3 coordinates[3] = { (uint3)(       0u, a%def_Ny, a/def_Ny), (uint3)(a/def_Nz,        0u, a%def_Nz), (uint3)(a%def_Nx, a/def_Nx,        0u) };
+)+R(uxx index_insert_m(const uint a, const uint direction, const uint l) {
+	const uint3 coordinates[3] = { (uint3)(def_halo_width-1u-l, a%def_Ny, a/def_Ny), (uint3)(a/def_Nz, def_halo_width-1u-l, a%def_Nz), (uint3)(a%def_Nx, a/def_Nx, def_halo_width-1u-l) };
 	return index(coordinates[direction]);
 }
 
@@ -2197,84 +2728,143 @@ string opencl_c_container() { return R( // ########################## begin of O
 	};
 	return (uint)index_transfer_data[side_i];
 }
-)+R(void extract_fi(const uint a, const uint A, const uint n, const uint side, const ulong t, global fpxx_copy* transfer_buffer, const global fpxx_copy* fi) {
-	uint j[def_velocity_set]; // neighbor indices
+)+R(void store_halo_fi(const uint b, const fpxx_copy x, global fpxx_halo* transfer_buffer) {
+)+"#ifdef HALO_FP16_FI"+R(
+	vstore_half_rte(x*32768.0f, b, (global half*)transfer_buffer); // pack FP32 DDF into the scaled FP16 format of FP16S
+)+"#else"+R( // HALO_FP16_FI
+	transfer_buffer[b] = x; // fpxx_copy allows direct copying without decompression+compression
+)+"#endif"+R( // HALO_FP16_FI
+}
+)+R(fpxx_copy load_halo_fi(const uint b, const global fpxx_halo* transfer_buffer) {
+)+"#ifdef HALO_FP16_FI"+R(
+	return vload_half(b, (const global half*)transfer_buffer)*3.0517578E-5f; // unpack scaled FP16 DDF
+)+"#else"+R( // HALO_FP16_FI
+	return transfer_buffer[b]; // fpxx_copy allows direct copying without decompression+compression
+)+"#endif"+R( // HALO_FP16_FI
+}
+)+R(void extract_fi(const uint a, const uint A, const uxx n, const uint side, const ulong t, global fpxx_halo* transfer_buffer, ddfs(const global fpxx_copy*, fi)) {
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	for(uint b=0u; b<def_transfers; b++) {
 		const uint i = index_transfer(side*def_transfers+b);
-		const ulong index = index_f(i%2u ? j[i] : n, t%2ul ? (i%2u ? i+1u : i-1u) : i); // Esoteric-Pull: standard store, or streaming part 1/2
-		transfer_buffer[b*A+a] = fi[index]; // fpxx_copy allows direct copying without decompression+compression
+		const uint d = t%2ul ? (i%2u ? i+1u : i-1u) : i; // DDF direction
+		const ulong index = index_f(i%2u ? j[i] : n, d); // Esoteric-Pull: standard store, or streaming part 1/2
+		store_halo_fi(b*A+a, ddf(fi, d)[index], transfer_buffer);
 	}
 }
-)+R(void insert_fi(const uint a, const uint A, const uint n, const uint side, const ulong t, const global fpxx_copy* transfer_buffer, global fpxx_copy* fi) {
-	uint j[def_velocity_set]; // neighbor indices
+)+R(void insert_fi(const uint a, const uint A, const uxx n, const uint side, const ulong t, const global fpxx_halo* transfer_buffer, ddfs(global fpxx_copy*, fi)) {
+	uxx j[def_velocity_set]; // neighbor indices
 	neighbors(n, j); // calculate neighbor indices
 	for(uint b=0u; b<def_transfers; b++) {
 		const uint i = index_transfer(side*def_transfers+b);
-		const ulong index = index_f(i%2u ? n : j[i-1u], t%2ul ? i : (i%2u ? i+1u : i-1u)); // Esoteric-Pull: standard load, or streaming part 2/2
-		fi[index] = transfer_buffer[b*A+a]; // fpxx_copy allows direct copying without decompression+compression
+		const uint d = t%2ul ? i : (i%2u ? i+1u : i-1u); // DDF direction
+		const ulong index = index_f(i%2u ? n : j[i-1u], d); // Esoteric-Pull: standard load, or streaming part 2/2
+		ddf(fi, d)[index] = load_halo_fi(b*A+a, transfer_buffer);
 	}
 }
-)+R(kernel void transfer_extract_fi(const uint direction, const ulong t, global fpxx_copy* transfer_buffer_p, global fpxx_copy* transfer_buffer_m, const global fpxx_copy* fi) {
+)+"#ifdef HALO_WIDE"+R( // the neighbor domain recomputes its inner halo layers locally, so it needs all DDFs stored at these layers, behind the DDFs crossing the domain boundary
+)+R(void extract_fi_layers(const uint a, const uint A, const uint direction, const uint side, global fpxx_halo* transfer_buffer, ddfs(const global fpxx_copy*, fi)) {
+	for(uint l=0u; l<def_halo_width; l++) {
+		const uxx n = side%2u ? index_extract_m(a, direction, l) : index_extract_p(a, direction, l);
+		for(uint i=0u; i<def_velocity_set; i++) store_halo_fi((def_transfers+l*def_velocity_set+i)*A+a, ddf(fi, i)[index_f(n, i)], transfer_buffer); // DDFs are stored in-place, independent of time step parity
+	}
+}
+)+R(void insert_fi_layers(const uint a, const uint A, const uint direction, const uint side, const global fpxx_halo* transfer_buffer, ddfs(global fpxx_copy*, fi)) {
+	for(uint l=0u; l<def_halo_width; l++) {
+		const uxx n = side%2u ? index_insert_m(a, direction, l) : index_insert_p(a, direction, l);
+		for(uint i=0u; i<def_velocity_set; i++) ddf(fi, i)[index_f(n, i)] = load_halo_fi((def_transfers+l*def_velocity_set+i)*A+a, transfer_buffer);
+	}
+}
+)+"#endif"+R( // HALO_WIDE
+)+R(kernel void transfer_extract_fi(const uint direction, const ulong t, global fpxx_halo* transfer_buffer_p, global fpxx_halo* transfer_buffer_m, const global fpxx_copy* fi ddfs_tail(const global fpxx_copy*, fi)) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	extract_fi(a, A, index_extract_p(a, direction), 2u*direction+0u, t, transfer_buffer_p, fi);
-	extract_fi(a, A, index_extract_m(a, direction), 2u*direction+1u, t, transfer_buffer_m, fi);
-}
-)+R(kernel void transfer__insert_fi(const uint direction, const ulong t, const global fpxx_copy* transfer_buffer_p, const global fpxx_copy* transfer_buffer_m, global fpxx_copy* fi) {
+	extract_fi(a, A, index_extract_p(a, direction, 0u), 2u*direction+0u, t, transfer_buffer_p, ddfs_pass(fi));
+	extract_fi(a, A, index_extract_m(a, direction, 0u), 2u*direction+1u, t, transfer_buffer_m, ddfs_pass(fi));
+)+"#ifdef HALO_WIDE"+R(
+	extract_fi_layers(a, A, direction, 2u*direction+0u, transfer_buffer_p, ddfs_pass(fi));
+	extract_fi_layers(a, A, direction, 2u*direction+1u, transfer_buffer_m, ddfs_pass(fi));
+)+"#endif"+R( // HALO_WIDE
+}
+)+R(kernel void transfer__insert_fi(const uint direction, const ulong t, const global fpxx_halo* transfer_buffer_p, const global fpxx_halo* transfer_buffer_m, global fpxx_copy* fi ddfs_tail(global fpxx_copy*, fi)) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	insert_fi(a, A, index_insert_p(a, direction), 2u*direction+0u, t, transfer_buffer_p, fi);
-	insert_fi(a, A, index_insert_m(a, direction), 2u*direction+1u, t, transfer_buffer_m, fi);
-}
-
-)+R(void extract_rho_u_flags(const uint a, const uint A, const uint n, global char* transfer_buffer, const global float* rho, const global float* u, const global uchar* flags) {
+	insert_fi(a, A, index_insert_p(a, direction, 0u), 2u*direction+0u, t, transfer_buffer_p, ddfs_pass(fi));
+	insert_fi(a, A, index_insert_m(a, direction, 0u), 2u*direction+1u, t, transfer_buffer_m, ddfs_pass(fi));
+)+"#ifdef HALO_WIDE"+R(
+	insert_fi_layers(a, A, direction, 2u*direction+0u, transfer_buffer_p, ddfs_pass(fi));
+	insert_fi_layers(a, A, direction, 2u*direction+1u, transfer_buffer_m, ddfs_pass(fi));
+)+"#endif"+R( // HALO_WIDE
+}
+
+)+"#ifdef HALO_FP16_RHO_U"+R( // rho-1 and u are within [-2, 2], scaling by 2^15 uses the full FP16 range and avoids denormals
+)+R(void extract_rho_u_flags(const uint a, const uint A, const uxx n, global char* transfer_buffer, const global float* rho, const global float* u, const global uchar* flags) {
+	vstore_half_rte((rho[n]-1.0f       )*32768.0f,      a, (global half*)transfer_buffer);
+	vstore_half_rte(u[                 n]*32768.0f,    A+a, (global half*)transfer_buffer);
+	vstore_half_rte(u[    def_N+(ulong)n]*32768.0f, 2u*A+a, (global half*)transfer_buffer);
+	vstore_half_rte(u[2ul*def_N+(ulong)n]*32768.0f, 3u*A+a, (global half*)transfer_buffer);
+	((global uchar*)transfer_buffer)[8u*A+a] = flags[n];
+}
+)+R(void insert_rho_u_flags(const uint a, const uint A, const uxx n, const global char* transfer_buffer, global float* rho, global float* u, global uchar* flags) {
+	rho[               n] = fma(vload_half(     a, (const global half*)transfer_buffer), 3.0517578E-5f, 1.0f);
+	u[                 n] = vload_half(   A+a, (const global half*)transfer_buffer)*3.0517578E-5f;
+	u[    def_N+(ulong)n] = vload_half(2u*A+a, (const global half*)transfer_buffer)*3.0517578E-5f;
+	u[2ul*def_N+(ulong)n] = vload_half(3u*A+a, (const global half*)transfer_buffer)*3.0517578E-5f;
+	flags[n] = ((const global uchar*)transfer_buffer)[8u*A+a];
+}
+)+"#else"+R( // HALO_FP16_RHO_U
+)+R(void extract_rho_u_flags(const uint a, const uint A, const uxx n, global char* transfer_buffer, const global float* rho, const global float* u, const global uchar* flags) {
 	((global float*)transfer_buffer)[      a] = rho[               n];
 	((global float*)transfer_buffer)[    A+a] = u[                 n];
 	((global float*)transfer_buffer)[ 2u*A+a] = u[    def_N+(ulong)n];
 	((global float*)transfer_buffer)[ 3u*A+a] = u[2ul*def_N+(ulong)n];
 	((global uchar*)transfer_buffer)[16u*A+a] = flags[             n];
 }
-)+R(void insert_rho_u_flags(const uint a, const uint A, const uint n, const global char* transfer_buffer, global float* rho, global float* u, global uchar* flags) {
+)+R(void insert_rho_u_flags(const uint a, const uint A, const uxx n, const global char* transfer_buffer, global float* rho, global float* u, global uchar* flags) {
 	rho[               n] = ((const global float*)transfer_buffer)[      a];
 	u[                 n] = ((const global float*)transfer_buffer)[    A+a];
 	u[    def_N+(ulong)n] = ((const global float*)transfer_buffer)[ 2u*A+a];
 	u[2ul*def_N+(ulong)n] = ((const global float*)transfer_buffer)[ 3u*A+a];
 	flags[             n] = ((const global uchar*)transfer_buffer)[16u*A+a];
 }
+)+"#endif"+R( // HALO_FP16_RHO_U
 )+R(kernel void transfer_extract_rho_u_flags(const uint direction, const ulong t, global char* transfer_buffer_p, global char* transfer_buffer_m, const global float* rho, const global float* u, const global uchar* flags) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	extract_rho_u_flags(a, A, index_extract_p(a, direction), transfer_buffer_p, rho, u, flags);
-	extract_rho_u_flags(a, A, index_extract_m(a, direction), transfer_buffer_m, rho, u, flags);
+	for(uint l=0u; l<def_halo_width; l++) { // all halo layers are packed like one def_halo_width times larger area
+		extract_rho_u_flags(l*A+a, def_halo_width*A, index_extract_p(a, direction, l), transfer_buffer_p, rho, u, flags);
+		extract_rho_u_flags(l*A+a, def_halo_width*A, index_extract_m(a, direction, l), transfer_buffer_m, rho, u, flags);
+	}
 }
 )+R(kernel void transfer__insert_rho_u_flags(const uint direction, const ulong t, const global char* transfer_buffer_p, const global char* transfer_buffer_m, global float* rho, global float* u, global uchar* flags) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	insert_rho_u_flags(a, A, index_insert_p(a, direction), transfer_buffer_p, rho, u, flags);
-	insert_rho_u_flags(a, A, index_insert_m(a, direction), transfer_buffer_m, rho, u, flags);
+	for(uint l=0u; l<def_halo_width; l++) { // all halo layers are packed like one def_halo_width times larger area
+		insert_rho_u_flags(l*A+a, def_halo_width*A, index_insert_p(a, direction, l), transfer_buffer_p, rho, u, flags);
+		insert_rho_u_flags(l*A+a, def_halo_width*A, index_insert_m(a, direction, l), transfer_buffer_m, rho, u, flags);
+	}
 }
 
 )+"#ifdef SURFACE"+R(
 )+R(kernel void transfer_extract_flags(const uint direction, const ulong t, global uchar* transfer_buffer_p, global uchar* transfer_buffer_m, const global uchar* flags) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	transfer_buffer_p[a] = flags[index_extract_p(a, direction)];
-	transfer_buffer_m[a] = flags[index_extract_m(a, direction)];
+	transfer_buffer_p[a] = flags[index_extract_p(a, direction, 0u)];
+	transfer_buffer_m[a] = flags[index_extract_m(a, direction, 0u)];
 }
 )+R(kernel void transfer__insert_flags(const uint direction, const ulong t, const global uchar* transfer_buffer_p, const global uchar* transfer_buffer_m, global uchar* flags) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	flags[index_insert_p(a, direction)] = transfer_buffer_p[a];
-	flags[index_insert_m(a, direction)] = transfer_buffer_m[a];
+	flags[index_insert_p(a, direction, 0u)] = transfer_buffer_p[a];
+	flags[index_insert_m(a, direction, 0u)] = transfer_buffer_m[a];
 }
 
-)+R(void extract_phi_massex_flags(const uint a, const uint A, const uint n, global char* transfer_buffer, const global float* phi, const global float* massex, const global uchar* flags) {
+)+R(void extract_phi_massex_flags(const uint a, const uint A, const uxx n, global char* transfer_buffer, const global float* phi, const global float* massex, const global uchar* flags) {
 	((global float*)transfer_buffer)[     a] = phi   [n];
 	((global float*)transfer_buffer)[   A+a] = massex[n];
 	((global uchar*)transfer_buffer)[8u*A+a] = flags [n];
 }
-)+R(void insert_phi_massex_flags(const uint a, const uint A, const uint n, const global char* transfer_buffer, global float* phi, global float* massex, global uchar* flags) {
+)+R(void insert_phi_massex_flags(const uint a, const uint A, const uxx n, const global char* transfer_buffer, global float* phi, global float* massex, global uchar* flags) {
 	phi   [n] = ((global float*)transfer_buffer)[     a];
 	massex[n] = ((global float*)transfer_buffer)[   A+a];
 	flags [n] = ((global uchar*)transfer_buffer)[8u*A+a];
@@ -2282,49 +2872,51 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+R(kernel void transfer_extract_phi_massex_flags(const uint direction, const ulong t, global char* transfer_buffer_p, global char* transfer_buffer_m, const global float* phi, const global float* massex, const global uchar* flags) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	extract_phi_massex_flags(a, A, index_extract_p(a, direction), transfer_buffer_p, phi, massex, flags);
-	extract_phi_massex_flags(a, A, index_extract_m(a, direction), transfer_buffer_m, phi, massex, flags);
+	extract_phi_massex_flags(a, A, index_extract_p(a, direction, 0u), transfer_buffer_p, phi, massex, flags);
+	extract_phi_massex_flags(a, A, index_extract_m(a, direction, 0u), transfer_buffer_m, phi, massex, flags);
 }
 )+R(kernel void transfer__insert_phi_massex_flags(const uint direction, const ulong t, const global char* transfer_buffer_p, const global char* transfer_buffer_m, global float* phi, global float* massex, global uchar* flags) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	insert_phi_massex_flags(a, A, index_insert_p(a, direction), transfer_buffer_p, phi, massex, flags);
-	insert_phi_massex_flags(a, A, index_insert_m(a, direction), transfer_buffer_m, phi, massex, flags);
+	insert_phi_massex_flags(a, A, index_insert_p(a, direction, 0u), transfer_buffer_p, phi, massex, flags);
+	insert_phi_massex_flags(a, A, index_insert_m(a, direction, 0u), transfer_buffer_m, phi, massex, flags);
 }
 )+"#endif"+R( // SURFACE
 
 )+"#ifdef TEMPERATURE"+R(
-)+R(void extract_gi(const uint a, const uint n, const uint side, const ulong t, global fpxx_copy* transfer_buffer, const global fpxx_copy* gi) {
-	uint j7[7u]; // neighbor indices
+)+R(void extract_gi(const uint a, const uxx n, const uint side, const ulong t, global fpxx_copy* transfer_buffer, ddfs(const global fpxx_copy*, gi)) {
+	uxx j7[7u]; // neighbor indices
 	neighbors_temperature(n, j7); // calculate neighbor indices
 	const uint i = side+1u;
-	const ulong index = index_f(i%2u ? j7[i] : n, t%2ul ? (i%2u ? i+1u : i-1u) : i); // Esoteric-Pull: standard store, or streaming part 1/2
-	transfer_buffer[a] = gi[index]; // fpxx_copy allows direct copying without decompression+compression
+	const uint d = t%2ul ? (i%2u ? i+1u : i-1u) : i; // DDF direction
+	const ulong index = index_g(i%2u ? j7[i] : n, d); // Esoteric-Pull: standard store, or streaming part 1/2
+	transfer_buffer[a] = ddf(gi, d)[index]; // fpxx_copy allows direct copying without decompression+compression
 }
-)+R(void insert_gi(const uint a, const uint n, const uint side, const ulong t, const global fpxx_copy* transfer_buffer, global fpxx_copy* gi) {
-	uint j7[7u]; // neighbor indices
+)+R(void insert_gi(const uint a, const uxx n, const uint side, const ulong t, const global fpxx_copy* transfer_buffer, ddfs(global fpxx_copy*, gi)) {
+	uxx j7[7u]; // neighbor indices
 	neighbors_temperature(n, j7); // calculate neighbor indices
 	const uint i = side+1u;
-	const ulong index = index_f(i%2u ? n : j7[i-1u], t%2ul ? i : (i%2u ? i+1u : i-1u)); // Esoteric-Pull: standard load, or streaming part 2/2
-	gi[index] = transfer_buffer[a]; // fpxx_copy allows direct copying without decompression+compression
+	const uint d = t%2ul ? i : (i%2u ? i+1u : i-1u); // DDF direction
+	const ulong index = index_g(i%2u ? n : j7[i-1u], d); // Esoteric-Pull: standard load, or streaming part 2/2
+	ddf(gi, d)[index] = transfer_buffer[a]; // fpxx_copy allows direct copying without decompression+compression
 }
-)+R(kernel void transfer_extract_gi(const uint direction, const ulong t, global fpxx_copy* transfer_buffer_p, global fpxx_copy* transfer_buffer_m, const global fpxx_copy* gi) {
+)+R(kernel void transfer_extract_gi(const uint direction, const ulong t, global fpxx_copy* transfer_buffer_p, global fpxx_copy* transfer_buffer_m, const global fpxx_copy* gi ddfs_tail(const global fpxx_copy*, gi)) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	extract_gi(a, index_extract_p(a, direction), 2u*direction+0u, t, transfer_buffer_p, gi);
-	extract_gi(a, index_extract_m(a, direction), 2u*direction+1u, t, transfer_buffer_m, gi);
+	extract_gi(a, index_extract_p(a, direction, 0u), 2u*direction+0u, t, transfer_buffer_p, ddfs_pass(gi));
+	extract_gi(a, index_extract_m(a, direction, 0u), 2u*direction+1u, t, transfer_buffer_m, ddfs_pass(gi));
 }
-)+R(kernel void transfer__insert_gi(const uint direction, const ulong t, const global fpxx_copy* transfer_buffer_p, const global fpxx_copy* transfer_buffer_m, global fpxx_copy* gi) {
+)+R(kernel void transfer__insert_gi(const uint direction, const ulong t, const global fpxx_copy* transfer_buffer_p, const global fpxx_copy* transfer_buffer_m, global fpxx_copy* gi ddfs_tail(global fpxx_copy*, gi)) {
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
-	insert_gi(a, index_insert_p(a, direction), 2u*direction+0u, t, transfer_buffer_p, gi);
-	insert_gi(a, index_insert_m(a, direction), 2u*direction+1u, t, transfer_buffer_m, gi);
+	insert_gi(a, index_insert_p(a, direction, 0u), 2u*direction+0u, t, transfer_buffer_p, ddfs_pass(gi));
+	insert_gi(a, index_insert_m(a, direction, 0u), 2u*direction+1u, t, transfer_buffer_m, ddfs_pass(gi));
 }
 )+"#endif"+R( // TEMPERATURE
 
 
 
-)+R(kernel void voxelize_mesh(const uint direction, global fpxx* fi, global float* u, global uchar* flags, const ulong t, const uchar flag, const global float* p0, const global float* p1, const global float* p2, const global float* bbu) { // voxelize triangle mesh
+)+R(kernel void voxelize_mesh(const uint direction, global fpxx* fi, global float* u, global uchar* flags, const ulong t, const uchar flag, const global float* p0, const global float* p1, const global float* p2, const global float* bbu ddfs_tail(global fpxx*, fi)) { // voxelize triangle mesh
 	const uint a=get_global_id(0), A=get_area(direction); // a = domain area index for each side, A = area of the domain boundary
 	if(a>=A) return; // area might not be a multiple of def_workgroup_size, so return here to avoid writing in unallocated memory space
 	const uint triangle_number = as_uint(bbu[0]);
@@ -2332,7 +2924,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 	const float cx=bbu[ 7], cy=bbu[ 8], cz=bbu[ 9], ux=bbu[10], uy=bbu[11], uz=bbu[12], rx=bbu[13], ry=bbu[14], rz=bbu[15];
 	const uint3 xyz = direction==0u ? (uint3)((uint)clamp((int)x0-def_Ox, 0, (int)def_Nx-1), a%def_Ny, a/def_Ny) : direction==1u ? (uint3)(a/def_Nz, (uint)clamp((int)y0-def_Oy, 0, (int)def_Ny-1), a%def_Nz) : (uint3)(a%def_Nx, a/def_Nx, (uint)clamp((int)z0-def_Oz, 0, (int)def_Nz-1));
 	const float3 p = position(xyz);
-	const float3 offset = (float3)(0.5f*(float)((def_Nx-2u*(def_Dx>1u))*def_Dx)-0.5f, 0.5f*(float)((def_Ny-2u*(def_Dy>1u))*def_Dy)-0.5f, 0.5f*(float)((def_Nz-2u*(def_Dz>1u))*def_Dz)-0.5f)+(float3)(def_domain_offset_x, def_domain_offset_y, def_domain_offset_z);
+	const float3 offset = (float3)(0.5f*(float)def_global_Nx-0.5f, 0.5f*(float)def_global_Ny-0.5f, 0.5f*(float)def_global_Nz-0.5f)+(float3)(def_domain_offset_x, def_domain_offset_y, def_domain_offset_z);
 	const float3 r_origin = p+offset;
 	const float3 r_direction = (float3)((float)(direction==0u), (float)(direction==1u), (float)(direction==2u));
 	uint intersections=0u, intersections_check=0u;
@@ -2378,7 +2970,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 			intersection++;
 		}
 		inside &= (intersection<intersections&&h<hmesh); // point must be outside if there are no more ray-mesh intersections ahead (error correction)
-		const ulong n = index((uint3)(direction==0u?h:xyz.x, direction==1u?h:xyz.y, direction==2u?h:xyz.z));
+		const uxx n = index((uint3)(direction==0u?h:xyz.x, direction==1u?h:xyz.y, direction==2u?h:xyz.z));
 		uchar flagsn = flags[n];
 		if(inside) {
 			flagsn = (flagsn&~TYPE_BO)|flag;
@@ -2393,11 +2985,11 @@ string opencl_c_container() { return R( // ########################## begin of O
 			if(set_u) {
 				const float3 un = (float3)(u[n], u[def_N+(ulong)n], u[2ul*def_N+(ulong)n]); // for velocity voxelization, only clear moving boundaries
 				if((flagsn&TYPE_BO)==TYPE_S) { // reconstruct DDFs when boundary point is converted to fluid
-					uint j[def_velocity_set]; // neighbor indices
+					uxx j[def_velocity_set]; // neighbor indices
 					neighbors(n, j); // calculate neighbor indices
 					float feq[def_velocity_set]; // f_equilibrium
 					calculate_f_eq(1.0f, un.x, un.y, un.z, feq);
-					store_f(n, feq, fi, j, t); // write to fi
+					store_f(n, feq, ddfs_pass(fi), j, t); // write to fi
 				}
 				if(sq(un.x)+sq(un.y)+sq(un.z)>0.0f) {
 					flagsn = (flagsn&TYPE_BO)==TYPE_MS ? flagsn&~TYPE_MS : flagsn&~flag;
@@ -2411,11 +3003,22 @@ string opencl_c_container() { return R( // ########################## begin of O
 } // voxelize_mesh()
 
 )+R(kernel void unvoxelize_mesh(global uchar* flags, const uchar flag, float x0, float y0, float z0, float x1, float y1, float z1) { // remove voxelized triangle mesh
-	const uint n = get_global_id(0);
-	const float3 p = position(coordinates(n))+(float3)(0.5f*(float)((def_Nx-2u*(def_Dx>1u))*def_Dx)-0.5f, 0.5f*(float)((def_Ny-2u*(def_Dy>1u))*def_Dy)-0.5f, 0.5f*(float)((def_Nz-2u*(def_Dz>1u))*def_Dz)-0.5f)+(float3)(def_domain_offset_x, def_domain_offset_y, def_domain_offset_z);
+	const uxx n = get_global_id(0);
+	const float3 p = position(coordinates(n))+(float3)(0.5f*(float)def_global_Nx-0.5f, 0.5f*(float)def_global_Ny-0.5f, 0.5f*(float)def_global_Nz-0.5f)+(float3)(def_domain_offset_x, def_domain_offset_y, def_domain_offset_z);
 	if(p.x>=x0-1.0f&&p.y>=y0-1.0f&&p.z>=z0-1.0f&&p.x<=x1+1.0f&&p.y<=y1+1.0f&&p.z<=z1+1.0f) flags[n] &= ~flag;
 } // unvoxelize_mesh()
 
+)+R(kernel void count_active_cells(const global uchar* flags, volatile global uint* cells) { // count active (not solid and not gas) nodes in every x/y/z plane of the domain, for dynamic domain repartitioning
+	const uxx n = get_global_id(0);
+	if(n>=(uxx)def_N||is_halo(n)) return; // don't count halo nodes
+	const uchar flagsn = flags[n];
+	if((flagsn&TYPE_BO)==TYPE_S||(flagsn&TYPE_SU)==TYPE_G) return; // solid and gas nodes return early in stream_collide() and cost next to nothing
+	const uint3 xyz = coordinates(n);
+	if(def_Dx>1u) atomic_inc(&cells[xyz.x]); // only count planes in directions that are split into domains
+	if(def_Dy>1u) atomic_inc(&cells[def_Nx+xyz.y]);
+	if(def_Dz>1u) atomic_inc(&cells[def_Nx+def_Ny+xyz.z]);
+} // count_active_cells()
+
 
 
 // ################################################## graphics code ##################################################
@@ -2427,17 +3030,17 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#else"+R( // FORCE_FIELD
 )+R(kernel void graphics_flags(const global uchar* flags, const global float* camera, global int* bitmap, global int* zbuffer, const global float* F) {
 )+"#endif"+R( // FORCE_FIELD
-	const uint n = get_global_id(0);
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute graphics_flags() on halo
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)||is_halo_xyz(xyz)) return; // don't execute graphics_flags() on halo
+	const uxx n = index(xyz);
 	const uchar flagsn = flags[n]; // cache flags
 	const uchar flagsn_bo = flagsn&TYPE_BO; // extract boundary flags
 	if(flagsn==0u||flagsn==TYPE_G) return; // don't draw regular fluid nodes
 	//if(flagsn&TYPE_SU) return; // don't draw surface
 	float camera_cache[15]; // cache camera parameters in case the kernel draws more than one shape
 	for(uint i=0u; i<15u; i++) camera_cache[i] = camera[i];
-	uint x0, xp, xm, y0, yp, ym, z0, zp, zm;
-	calculate_indices(n, &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
-	const uint3 xyz = coordinates(n);
+	uxx x0, xp, xm, y0, yp, ym, z0, zp, zm;
+	calculate_indices(xyz, &x0, &xp, &xm, &y0, &yp, &ym, &z0, &zp, &zm);
 	const float3 p = position(xyz);
 	const int c =  // coloring scheme
 		flagsn_bo==TYPE_S ? COLOR_S : // solid boundary
@@ -2496,18 +3099,18 @@ string opencl_c_container() { return R( // ########################## begin of O
 )+"#else"+R( // FORCE_FIELD
 )+R(kernel void graphics_flags_mc(const global uchar* flags, const global float* camera, global int* bitmap, global int* zbuffer, const global float* F) {
 )+"#endif"+R( // FORCE_FIELD
-	const uint n = get_global_id(0);
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute graphics_flags() on halo
-	const uint3 xyz = coordinates(n);
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)||is_halo_xyz(xyz)) return; // don't execute graphics_flags() on halo
+	const uxx n = index(xyz);
 	if(xyz.x>=def_Nx-2u||xyz.y>=def_Ny-2u||xyz.z>=def_Nz-2u||xyz.x==0u||xyz.y==0u||xyz.z==0u) return;
 	//if(xyz.x==0u||xyz.y==0u||xyz.z==0u||xyz.x>=def_Nx-2u||xyz.y>=def_Ny-2u||xyz.z>=def_Nz-2u) return;
-	uint j[8];
+	uxx j[8];
 	const uint x0 =  xyz.x; // cube stencil
 	const uint xp =  xyz.x+1u;
-	const uint y0 =  xyz.y    *def_Nx;
-	const uint yp = (xyz.y+1u)*def_Nx;
-	const uint z0 =  xyz.z    *def_Ny*def_Nx;
-	const uint zp = (xyz.z+1u)*def_Ny*def_Nx;
+	const uxx y0 = (uxx)xyz.y     *def_Nx;
+	const uxx yp = (uxx)(xyz.y+1u)*def_Nx;
+	const uxx z0 = (uxx)xyz.z     *def_Ny*def_Nx;
+	const uxx zp = (uxx)(xyz.z+1u)*def_Ny*def_Nx;
 	j[0] = n       ; // 000
 	j[1] = xp+y0+z0; // +00
 	j[2] = xp+y0+zp; // +0+
@@ -2556,9 +3159,9 @@ string opencl_c_container() { return R( // ########################## begin of O
 }
 
 )+R(kernel void graphics_field(const global uchar* flags, const global float* u, const global float* camera, global int* bitmap, global int* zbuffer, const int slice_mode, const int slice_x, const int slice_y, const int slice_z) {
-	const uint n = get_global_id(0);
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute graphics_field() on halo
-	const uint3 xyz = coordinates(n);
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)||is_halo_xyz(xyz)) return; // don't execute graphics_field() on halo
+	const uxx n = index(xyz);
 	const bool rx=(int)xyz.x!=slice_x, ry=(int)xyz.y!=slice_y, rz=(int)xyz.z!=slice_z;
 	if((slice_mode==1&&rx)||(slice_mode==2&&ry)||(slice_mode==3&&rz)||(slice_mode==4&&rx&&rz)||(slice_mode==5&&rx&&ry&&rz)||(slice_mode==6&&ry&&rz)||(slice_mode==7&&rx&&ry)) return;
 )+"#ifndef MOVING_BOUNDARIES"+R(
@@ -2571,7 +3174,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 	if(def_scale_u*ul<0.1f) return; // don't draw lattice points where the velocity is lower than this threshold
 	float camera_cache[15]; // cache camera parameters in case the kernel draws more than one shape
 	for(uint i=0u; i<15u; i++) camera_cache[i] = camera[i];
-	const float3 p = position(coordinates(n));
+	const float3 p = position(xyz);
 	const int c = iron_color(255.0f*def_scale_u*ul); // coloring by velocity
 	draw_line(p-(0.5f/ul)*un, p+(0.5f/ul)*un, c, camera_cache, bitmap, zbuffer);
 }
@@ -2612,7 +3215,7 @@ string opencl_c_container() { return R( // ########################## begin of O
 			const uint x = (uint)(p1.x+1.5f*(float)def_Nx)%def_Nx;
 			const uint y = (uint)(p1.y+1.5f*(float)def_Ny)%def_Ny;
 			const uint z = (uint)(p1.z+1.5f*(float)def_Nz)%def_Nz;
-			const uint n = x+(y+z*def_Ny)*def_Nx;
+			const uxx n = index((uint3)(x, y, z));
 			if(flags[n]&(TYPE_S|TYPE_E|TYPE_I|TYPE_G)) return;
 			const float3 un = load_u(n, u); // interpolate_u(p1, u)
 			const float ul = length(un);
@@ -2630,8 +3233,9 @@ string opencl_c_container() { return R( // ########################## begin of O
 }
 
 )+R(kernel void graphics_q_field(const global uchar* flags, const global float* u, const global float* camera, global int* bitmap, global int* zbuffer) {
-	const uint n = get_global_id(0);
-	if(n>=(uint)def_N||is_halo(n)) return; // don't execute graphics_q_field() on halo
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
+	if(is_outside(xyz)||is_halo_xyz(xyz)) return; // don't execute graphics_q_field() on halo
+	const uxx n = index(xyz);
 	if(flags[n]&(TYPE_S|TYPE_E|TYPE_I|TYPE_G)) return;
 	float3 un = load_u(n, u); // cache velocity
 	const float ul = length(un);
@@ -2639,29 +3243,28 @@ string opencl_c_container() { return R( // ########################## begin of O
 	if(Q<def_scale_Q_min||ul==0.0f) return; // don't draw lattice points where the velocity is very low
 	float camera_cache[15]; // cache camera parameters in case the kernel draws more than one shape
 	for(uint i=0u; i<15u; i++) camera_cache[i] = camera[i];
-	const float3 p = position(coordinates(n));
+	const float3 p = position(xyz);
 	const int c = rainbow_color(255.0f*def_scale_u*ul); // coloring by velocity
 	draw_line(p-(0.5f/ul)*un, p+(0.5f/ul)*un, c, camera_cache, bitmap, zbuffer);
 }
 
 )+R(kernel void graphics_q(const global uchar* flags, const global float* u, const global float* camera, global int* bitmap, global int* zbuffer) {
-	const uint n = get_global_id(0);
-	const uint3 xyz = coordinates(n);
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
 	if(xyz.x>=def_Nx-1u||xyz.y>=def_Ny-1u||xyz.z>=def_Nz-1u||is_halo_q(xyz)) return; // don't execute graphics_q_field() on marching-cubes halo
 	const uint x0 =  xyz.x; // cube stencil
 	const uint xp =  xyz.x+1u;
-	const uint y0 =  xyz.y    *def_Nx;
-	const uint yp = (xyz.y+1u)*def_Nx;
-	const uint z0 =  xyz.z    *def_Ny*def_Nx;
-	const uint zp = (xyz.z+1u)*def_Ny*def_Nx;
+	const uxx y0 = (uxx)xyz.y     *def_Nx;
+	const uxx yp = (uxx)(xyz.y+1u)*def_Nx;
+	const uxx z0 = (uxx)xyz.z     *def_Ny*def_Nx;
+	const uxx zp = (uxx)(xyz.z+1u)*def_Ny*def_Nx;
 	const uint xq =  (xyz.x       +2u)%def_Nx; // central difference stencil on each cube corner point
 	const uint xm =  (xyz.x+def_Nx-1u)%def_Nx;
-	const uint yq = ((xyz.y       +2u)%def_Ny)*def_Nx;
-	const uint ym = ((xyz.y+def_Ny-1u)%def_Ny)*def_Nx;
-	const uint zq = ((xyz.z       +2u)%def_Nz)*def_Ny*def_Nx;
-	const uint zm = ((xyz.z+def_Nz-1u)%def_Nz)*def_Ny*def_Nx;
-	uint j[32];
-	j[ 0] = n       ; // 000 // cube stencil
+	const uxx yq = (uxx)((xyz.y       +2u)%def_Ny)*def_Nx;
+	const uxx ym = (uxx)((xyz.y+def_Ny-1u)%def_Ny)*def_Nx;
+	const uxx zq = (uxx)((xyz.z       +2u)%def_Nz)*def_Ny*def_Nx;
+	const uxx zm = (uxx)((xyz.z+def_Nz-1u)%def_Nz)*def_Ny*def_Nx;
+	uxx j[32];
+	j[ 0] = x0+y0+z0; // 000 // cube stencil
 	j[ 1] = xp+y0+z0; // +00
 	j[ 2] = xp+y0+zp; // +0+
 	j[ 3] = x0+y0+zp; // 00+
@@ -2737,17 +3340,16 @@ string opencl_c_container() { return R( // ########################## begin of O
 
 )+"#ifdef SURFACE"+R(
 )+R(kernel void graphics_rasterize_phi(const global float* phi, const global float* camera, global int* bitmap, global int* zbuffer) { // marching cubes
-	const uint n = get_global_id(0);
-	const uint3 xyz = coordinates(n);
+	const uint3 xyz = global_xyz(); // 3D range, one work-item per lattice point
 	if(xyz.x>=def_Nx-1u||xyz.y>=def_Ny-1u||xyz.z>=def_Nz-1u) return;
-	uint j[8];
+	uxx j[8];
 	const uint x0 =  xyz.x; // cube stencil
 	const uint xp =  xyz.x+1u;
-	const uint y0 =  xyz.y    *def_Nx;
-	const uint yp = (xyz.y+1u)*def_Nx;
-	const uint z0 =  xyz.z    *def_Ny*def_Nx;
-	const uint zp = (xyz.z+1u)*def_Ny*def_Nx;
-	j[0] = n       ; // 000
+	const uxx y0 = (uxx)xyz.y     *def_Nx;
+	const uxx yp = (uxx)(xyz.y+1u)*def_Nx;
+	const uxx z0 = (uxx)xyz.z     *def_Ny*def_Nx;
+	const uxx zp = (uxx)(xyz.z+1u)*def_Ny*def_Nx;
+	j[0] = x0+y0+z0; // 000
 	j[1] = xp+y0+z0; // +00
 	j[2] = xp+y0+zp; // +0+
 	j[3] = x0+y0+zp; // 00+
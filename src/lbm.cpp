@@ -1,6 +1,7 @@
 #include <fx3d/lbm.hpp>
 #include <fx3d/settings.hpp>
 #include <filesystem>
+#include <cstring>
 
 #include <sstream>
 
@@ -27,8 +28,12 @@ uint fx3d::bytes_per_cell_device() { // returns the number of Bytes per cell all
 		bytes_per_cell += 12u; // F
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 		bytes_per_cell += 12u; // phi, mass, flags
+	if (Settings::IsFeatureEnabled(Feature::MOVING_BOUNDARIES)&&Settings::GetNeighborMasks())
+		bytes_per_cell += 4u; // neighbor_masks
 	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
 		bytes_per_cell += 7u*sizeof(fpxx)+4u; // gi, T
+	if (Settings::GetTemporalBlocking()>1u&&!Settings::IsFeatureEnabled((Feature)((int)Feature::FORCE_FIELD | (int)Feature::SURFACE | (int)Feature::TEMPERATURE | (int)Feature::PARTICLES)))
+		bytes_per_cell += Settings::GetVSetSize()*sizeof(fpxx); // fi_next, counted whenever temporal blocking is possible, as the device and number of domains are not known here
 	return bytes_per_cell;
 }
 uint fx3d::bandwidth_bytes_per_cell_device() { // returns the bandwidth in Bytes per cell per time step from/to device memory
@@ -37,14 +42,76 @@ uint fx3d::bandwidth_bytes_per_cell_device() { // returns the bandwidth in Bytes
 		bandwidth_bytes_per_cell += 16u; // rho, u
 	if (Settings::IsFeatureEnabled(Feature::FORCE_FIELD))
 		bandwidth_bytes_per_cell += 12u; // F
-	if (Settings::IsFeatureEnabled((Feature)((int)Feature::MOVING_BOUNDARIES | (int)Feature::SURFACE | (int)Feature::TEMPERATURE)))
-		bandwidth_bytes_per_cell += (Settings::GetVSetSize()-1u)*1u; // neighbor flags have to be loaded
+	if (Settings::IsFeatureEnabled((Feature)((int)Feature::SURFACE | (int)Feature::TEMPERATURE))||(Settings::IsFeatureEnabled(Feature::MOVING_BOUNDARIES)&&!Settings::GetNeighborMasks()))
+		bandwidth_bytes_per_cell += (Settings::GetVSetSize()-1u)*1u; // neighbor flags have to be loaded, with neighbor masks moving boundaries only read one word at lattice points next to moving solids
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 		bandwidth_bytes_per_cell += (1u+(2u*Settings::GetVSetSize()-1u)*sizeof(fpxx)+8u+(Settings::GetVSetSize()-1u)*4u) + 1u + 1u + (4u+Settings::GetVSetSize()+4u+4u+4u); // surface_0 (flags, fi, mass, massex), surface_1 (flags), surface_2 (flags), surface_3 (rho, flags, mass, massex, phi)
 	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
 		bandwidth_bytes_per_cell += 7u*2u*sizeof(fpxx)+4u; // 2*gi, T
 	return bandwidth_bytes_per_cell;
 }
+uint fx3d::halo_width() { // returns the number of halo layers on every side of a domain in split directions
+	const uint period = Settings::GetHaloExchangePeriod();
+	return period>1u ? period+1u : 1u; // Esoteric-Pull needs one extra layer, as the outermost halo layer can't be streamed
+}
+uint transfer_bytes_fi() { // Bytes per domain boundary cell for the fi halo transfer
+	const uint W = halo_width();
+	const uint slots = Settings::GetVSetTransfer()+(W>1u ? W*Settings::GetVSetSize() : 0u); // DDFs crossing the domain boundary, plus all DDFs of the wide halo layers
+#if !defined(FP16S)&&!defined(FP16C)
+	if(Settings::GetHaloCompression()==HaloCompression::HALO_FP16_DDF) return slots*2u; // FP32 DDFs are packed into scaled FP16
+#endif // !FP16S&&!FP16C
+	return slots*(uint)sizeof(fpxx);
+}
+uint transfer_bytes_rho_u_flags() { // Bytes per domain boundary cell for the rho/u/flags halo transfer
+	return halo_width()*(Settings::GetHaloCompression()!=HaloCompression::HALO_NONE ? 9u : 17u); // 4x FP16 + flags, or 4x FP32 + flags, for every halo layer
+}
+uint transfer_bytes_max() { // Bytes per domain boundary cell of the largest halo transfer, the transfer buffers are shared by all fields
+	return max(max(transfer_bytes_fi(), transfer_bytes_rho_u_flags()), 17u); // 17 Bytes also cover flags, phi/massex/flags and gi
+}
+uint fx3d::transfer_bytes_per_cell() { // returns the number of Bytes per domain boundary cell transferred between domains in every time step
+	uint transfer_bytes_per_cell = transfer_bytes_fi(); // fi, rho/u/flags are only exchanged on demand
+	if (Settings::IsFeatureEnabled(Feature::SURFACE))
+		transfer_bytes_per_cell += transfer_bytes_rho_u_flags()+1u+1u+9u; // rho, u, flags, flags, flags, phi, massex, flags
+	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
+		transfer_bytes_per_cell += sizeof(fpxx); // gi
+	const uint period = Settings::GetHaloExchangePeriod();
+	return (transfer_bytes_per_cell+period-1u)/period; // wide halos are only exchanged every period time steps
+}
+ulong halo_transfer_bytes(const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz) { // Bytes transferred between all domains in every time step, for domains with (local) size Nx*Ny*Nz without halo
+	const uint W = halo_width();
+	const ulong Lx=(ulong)(Nx+2u*(Dx>1u)*W), Ly=(ulong)(Ny+2u*(Dy>1u)*W), Lz=(ulong)(Nz+2u*(Dz>1u)*W); // domain size with halo
+	ulong area = 0ull; // domain side area of communicated directions, same as LBM_Domain::get_area()
+	if(Dx>1u) area += Ly*Lz;
+	if(Dy>1u) area += Lz*Lx;
+	if(Dz>1u) area += Lx*Ly;
+	return (ulong)(Dx*Dy*Dz)*2ull*area*(ulong)transfer_bytes_per_cell(); // every domain sends both of its sides in every communicated direction
+}
+uint3 fx3d::decompose_domains(const uint Nx, const uint Ny, const uint Nz, const uint D, const uint memory) { // returns domains (Dx, Dy, Dz) with Dx*Dy*Dz=D that minimize halo transfer, domains have to fit into memory (in MB)
+	const bool uniform = Settings::GetDomainBalancing()==DomainBalancing::UNIFORM; // equal domain sizes, resolution is truncated if not divisible
+	uint3 best(D, 1u, 1u);
+	bool best_fits=false, best_exact=false;
+	ulong best_bytes = max_ulong;
+	const uint W = halo_width();
+	for(uint Dx=1u; Dx<=D; Dx++) {
+		if(D%Dx!=0u) continue;
+		for(uint Dy=1u; Dy<=D/Dx; Dy++) {
+			if((D/Dx)%Dy!=0u) continue;
+			const uint Dz = D/(Dx*Dy);
+			if(Dx>Nx||Dy>Ny||Dz>Nz) continue; // every domain needs at least one lattice point
+			const uint Lx=uniform ? Nx/Dx : (Nx+Dx-1u)/Dx, Ly=uniform ? Ny/Dy : (Ny+Dy-1u)/Dy, Lz=uniform ? Nz/Dz : (Nz+Dz-1u)/Dz; // size of the largest domain
+			const bool fits = (ulong)(Lx+2u*(Dx>1u)*W)*(ulong)(Ly+2u*(Dy>1u)*W)*(ulong)(Lz+2u*(Dz>1u)*W)*(ulong)bytes_per_cell_device()/1048576ull<=(ulong)memory;
+			const bool exact = !uniform||(Nx%Dx==0u&&Ny%Dy==0u&&Nz%Dz==0u); // resolution does not have to be truncated
+			const ulong bytes = halo_transfer_bytes(Lx, Ly, Lz, Dx, Dy, Dz);
+			if(fits!=best_fits ? fits : exact!=best_exact ? exact : bytes<best_bytes) { // prefer fitting into memory, then no truncation, then least halo transfer
+				best = uint3(Dx, Dy, Dz);
+				best_fits = fits;
+				best_exact = exact;
+				best_bytes = bytes;
+			}
+		}
+	}
+	return best;
+}
 uint3 fx3d::resolution(const float3 box_aspect_ratio, const uint memory) { // input: simulation box aspect ratio and VRAM occupation in MB, output: grid resolution
 	float memory_required = (box_aspect_ratio.x*box_aspect_ratio.y*box_aspect_ratio.z)*(float)bytes_per_cell_device()/1048576.0f; // in MB
 	float scaling = cbrt((float)memory/memory_required);
@@ -70,16 +137,26 @@ string fx3d::default_filename(const string& name, const string& extension, const
 
 
 
-LBM_Domain::LBM_Domain(const Device_Info& device_info, const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz, const int Ox, const int Oy, const int Oz, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho) { // constructor with manual device selection and domain offset
+LBM_Domain::LBM_Domain(const Device_Info& device_info, const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz, const int Ox, const int Oy, const int Oz, const uint Gx, const uint Gy, const uint Gz, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho, const LBM_Domain* resident, const LBM_Domain* first_slab) { // constructor with manual device selection and domain offset
 	this->Nx = Nx; this->Ny = Ny; this->Nz = Nz;
 	this->Dx = Dx; this->Dy = Dy; this->Dz = Dz;
 	this->Ox = Ox; this->Oy = Oy; this->Oz = Oz;
+	this->Gx = Gx; this->Gy = Gy; this->Gz = Gz;
 	this->nu = nu;
 	this->fx = fx; this->fy = fy; this->fz = fz;
 	this->sigma = sigma;
 	this->alpha = alpha; this->beta = beta;
 	this->particles_N = particles_N;
 	this->particles_rho = particles_rho;
+	this->resident = resident;
+	program_shift_z = first_slab!=nullptr ? Oz-first_slab->Oz : 0;
+	out_of_core = Settings::GetOutOfCore()&&get_D()>1u;
+	vector_width = stream_collide_vector_width(device_info);
+	boundary_lists = use_boundary_lists(device_info)&&!out_of_core; // out-of-core, the lists and masks of all slabs would have to stay in device memory at once
+	neighbor_masks = Settings::GetNeighborMasks()&&Settings::IsFeatureEnabled(Feature::MOVING_BOUNDARIES)&&!device_info.is_native&&!out_of_core; // the native backend reads neighbor flags within its own cell blocks
+	surface_tiles = Settings::IsFeatureEnabled(Feature::SURFACE)&&!device_info.is_cpu; // local memory is cached global memory on CPUs, staging only adds copies there
+	fi_group = ddf_group(device_info, Settings::GetVSetSize());
+	gi_group = ddf_group(device_info, 7u);
 	string opencl_c_code;
 #ifdef GRAPHICS
 	graphics = Graphics(this);
@@ -87,22 +164,36 @@ LBM_Domain::LBM_Domain(const Device_Info& device_info, const uint Nx, const uint
 #else // GRAPHICS
 	opencl_c_code = device_defines()+get_opencl_c_code();
 #endif // GRAPHICS
-	this->device = Device(device_info, opencl_c_code);
+	if(first_slab!=nullptr) this->device = Device(device_info, first_slab->device); // out-of-core slabs only differ in their z-offset, which is compensated with program_shift_z, so the program is compiled only once
+	else this->device = Device(device_info, opencl_c_code);
 	allocate(device); // lbm first
 #ifdef GRAPHICS
 	graphics.allocate(device); // graphics after lbm
 #endif // GRAPHICS
 }
 
+void add_ddf_buffers(Kernel& kernel, vector<Memory<fpxx>>& f_split) { // link buffers 1, 2, ... of a split DDF field as further kernel parameters
+	for(uint b=0u; b<(uint)f_split.size(); b++) kernel.add_parameters(f_split[b]);
+}
+
 void LBM_Domain::allocate(Device& device) {
 	const ulong N = get_N();
-	fi = Memory<fpxx>(device, N, Settings::GetVSetSize(), false);
-	rho = Memory<float>(device, N, 1u, true, true, 1.0f);
-	u = Memory<float>(device, N, 3u);
-	flags = Memory<uchar>(device, N);
+	const bool own = resident==nullptr; // out-of-core slabs beyond the resident ones don't allocate device memory for the state fields
+	allocate_ddfs(device, fi, fi_split, Settings::GetVSetSize(), fi_group);
+	rho = Memory<float>(device, N, 1u, true, own, 1.0f);
+	u = Memory<float>(device, N, 3u, true, own);
+	flags = Memory<uchar>(device, N, 1u, true, own);
+	if(!own) { // share the device buffers before kernels link them
+		fi.share_device_buffer(resident->fi);
+		for(uint b=0u; b<(uint)fi_split.size(); b++) fi_split[b].share_device_buffer(resident->fi_split[b]);
+		rho.share_device_buffer(resident->rho);
+		u.share_device_buffer(resident->u);
+		flags.share_device_buffer(resident->flags);
+	}
 	kernel_initialize = Kernel(device, N, "initialize", fi, rho, u, flags);
-	kernel_stream_collide = Kernel(device, N, "stream_collide", fi, rho, u, flags, t, fx, fy, fz);
-	kernel_update_fields = Kernel(device, N, "update_fields", fi, rho, u, flags, t, fx, fy, fz);
+	if(vector_width>1u) kernel_stream_collide = Kernel(device, uint3((Nx+vector_width-1u)/vector_width, Ny, Nz), "stream_collide_vectorized", fi, rho, u, flags, t, fx, fy, fz); // one work-item per row segment
+	else kernel_stream_collide = Kernel(device, uint3(Nx, Ny, Nz), "stream_collide", fi, rho, u, flags, t, fx, fy, fz);
+	kernel_update_fields = Kernel(device, uint3(Nx, Ny, Nz), "update_fields", fi, rho, u, flags, t, fx, fy, fz);
 
 	if (Settings::IsFeatureEnabled(Feature::FORCE_FIELD))
 	{
@@ -115,6 +206,11 @@ void LBM_Domain::allocate(Device& device) {
 
 	if (Settings::IsFeatureEnabled(Feature::MOVING_BOUNDARIES))
 		kernel_update_moving_boundaries = Kernel(device, N, "update_moving_boundaries", u, flags);
+	if(neighbor_masks) {
+		solid_neighbors = Memory<uint>(device, N, 1u, false);
+		kernel_stream_collide.add_parameters(solid_neighbors);
+		kernel_update_neighbor_masks = Kernel(device, uint3(Nx, Ny, Nz), "update_neighbor_masks", flags, solid_neighbors);
+	}
 
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 	{
@@ -123,19 +219,33 @@ void LBM_Domain::allocate(Device& device) {
 		massex = Memory<float>(device, N, 1u, false);
 		kernel_initialize.add_parameters(mass, massex, phi);
 		kernel_stream_collide.add_parameters(mass);
-		kernel_surface_0 = Kernel(device, N, "surface_0", fi, rho, u, flags, mass, massex, phi, t, fx, fy, fz);
-		kernel_surface_1 = Kernel(device, N, "surface_1", flags);
-		kernel_surface_2 = Kernel(device, N, "surface_2", fi, rho, u, flags, t);
+		if(surface_tiles) kernel_surface_0 = Kernel(device, uint3(Nx, Ny, Nz), "surface_0", fi, rho, u, flags, mass, massex, phi, t, fx, fy, fz); // the workgroup shape has to match the local memory tile
+		else kernel_surface_0 = Kernel(device, N, "surface_0", fi, rho, u, flags, mass, massex, phi, t, fx, fy, fz);
 		kernel_surface_3 = Kernel(device, N, "surface_3", rho, flags, mass, massex, phi);
+		if(surface_worklist()) {
+			const ulong capacity = surface_list_capacity();
+			surface_list = Memory<uint>(device, capacity, index_words(), false);
+			surface_count = Memory<uint>(device, 2ull); // list entries from stream_collide and from surface_1, surface_1 decides on overflow with the count of stream_collide alone
+			kernel_stream_collide.add_parameters(surface_list, surface_count);
+			kernel_surface_1 = Kernel(device, capacity, "surface_1", flags, surface_list, surface_count); // one work-item per list entry
+			kernel_surface_2 = Kernel(device, capacity, "surface_2", fi, rho, u, flags, t, surface_list, surface_count);
+			kernel_surface_3.add_parameters(surface_count);
+		} else {
+			kernel_surface_1 = Kernel(device, N, "surface_1", flags);
+			kernel_surface_2 = Kernel(device, N, "surface_2", fi, rho, u, flags, t);
+		}
 	}
 
 	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
 	{
-		gi = Memory<fpxx>(device, N, 7u, false);
+		allocate_ddfs(device, gi, gi_split, 7u, gi_group);
 		T = Memory<float>(device, N, 1u, true, true, 1.0f);
 		kernel_initialize.add_parameters(gi, T);
 		kernel_stream_collide.add_parameters(gi, T);
 		kernel_update_fields.add_parameters(gi, T);
+		add_ddf_buffers(kernel_initialize, gi_split);
+		add_ddf_buffers(kernel_stream_collide, gi_split);
+		add_ddf_buffers(kernel_update_fields, gi_split);
 	}
 
 	if (Settings::IsFeatureEnabled(Feature::PARTICLES))
@@ -146,14 +256,98 @@ void LBM_Domain::allocate(Device& device) {
 			kernel_integrate_particles.add_parameters(F, fx, fy, fz);
 	}
 
+	if(temporal_blocking()) {
+		const uint tile = 32u; // tile edge length, a tile with a margin of a few layers in FP16 takes about 2 MB, so it stays in L2/L3 cache during a temporal block
+		const ulong tiles = (ulong)((Nx+tile-1u)/tile)*(ulong)((Ny+tile-1u)/tile)*(ulong)((Nz+tile-1u)/tile);
+		fi_next = Memory<fpxx>(device, N, Settings::GetVSetSize(), false);
+		kernel_stream_collide_tiles = Kernel(device, tiles, "stream_collide_tiles", fi, fi_next, rho, u, flags, t, fx, fy, fz, Settings::GetTemporalBlocking(), tile);
+	}
+
+	if(Settings::GetRepartitionPeriod()>0u&&get_D()>1u&&!out_of_core) {
+		active_cells = Memory<uint>(device, (ulong)(Nx+Ny+Nz));
+		kernel_count_active_cells = Kernel(device, N, "count_active_cells", flags, active_cells);
+	}
+
+	if(boundary_lists) {
+		boundary_list = Memory<uint>(device, 1ull, index_words(), false); // grows in update_boundary_list() when the boundary lattice points are known
+		boundary_count = Memory<uint>(device, 1ull);
+		kernel_list_boundary_cells = Kernel(device, uint3(Nx, Ny, Nz), "list_boundary_cells", flags, boundary_list, boundary_count, 1u);
+		kernel_stream_collide_boundaries = Kernel(device, 1ull, "stream_collide_boundaries", boundary_list, fi, rho, u, flags, t, fx, fy, fz);
+		if(Settings::IsFeatureEnabled(Feature::FORCE_FIELD)) kernel_stream_collide_boundaries.add_parameters(F);
+		if(neighbor_masks) kernel_stream_collide_boundaries.add_parameters(solid_neighbors);
+		if(Settings::IsFeatureEnabled(Feature::SURFACE)) kernel_stream_collide_boundaries.add_parameters(mass);
+		if(surface_worklist()) kernel_stream_collide_boundaries.add_parameters(surface_list, surface_count);
+		if(Settings::IsFeatureEnabled(Feature::TEMPERATURE)) add_ddf_buffers(kernel_stream_collide_boundaries.add_parameters(gi, T), gi_split);
+	}
+
+	if(!fi_split.empty()) { // further DDF buffers are always the last kernel parameters, so the parameter positions in set_parameters() are the same with and without split DDFs
+		add_ddf_buffers(kernel_initialize, fi_split);
+		add_ddf_buffers(kernel_stream_collide, fi_split);
+		add_ddf_buffers(kernel_update_fields, fi_split);
+		if(Settings::IsFeatureEnabled(Feature::FORCE_FIELD)) add_ddf_buffers(kernel_calculate_force_on_boundaries, fi_split);
+		if(Settings::IsFeatureEnabled(Feature::SURFACE)) {
+			add_ddf_buffers(kernel_surface_0, fi_split);
+			add_ddf_buffers(kernel_surface_2, fi_split);
+		}
+		if(boundary_lists) add_ddf_buffers(kernel_stream_collide_boundaries, fi_split);
+	}
+
 	if(get_D()>1u) allocate_transfer(device);
 }
 
 void LBM_Domain::enqueue_initialize() { // call kernel_initialize
 	kernel_initialize.enqueue_run();
+	invalidate_flags(); // flags have just been written to device memory
 }
 void LBM_Domain::enqueue_stream_collide() { // call kernel_stream_collide to perform one LBM time step
+	if(neighbor_masks&&neighbor_masks_stale) update_neighbor_masks();
+	if(boundary_lists&&boundary_list_stale) update_boundary_list();
 	kernel_stream_collide.set_parameters(4u, t, fx, fy, fz).enqueue_run();
+	if(boundary_lists&&boundary_count[0]>0u) kernel_stream_collide_boundaries.set_parameters(5u, t, fx, fy, fz).enqueue_run(); // same time step, with Esoteric-Pull every lattice point only touches its own DDF slots, so the order of both kernels does not matter
+}
+bool LBM_Domain::use_boundary_lists(const Device_Info& device_info) const { // boundary lattice points are kept in a list and stream_collide skips their branches, only for the scalar OpenCL kernel
+	return Settings::GetBoundaryLists()&&!device_info.is_native&&vector_width==1u&&Settings::IsFeatureEnabled((Feature)((int)Feature::EQUILIBRIUM_BOUNDARIES | (int)Feature::MOVING_BOUNDARIES | (int)Feature::TEMPERATURE));
+}
+void LBM_Domain::update_boundary_list() { // collect the lattice points that need boundary branches into boundary_list, grow the list if they don't fit
+	boundary_count.reset(0u);
+	kernel_list_boundary_cells.set_parameters(1u, boundary_list, boundary_count, (uint)boundary_list.length()).enqueue_run();
+	boundary_count.read_from_device();
+	if((ulong)boundary_count[0]>boundary_list.length()) { // list is incomplete, allocate with some headroom for growing boundaries and run again
+		boundary_list = Memory<uint>(device, (ulong)boundary_count[0]+(ulong)boundary_count[0]/4ull, index_words(), false);
+		boundary_count.reset(0u);
+		kernel_list_boundary_cells.set_parameters(1u, boundary_list, boundary_count, (uint)boundary_list.length()).enqueue_run();
+		kernel_stream_collide_boundaries.set_parameters(0u, boundary_list);
+	}
+	if(boundary_count[0]>0u) kernel_stream_collide_boundaries.set_ranges((ulong)boundary_count[0]);
+	boundary_list_stale = false;
+}
+bool LBM_Domain::surface_worklist() const { // surface_1 and surface_2 only visit lattice points with flag changes, which stream_collide and surface_1 append to surface_list, only for a single domain as flag changes in the halo come from other domains
+	return Settings::IsFeatureEnabled(Feature::SURFACE)&&get_D()==1u;
+}
+uint LBM_Domain::surface_list_capacity() const { // flag changes per time step are a small part of the interface, the largest domain side is plenty, surface_1 and surface_2 scan the whole lattice if the list overflows
+	return max(max(Nx*Ny, Ny*Nz), Nz*Nx);
+}
+void LBM_Domain::invalidate_boundary_list() { // flags have changed in device memory, the boundary list is rebuilt before the next time step
+	boundary_list_stale = true;
+}
+void LBM_Domain::update_neighbor_masks() { // mark solid neighbors of every lattice point in solid_neighbors
+	kernel_update_neighbor_masks.enqueue_run();
+	neighbor_masks_stale = false;
+}
+void LBM_Domain::invalidate_flags() { // flags including solids may have changed in device memory, the boundary list and neighbor masks are rebuilt before the next time step
+	boundary_list_stale = true;
+	neighbor_masks_stale = true;
+}
+bool LBM_Domain::temporal_blocking() const { // the domain can advance several time steps in one pass over the lattice
+	return Settings::GetTemporalBlocking()>1u&&Settings::GetTemporalBlocking()+1u<=min(min(Nx, Ny), Nz)/2u&&get_D()==1u&&device.info.is_native&&!Settings::IsFeatureEnabled((Feature)((int)Feature::FORCE_FIELD | (int)Feature::SURFACE | (int)Feature::TEMPERATURE | (int)Feature::PARTICLES));
+}
+void LBM_Domain::enqueue_stream_collide_tiles(const uint steps) { // call kernel_stream_collide_tiles to perform steps LBM time steps at once
+	kernel_stream_collide_tiles.set_parameters(5u, t, fx, fy, fz, steps).enqueue_run(); // tiles write to fi_next, as they can only write to fi after all of them have read their margin
+	fi.swap_device_buffer(fi_next); // the new DDFs become fi without a copy, and the old fi is the target of the next temporal block
+	kernel_initialize.set_parameters(0u, fi); // temporal blocking is only for a single domain on the native backend, so there are no transfer, force or surface kernels with fi
+	kernel_stream_collide.set_parameters(0u, fi);
+	kernel_update_fields.set_parameters(0u, fi);
+	kernel_stream_collide_tiles.set_parameters(0u, fi, fi_next);
 }
 void LBM_Domain::enqueue_update_fields() { // update fields (rho, u, T) manually
 	if (Settings::IsFeatureEnabled(Feature::UPDATE_FIELDS))
@@ -185,6 +379,7 @@ void LBM_Domain::enqueue_calculate_force_on_boundaries() { // calculate forces f
 // #ifdef MOVING_BOUNDARIES
 void LBM_Domain::enqueue_update_moving_boundaries() { // mark/unmark nodes next to TYPE_S nodes with velocity!=0 with TYPE_MS
 	kernel_update_moving_boundaries.enqueue_run();
+	boundary_list_stale = true;
 }
 // #endif // MOVING_BOUNDARIES
 // #ifdef PARTICLES
@@ -198,6 +393,146 @@ void LBM_Domain::enqueue_integrate_particles(const uint time_step_multiplicator)
 }
 // #endif // PARTICLES
 
+void LBM_Domain::enqueue_count_active_cells() { // count active nodes in every x/y/z plane and read the counts into active_cells
+	active_cells.reset(0u);
+	kernel_count_active_cells.enqueue_run();
+	active_cells.enqueue_read_from_device();
+}
+
+template<typename Function> void LBM_Domain::for_each_state_field(Function function) { // call function(memory, device_only, ddf, first, dimensions) for every field that makes up the simulation state, always in the same order
+	const auto ddfs = [&](Memory<fpxx>& f, vector<Memory<fpxx>>& f_split, const uint q) { // split DDF fields are passed buffer by buffer, but make up one state field
+		function(f, !out_of_core, true, 0u, q); // out-of-core, the DDFs also have host buffers
+		uint first = f.dimensions();
+		for(uint b=0u; b<(uint)f_split.size(); b++) {
+			function(f_split[b], !out_of_core, true, first, q);
+			first += f_split[b].dimensions();
+		}
+	};
+	ddfs(fi, fi_split, Settings::GetVSetSize());
+	function(rho, false, false, 0u, rho.dimensions());
+	function(u, false, false, 0u, u.dimensions());
+	function(flags, false, false, 0u, flags.dimensions());
+	if(Settings::IsFeatureEnabled(Feature::FORCE_FIELD)) {
+		function(F, false, false, 0u, F.dimensions());
+	}
+	if(Settings::IsFeatureEnabled(Feature::SURFACE)) {
+		function(mass, true, false, 0u, mass.dimensions());
+		function(massex, true, false, 0u, massex.dimensions());
+		function(phi, false, false, 0u, phi.dimensions());
+	}
+	if(Settings::IsFeatureEnabled(Feature::TEMPERATURE)) {
+		ddfs(gi, gi_split, 7u);
+		function(T, false, false, 0u, T.dimensions());
+	}
+}
+uint LBM_Domain::ddf_group(const Device_Info& device_info, const uint q) const { // DDF directions per device buffer for a DDF field with q directions, fields above the maximum buffer size of the device are split into several buffers
+	if(device_info.is_native||device_info.intel_gpu_above_4gb_patch) return q; // no buffer size limit
+	const ulong direction_bytes = get_N()*(ulong)sizeof(fpxx), max_bytes = (ulong)device_info.max_global_buffer*1048576ull;
+	for(uint buffers=1u; buffers<q; buffers++) {
+		const uint group = (q+buffers-1u)/buffers;
+		if((ulong)group*direction_bytes<=max_bytes) return group; // as few buffers as possible
+	}
+	return 1u; // one direction per buffer, allocation still fails if a single direction exceeds the maximum buffer size
+}
+void LBM_Domain::allocate_ddfs(Device& device, Memory<fpxx>& f, vector<Memory<fpxx>>& f_split, const uint q, const uint group) { // allocate a DDF field with q directions as buffer 0 in f and the remaining buffers in f_split
+	const uint buffers = (q+group-1u)/group; // the last buffer holds the remaining q-(buffers-1)*group directions
+	const bool own = resident==nullptr; // out-of-core, the DDFs live in host memory and only resident slabs own device buffers
+	f = Memory<fpxx>(device, get_N(), min(group, q), out_of_core, own);
+	f_split = vector<Memory<fpxx>>(buffers-1u);
+	for(uint b=1u; b<buffers; b++) f_split[b-1u] = Memory<fpxx>(device, get_N(), min(group, q-b*group), out_of_core, own);
+	if(buffers>1u) print_info("DDFs with "+to_string(q)+" directions are split into "+to_string(buffers)+" buffers to stay below the maximum buffer size of "+to_string(device.info.max_global_buffer)+" MB.");
+}
+bool LBM_Domain::ddf_tiled() const { // DDFs are stored in tiles (DDF_BRICK layout or ORDER_MORTON ordering), rows of lattice points are not contiguous
+	return Settings::GetDDFLayout()==DDFLayout::DDF_BRICK||Settings::GetDDFOrdering()==DDFOrdering::ORDER_MORTON;
+}
+uint LBM_Domain::stream_collide_vector_width(const Device_Info& device_info) const { // lattice points per work-item in stream_collide, rows are split into vector-wide segments on OpenCL CPU devices
+	if(!device_info.is_cpu||device_info.is_native||ddf_tiled()||Settings::IsFeatureEnabled((Feature)((int)Feature::SURFACE | (int)Feature::TEMPERATURE))) return 1u; // GPUs vectorize across work-items, tiled DDFs have no contiguous rows
+	const uint V = device_info.is_fp32_capable>=16u ? 16u : 8u; // float16 with AVX-512, float8 otherwise
+	return Nx>=V+2u ? V : 1u; // segments at the row ends are computed lane by lane, so rows need to be longer than one vector
+}
+uint3 LBM_Domain::brick_size() const { // lattice points per DDF brick/tile in x/y/z
+	const auto edge = [](const uint N) { return N%4u==0u ? 4u : N%2u==0u ? 2u : 1u; }; // 4x4x4 bricks, shorter edges where the domain size is not divisible by 4
+	return uint3(edge(Nx), edge(Ny), edge(Nz));
+}
+ulong LBM_Domain::index_ddf(const ulong n, const uint i, const uint q) const { // host version of index_f()/index_g() in kernel.cpp for DDF fields with q directions
+	if(!ddf_tiled()) return (ulong)i*get_N()+n; // SoA
+	const uint3 B = brick_size();
+	const uint x=(uint)(n%(ulong)Nx), y=(uint)((n/(ulong)Nx)%(ulong)Ny), z=(uint)(n/((ulong)Nx*(ulong)Ny));
+	const ulong brick = (ulong)(x/B.x)+((ulong)(y/B.y)+(ulong)(z/B.z)*(ulong)(Ny/B.y))*(ulong)(Nx/B.x);
+	ulong cell = (ulong)(x%B.x)+((ulong)(y%B.y)+(ulong)(z%B.z)*(ulong)B.y)*(ulong)B.x;
+	if(Settings::GetDDFOrdering()==DDFOrdering::ORDER_MORTON) { // interleave coordinate bits within the tile, same as cell_in_tile() in kernel.cpp
+		cell = 0ull;
+		uint k = 0u;
+		for(uint b=1u; b<4u; b<<=1u) {
+			if(b<B.x) cell |= (ulong)((x/b)&1u)<<k++;
+			if(b<B.y) cell |= (ulong)((y/b)&1u)<<k++;
+			if(b<B.z) cell |= (ulong)((z/b)&1u)<<k++;
+		}
+	}
+	if(Settings::GetDDFLayout()==DDFLayout::DDF_BRICK) return (brick*(ulong)q+(ulong)i)*(ulong)(B.x*B.y*B.z)+cell; // AoSoA
+	return (ulong)i*get_N()+brick*(ulong)(B.x*B.y*B.z)+cell; // SoA, lattice points reordered tile by tile
+}
+void LBM_Domain::gather_state(vector<vector<char>>& state) { // copy interior nodes of all fields, including device-only DDFs and mass, into global host arrays (one array per field)
+	const uint W=halo_width(), Hx=(Dx>1u)*W, Hy=(Dy>1u)*W, Hz=(Dz>1u)*W; // halo offsets
+	const ulong N=get_N(), G=(ulong)Gx*(ulong)Gy*(ulong)Gz;
+	uint field = 0u;
+	for_each_state_field([&](auto& memory, const bool device_only, const bool ddf, const uint first, const uint dimensions) {
+		const ulong bytes = (ulong)sizeof(*memory.data());
+		const bool tiled = ddf&&ddf_tiled(); // DDF rows are not contiguous in tiles, copy them element by element
+		if(device_only) memory.add_host_buffer(); else memory.read_from_device(); // add_host_buffer() also reads from device
+		if(first==0u&&field==(uint)state.size()) state.push_back(vector<char>(G*(ulong)dimensions*bytes));
+		char* global = state[field].data();
+		const char* local = (const char*)memory.data();
+		for(uint z=Hz; z<Nz-Hz; z++) {
+			for(uint y=Hy; y<Ny-Hy; y++) { // interior rows are contiguous in local and global memory
+				const ulong n = (ulong)Hx+((ulong)y+(ulong)z*(ulong)Ny)*(ulong)Nx;
+				const ulong g = (ulong)(Ox+(int)Hx)+((ulong)(Oy+(int)y)+(ulong)(Oz+(int)z)*(ulong)Gy)*(ulong)Gx;
+				for(uint i=0u; i<memory.dimensions(); i++) {
+					if(!tiled) std::memcpy(global+(g+(ulong)(first+i)*G)*bytes, local+(n+(ulong)i*N)*bytes, (ulong)(Nx-2u*Hx)*bytes);
+					else for(uint x=0u; x<Nx-2u*Hx; x++) std::memcpy(global+(g+(ulong)x+(ulong)(first+i)*G)*bytes, local+index_ddf(n+(ulong)x, i, memory.dimensions())*bytes, bytes);
+				}
+			}
+		}
+		if(device_only) memory.delete_host_buffer();
+		if(first+memory.dimensions()==dimensions) field++; // all buffers of a split DDF field are done
+	});
+}
+void LBM_Domain::scatter_state(const vector<vector<char>>& state, const ulong t) { // fill all fields including halo nodes from global host arrays, write them to device and continue at time step t
+	const ulong N=get_N(), G=(ulong)Gx*(ulong)Gy*(ulong)Gz;
+	uint field = 0u;
+	for_each_state_field([&](auto& memory, const bool device_only, const bool ddf, const uint first, const uint dimensions) {
+		const ulong bytes = (ulong)sizeof(*memory.data());
+		const bool tiled = ddf&&ddf_tiled(); // DDF rows are not contiguous in tiles, copy them element by element
+		if(device_only) memory.add_host_buffer();
+		const char* global = state[field].data();
+		char* local = (char*)memory.data();
+		for(uint z=0u; z<Nz; z++) {
+			for(uint y=0u; y<Ny; y++) {
+				const uint gy=(uint)((Oy+(int)y+(int)Gy)%(int)Gy), gz=(uint)((Oz+(int)z+(int)Gz)%(int)Gz); // halo nodes wrap around periodic boundaries
+				uint x = 0u;
+				while(x<Nx) {
+					const uint gx = (uint)((Ox+(int)x+(int)Gx)%(int)Gx);
+					const uint length = min(Nx-x, Gx-gx); // contiguous part of the row up to the periodic wrap
+					const ulong n = (ulong)x+((ulong)y+(ulong)z*(ulong)Ny)*(ulong)Nx;
+					const ulong g = (ulong)gx+((ulong)gy+(ulong)gz*(ulong)Gy)*(ulong)Gx;
+					for(uint i=0u; i<memory.dimensions(); i++) {
+						if(!tiled) std::memcpy(local+(n+(ulong)i*N)*bytes, global+(g+(ulong)(first+i)*G)*bytes, (ulong)length*bytes);
+						else for(uint k=0u; k<length; k++) std::memcpy(local+index_ddf(n+(ulong)k, i, memory.dimensions())*bytes, global+(g+(ulong)k+(ulong)(first+i)*G)*bytes, bytes);
+					}
+					x += length;
+				}
+			}
+		}
+		memory.write_to_device();
+		if(device_only) memory.delete_host_buffer();
+		if(first+memory.dimensions()==dimensions) field++; // all buffers of a split DDF field are done
+	});
+	this->t = t;
+	if (Settings::IsFeatureEnabled(Feature::UPDATE_FIELDS))
+		t_last_update_fields = t;
+	invalidate_flags();
+}
+
 void LBM_Domain::increment_time_step(const uint steps) {
 	t += (ulong)steps; // increment time step
 	if (Settings::IsFeatureEnabled(Feature::UPDATE_FIELDS))
@@ -217,11 +552,24 @@ uint LBM_Domain::get_velocity_set() const {
 }
 
 void LBM_Domain::voxelize_mesh_on_device(const Mesh* mesh, const uchar flag, const float3& rotation_center, const float3& linear_velocity, const float3& rotational_velocity) { // voxelize triangle mesh
-	Memory<float3> p0(device, mesh->triangle_number, 1u, mesh->p0);
-	Memory<float3> p1(device, mesh->triangle_number, 1u, mesh->p1);
-	Memory<float3> p2(device, mesh->triangle_number, 1u, mesh->p2);
+	Memory<float3> p0, p1, p2;
+	const float shift_z = (float)program_shift_z; // out-of-core, the program has the z-offset of the first slab compiled in, so the mesh is moved by the difference instead
+	if(program_shift_z==0) {
+		p0 = Memory<float3>(device, mesh->triangle_number, 1u, mesh->p0);
+		p1 = Memory<float3>(device, mesh->triangle_number, 1u, mesh->p1);
+		p2 = Memory<float3>(device, mesh->triangle_number, 1u, mesh->p2);
+	} else {
+		p0 = Memory<float3>(device, mesh->triangle_number);
+		p1 = Memory<float3>(device, mesh->triangle_number);
+		p2 = Memory<float3>(device, mesh->triangle_number);
+		for(uint i=0u; i<mesh->triangle_number; i++) {
+			p0[i] = mesh->p0[i]-float3(0.0f, 0.0f, shift_z);
+			p1[i] = mesh->p1[i]-float3(0.0f, 0.0f, shift_z);
+			p2[i] = mesh->p2[i]-float3(0.0f, 0.0f, shift_z);
+		}
+	}
 	Memory<float> bounding_box_and_velocity(device, 16u);
-	const float x0=mesh->pmin.x-2.0f, y0=mesh->pmin.y-2.0f, z0=mesh->pmin.z-2.0f, x1=mesh->pmax.x+2.0f, y1=mesh->pmax.y+2.0f, z1=mesh->pmax.z+2.0f; // use bounding box of mesh to speed up voxelization; add tolerance of 2 cells for re-voxelization of moving objects
+	const float x0=mesh->pmin.x-2.0f, y0=mesh->pmin.y-2.0f, z0=mesh->pmin.z-2.0f-shift_z, x1=mesh->pmax.x+2.0f, y1=mesh->pmax.y+2.0f, z1=mesh->pmax.z+2.0f-shift_z; // use bounding box of mesh to speed up voxelization; add tolerance of 2 cells for re-voxelization of moving objects
 	bounding_box_and_velocity[ 0] = as_float(mesh->triangle_number);
 	bounding_box_and_velocity[ 1] = x0;
 	bounding_box_and_velocity[ 2] = y0;
@@ -231,7 +579,7 @@ void LBM_Domain::voxelize_mesh_on_device(const Mesh* mesh, const uchar flag, con
 	bounding_box_and_velocity[ 6] = z1;
 	bounding_box_and_velocity[ 7] = rotation_center.x;
 	bounding_box_and_velocity[ 8] = rotation_center.y;
-	bounding_box_and_velocity[ 9] = rotation_center.z;
+	bounding_box_and_velocity[ 9] = rotation_center.z-shift_z;
 	bounding_box_and_velocity[10] = linear_velocity.x;
 	bounding_box_and_velocity[11] = linear_velocity.y;
 	bounding_box_and_velocity[12] = linear_velocity.z;
@@ -260,16 +608,19 @@ void LBM_Domain::voxelize_mesh_on_device(const Mesh* mesh, const uchar flag, con
 	}
 	const ulong A[3] = { (ulong)Ny*(ulong)Nz, (ulong)Nz*(ulong)Nx, (ulong)Nx*(ulong)Ny };
 	Kernel kernel_voxelize_mesh(device, A[direction], "voxelize_mesh", direction, fi, u, flags, t+1ull, flag, p0, p1, p2, bounding_box_and_velocity);
+	add_ddf_buffers(kernel_voxelize_mesh, fi_split);
 	p0.write_to_device();
 	p1.write_to_device();
 	p2.write_to_device();
 	bounding_box_and_velocity.write_to_device();
 	kernel_voxelize_mesh.run();
+	invalidate_flags();
 }
 void LBM_Domain::enqueue_unvoxelize_mesh_on_device(const Mesh* mesh, const uchar flag) { // remove voxelized triangle mesh from LBM grid
 	const float x0=mesh->pmin.x, y0=mesh->pmin.y, z0=mesh->pmin.z, x1=mesh->pmax.x, y1=mesh->pmax.y, z1=mesh->pmax.z; // remove all flags in bounding box of mesh
 	Kernel kernel_unvoxelize_mesh(device, get_N(), "unvoxelize_mesh", flags, flag, x0, y0, z0, x1, y1, z1);
 	kernel_unvoxelize_mesh.run();
+	invalidate_flags();
 }
 
 string LBM_Domain::device_defines() const {
@@ -279,6 +630,8 @@ string LBM_Domain::device_defines() const {
 	ss << "\n #define def_Ny " << to_string(Ny) << "u";
 	ss << "\n #define def_Nz " << to_string(Nz) << "u";
 	ss << "\n #define def_N " << to_string(get_N()) << "ul";
+	if(index64()) ss << "\n #define INDEX64"; // domain has 2^32 or more lattice points
+	ss << "\n #define uxx " << (index64() ? "ulong" : "uint"); // switchable data type for lattice point indices, 64-bit index arithmetic is only compiled in when the domain needs it
 
 	ss << "\n #define def_Dx " << to_string(Dx) << "u";
 	ss << "\n #define def_Dy " << to_string(Dy) << "u";
@@ -286,15 +639,19 @@ string LBM_Domain::device_defines() const {
 
 	ss << "\n #define def_Ox " << to_string(Ox) << ""; // offsets are signed integer!
 	ss << "\n #define def_Oy " << to_string(Oy) << "";
-	ss << "\n #define def_Oz " << to_string(Oz) << "";
+	ss << "\n #define def_Oz " << to_string(Oz-program_shift_z) << "";
 
 	ss << "\n #define def_Ax " << to_string(Ny*Nz) << "u";
 	ss << "\n #define def_Ay " << to_string(Nz*Nx) << "u";
 	ss << "\n #define def_Az " << to_string(Nx*Ny) << "u";
 
-	ss << "\n #define def_domain_offset_x " << to_string((float)Ox+(float)(Dx>1u)-0.5f*((float)Dx-1.0f)*(float)(Nx-2u*(Dx>1u))) << "f";
-	ss << "\n #define def_domain_offset_y " << to_string((float)Oy+(float)(Dy>1u)-0.5f*((float)Dy-1.0f)*(float)(Ny-2u*(Dy>1u))) << "f";
-	ss << "\n #define def_domain_offset_z " << to_string((float)Oz+(float)(Dz>1u)-0.5f*((float)Dz-1.0f)*(float)(Nz-2u*(Dz>1u))) << "f";
+	ss << "\n #define def_global_Nx " << to_string(Gx) << "u"; // domains can have different sizes, so global dimensions can't be inferred from local dimensions
+	ss << "\n #define def_global_Ny " << to_string(Gy) << "u";
+	ss << "\n #define def_global_Nz " << to_string(Gz) << "u";
+
+	ss << "\n #define def_domain_offset_x " << to_string((float)Ox+0.5f*(float)Nx-0.5f*(float)Gx) << "f"; // distance of domain center from global center
+	ss << "\n #define def_domain_offset_y " << to_string((float)Oy+0.5f*(float)Ny-0.5f*(float)Gy) << "f";
+	ss << "\n #define def_domain_offset_z " << to_string((float)(Oz-program_shift_z)+0.5f*(float)Nz-0.5f*(float)Gz) << "f";
 
 	ss << "\n #define D" << to_string(Settings::GetVSetDims()) << "Q" << to_string(Settings::GetVSetSize()) << ""; // D2Q9/D3Q15/D3Q19/D3Q27
 	ss << "\n #define def_velocity_set " << to_string(Settings::GetVSetSize()) << "u"; // LBM velocity set (D2Q9/D3Q15/D3Q19/D3Q27)
@@ -355,17 +712,72 @@ string LBM_Domain::device_defines() const {
 	ss << "\n #define fpxx_copy ushort"; // switchable data type for direct copying (scaled IEEE-754 16-bit floating-point format: 1-5-10, exp-30, +-1.99902344, +-1.86446416E-9, +-1.81898936E-12, 3.311 digits)
 	ss << "\n #define load(p,o) vload_half(o,p)*3.0517578E-5f"; // special function for loading half
 	ss << "\n #define store(p,o,x) vstore_half_rte((x)*32768.0f,o,p)"; // special function for storing half
+	ss << "\n #define loadV(p,o) (vload_halfV(0,p+o)*3.0517578E-5f)"; // load def_V consecutive halfs
+	ss << "\n #define storeV(p,o,x) vstore_halfV_rte((x)*32768.0f,0,p+o)"; // store def_V consecutive halfs
 #elif defined(FP16C)
 	ss << "\n #define fpxx ushort"; // switchable data type (custom 16-bit floating-point format: 1-4-11, exp-15, +-1.99951168, +-6.10351562E-5, +-2.98023224E-8, 3.612 digits), 12.5% slower than IEEE-754 16-bit
 	ss << "\n #define fpxx_copy ushort"; // switchable data type for direct copying (custom 16-bit floating-point format: 1-4-11, exp-15, +-1.99951168, +-6.10351562E-5, +-2.98023224E-8, 3.612 digits), 12.5% slower than IEEE-754 16-bit
 	ss << "\n #define load(p,o) half_to_float_custom(p[o])"; // special function for loading half
 	ss << "\n #define store(p,o,x) p[o]=float_to_half_custom(x)"; // special function for storing half
+	ss << "\n #define loadV(p,o) load_custom_V(p+o)"; // load def_V consecutive halfs
+	ss << "\n #define storeV(p,o,x) store_custom_V(p+o,x)"; // store def_V consecutive halfs
 #else // FP32
 	ss << "\n #define fpxx float"; // switchable data type (regular 32-bit float)
 	ss << "\n #define fpxx_copy float"; // switchable data type for direct copying (regular 32-bit float)
 	ss << "\n #define load(p,o) p[o]"; // regular float read
 	ss << "\n #define store(p,o,x) p[o]=x"; // regular float write
+	ss << "\n #define loadV(p,o) vloadV(0,p+o)"; // load def_V consecutive floats
+	ss << "\n #define storeV(p,o,x) vstoreV(x,0,p+o)"; // store def_V consecutive floats
+	if(Settings::GetHaloCompression()==HaloCompression::HALO_FP16_DDF) ss << "\n #define HALO_FP16_FI"; // pack FP32 DDFs into scaled FP16 for domain communication, only on explicit request as it is lossy
 #endif // FP32
+	ss << "\n #define fpxx_halo " << (Settings::GetHaloCompression()==HaloCompression::HALO_FP16_DDF ? "ushort" : "fpxx_copy"); // data type of DDFs in transfer buffers, FP16 DDFs are always transferred as they are
+	if(Settings::GetHaloCompression()!=HaloCompression::HALO_NONE) ss << "\n #define HALO_FP16_RHO_U"; // pack rho-1 and u into scaled FP16 for domain communication
+	ss << "\n #define def_halo_width " << to_string(halo_width()) << "u"; // number of halo layers on every side of the domain in split directions
+	ss << "\n #define def_Hx " << to_string((Dx>1u)*halo_width()) << "u";
+	ss << "\n #define def_Hy " << to_string((Dy>1u)*halo_width()) << "u";
+	ss << "\n #define def_Hz " << to_string((Dz>1u)*halo_width()) << "u";
+	if(halo_width()>1u) ss << "\n #define HALO_WIDE"; // inner halo layers are streamed and collided locally, and all their DDFs are exchanged
+	if(ddf_tiled()) {
+		const uint3 B = brick_size();
+		if(Settings::GetDDFLayout()==DDFLayout::DDF_BRICK) ss << "\n #define DDF_BRICK"; // AoSoA: all DDFs of a brick of def_Bx*def_By*def_Bz lattice points are contiguous in memory
+		if(Settings::GetDDFOrdering()==DDFOrdering::ORDER_MORTON) ss << "\n #define DDF_MORTON"; // lattice points within each brick/tile follow a Morton curve
+		ss << "\n #define def_Bx " << to_string(B.x) << "u";
+		ss << "\n #define def_By " << to_string(B.y) << "u";
+		ss << "\n #define def_Bz " << to_string(B.z) << "u";
+	}
+	if(fi_group<Settings::GetVSetSize()) ss << "\n #define DDF_SPLIT"; // DDFs are split across several device buffers fi, fi_1, fi_2, ... of def_fi_group directions each
+	ss << "\n #define ddfs(T, f) ddfs_##f(T)"; // kernel parameters of all buffers of DDF field f
+	ss << "\n #define ddfs_tail(T, f) ddfs_tail_##f(T)"; // kernel parameters of buffers 1, 2, ... of DDF field f, empty if f is not split
+	ss << "\n #define ddfs_pass(f) ddfs_pass_##f"; // pass all buffers of DDF field f on to a function
+	ss << "\n #define ddf(f, i) ddf_##f(i)"; // buffer of DDF field f that holds direction i
+	const string field[2] = { "fi", "gi" };
+	const uint q[2] = { Settings::GetVSetSize(), 7u }, group[2] = { fi_group, gi_group };
+	for(uint k=0u; k<2u; k++) {
+		const uint buffers = (q[k]+group[k]-1u)/group[k];
+		string tail="", pass=field[k], select=field[k]+"_"+to_string(buffers-1u);
+		for(uint b=1u; b<buffers; b++) {
+			tail += ", T "+field[k]+"_"+to_string(b);
+			pass += ", "+field[k]+"_"+to_string(b);
+		}
+		for(uint b=buffers-1u; b>0u; b--) select = "((i)<"+to_string(b*group[k])+"u ? "+(b>1u ? field[k]+"_"+to_string(b-1u) : field[k])+" : "+select+")";
+		if(buffers==1u) select = field[k];
+		ss << "\n #define def_" << field[k] << "_group " << to_string(group[k]) << "u";
+		ss << "\n #define def_" << field[k] << "_buffers " << to_string(buffers) << "u";
+		ss << "\n #define ddfs_" << field[k] << "(T) T " << field[k] << tail;
+		ss << "\n #define ddfs_tail_" << field[k] << "(T)" << tail;
+		ss << "\n #define ddfs_pass_" << field[k] << " " << pass;
+		ss << "\n #define ddf_" << field[k] << "(i) " << select;
+	}
+
+	if(vector_width>1u) { // explicitly vectorized stream_collide for OpenCL CPU devices
+		const string V = to_string(vector_width);
+		ss << "\n #define def_V " << V << "u"; // lattice points per work-item, consecutive along x
+		ss << "\n #define floatV float" << V << "\n #define intV int" << V << "\n #define ucharV uchar" << V;
+		ss << "\n #define vloadV vload" << V << "\n #define vstoreV vstore" << V << "\n #define convert_intV convert_int" << V;
+		ss << "\n #define vload_halfV vload_half" << V << "\n #define vstore_halfV_rte vstore_half" << V << "_rte";
+	}
+	if(boundary_lists) ss << "\n #define BOUNDARY_LISTS"; // stream_collide computes only bulk lattice points, boundary lattice points are computed by stream_collide_boundaries from a list
+	if(neighbor_masks) ss << "\n #define NEIGHBOR_MASKS"; // stream_collide reads solid neighbors of moving boundaries from one 32-bit mask
 
 	if (Settings::IsFeatureEnabled(Feature::UPDATE_FIELDS))
 		ss << "\n #define UPDATE_FIELDS";
@@ -384,6 +796,17 @@ string LBM_Domain::device_defines() const {
 	{
 		ss << "\n #define SURFACE";
 		ss << "\n #define def_6_sigma " << to_string(6.0f*sigma) << "f"; // rho_laplace = 2*o*K, rho = 1-rho_laplace/c^2 = 1-(6*o)*K
+		if(surface_tiles) { // surface_0 stages phi and flags of its workgroup in local memory, same workgroup shape as in Kernel::set_ranges()
+			const uint Lx=min(WORKGROUP_SHAPE.x, Nx)+2u, Ly=min(WORKGROUP_SHAPE.y, Ny)+2u, Lz=min(WORKGROUP_SHAPE.z, Nz)+2u; // one layer of neighbors on every side
+			ss << "\n #define SURFACE_LOCAL";
+			ss << "\n #define def_tile_x " << to_string(Lx) << "u";
+			ss << "\n #define def_tile_y " << to_string(Ly) << "u";
+			ss << "\n #define def_tile_N " << to_string(Lx*Ly*Lz) << "u";
+		}
+		if(surface_worklist()) {
+			ss << "\n #define SURFACE_LIST"; // surface_1 and surface_2 run over a list of lattice points with flag changes
+			ss << "\n #define def_surface_list " << to_string(surface_list_capacity()) << "u"; // capacity of the list
+		}
 	}
 
 	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
@@ -415,9 +838,10 @@ void LBM_Domain::Graphics::allocate(Device& device) {
 	camera_parameters = Memory<float>(device, 15u);
 	kernel_clear = Kernel(device, bitmap.length(), "graphics_clear", bitmap, zbuffer);
 
-	kernel_graphics_flags = Kernel(device, lbm->get_N(), "graphics_flags", lbm->flags, camera_parameters, bitmap, zbuffer);
-	kernel_graphics_flags_mc = Kernel(device, lbm->get_N(), "graphics_flags_mc", lbm->flags, camera_parameters, bitmap, zbuffer);
-	kernel_graphics_field = Kernel(device, lbm->get_N(), "graphics_field", lbm->flags, lbm->u, camera_parameters, bitmap, zbuffer, 0, 0, 0, 0);
+	const uint3 lattice = uint3(lbm->get_Nx(), lbm->get_Ny(), lbm->get_Nz()); // 3D range for kernels over the lattice
+	kernel_graphics_flags = Kernel(device, lattice, "graphics_flags", lbm->flags, camera_parameters, bitmap, zbuffer);
+	kernel_graphics_flags_mc = Kernel(device, lattice, "graphics_flags_mc", lbm->flags, camera_parameters, bitmap, zbuffer);
+	kernel_graphics_field = Kernel(device, lattice, "graphics_field", lbm->flags, lbm->u, camera_parameters, bitmap, zbuffer, 0, 0, 0, 0);
 	if (Settings::GetVelocitySet() == VelocitySet::D2Q9)
 	{
 		kernel_graphics_streamline = Kernel(device, (lbm->get_Nx()/fx3d::GraphicsSettings::GetStreamlineSparse())*(lbm->get_Ny()/fx3d::GraphicsSettings::GetStreamlineSparse()), "graphics_streamline", lbm->flags, lbm->u, camera_parameters, bitmap, zbuffer, 0, 0, 0, 0); // 2D
@@ -426,7 +850,7 @@ void LBM_Domain::Graphics::allocate(Device& device) {
 	{
 		kernel_graphics_streamline = Kernel(device, (lbm->get_Nx()/fx3d::GraphicsSettings::GetStreamlineSparse())*(lbm->get_Ny()/fx3d::GraphicsSettings::GetStreamlineSparse())*(lbm->get_Nz()/fx3d::GraphicsSettings::GetStreamlineSparse()), "graphics_streamline", lbm->flags, lbm->u, camera_parameters, bitmap, zbuffer, 0, 0, 0, 0); // 3D
 	}
-	kernel_graphics_q = Kernel(device, lbm->get_N(), "graphics_q", lbm->flags, lbm->u, camera_parameters, bitmap, zbuffer);
+	kernel_graphics_q = Kernel(device, lattice, "graphics_q", lbm->flags, lbm->u, camera_parameters, bitmap, zbuffer);
 
 	if (Settings::IsFeatureEnabled(Feature::FORCE_FIELD))
 	{
@@ -437,7 +861,7 @@ void LBM_Domain::Graphics::allocate(Device& device) {
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 	{
 		skybox = Memory<int>(device, skybox_image->width()*skybox_image->height(), 1u, skybox_image->data());
-		kernel_graphics_rasterize_phi = Kernel(device, lbm->get_N(), "graphics_rasterize_phi", lbm->phi, camera_parameters, bitmap, zbuffer);
+		kernel_graphics_rasterize_phi = Kernel(device, lattice, "graphics_rasterize_phi", lbm->phi, camera_parameters, bitmap, zbuffer);
 		kernel_graphics_raytrace_phi = Kernel(device, bitmap.length(), "graphics_raytrace_phi", lbm->phi, lbm->flags, fx3d::GraphicsSettings::GetFluidMaterial(), skybox, camera_parameters, bitmap);
 	}
 
@@ -452,7 +876,7 @@ bool LBM_Domain::Graphics::update_camera() {
 	fx3d::GraphicsSettings::GetCamera().update_matrix();
 	bool change = false;
 	for(uint i=0u; i<15u; i++) {
-		const float data = fx3d::GraphicsSettings::GetCamera().data(i);
+		const float data = fx3d::GraphicsSettings::GetCamera().data(i)-(i==4u ? (float)lbm->program_shift_z : 0.0f); // out-of-core, the camera moves instead of the slab, as the program has the z-offset of the first slab compiled in
 		change |= (camera_parameters[i]!=data);
 		camera_parameters[i] = data;
 	}
@@ -541,13 +965,58 @@ string LBM_Domain::Graphics::device_defines() const {
 //#include <ppl.h> // concurrency::parallel_for(0, N, [&](int n) { ... });
 //#include <omp.h> // #pragma omp parallel for \n for(int n=0; n<N; i++) { ... } // #pragma warning(disable:6993)
 
+vector<Device_Info> auto_selectable_devices(const vector<Device_Info>& devices) { // the native CPU backend is only auto-selected if enabled in Settings or if there is no OpenCL device, otherwise it has to be selected by its device ID
+	vector<Device_Info> selectable;
+	for(uint i=0u; i<(uint)devices.size(); i++) if(devices[i].is_native==Settings::GetNativeBackend()) selectable.push_back(devices[i]);
+	if(selectable.size()==0u) selectable = devices;
+	return selectable;
+}
+
+void apply_device_settings(vector<Device_Info>& device_infos) { // devices pretend to have no more memory than Settings::GetDeviceMemoryLimit(), to test memory-dependent decisions like out-of-core runs on devices with more memory, and get the memory arena block size and host memory policy
+	const uint limit = Settings::GetDeviceMemoryLimit(); // in MB
+	const uint nodes = Settings::GetNumaPlacement()&&device_infos.size()>1u&&!Settings::GetParallelFirstTouch() ? get_numa_nodes() : 1u; // a single domain spans all nodes and would be bound to node 0, and parallel first touch already puts pages on the node of the thread that uses them
+	for(uint d=0u; d<(uint)device_infos.size(); d++) {
+		if(limit>0u) {
+			device_infos[d].memory = min(device_infos[d].memory, limit);
+			device_infos[d].max_global_buffer = min(device_infos[d].max_global_buffer, limit);
+		}
+		device_infos[d].arena_block = Settings::GetDeviceArena();
+		device_infos[d].host_policy.huge_pages = (uint)Settings::GetHostPages();
+		if(nodes>1u&&device_infos[d].host_policy.numa_node<0) device_infos[d].host_policy.numa_node = (int)((ulong)d*(ulong)nodes/(ulong)device_infos.size()); // consecutive domains share a socket, like the devices attached to it
+		device_infos[d].host_policy.parallel_touch = Settings::GetParallelFirstTouch();
+	}
+}
+
+void split_numa_devices(vector<Device_Info>& device_infos) { // OpenCL CPU devices that run several domains are split into one sub-device per NUMA node, and these domains are spread over the sub-devices in blocks, so every domain runs on the cores and memory of one socket
+	vector<bool> done(device_infos.size(), false);
+	for(uint d=0u; d<(uint)device_infos.size(); d++) {
+		if(done[d]) continue;
+		vector<uint> domains; // all domains on the same device as domain d
+		for(uint e=d; e<(uint)device_infos.size(); e++) {
+			if(!done[e]&&!device_infos[e].is_native&&device_infos[e].id==device_infos[d].id) {
+				domains.push_back(e);
+				done[e] = true;
+			}
+		}
+		if((uint)domains.size()<2u||!device_infos[d].is_cpu) continue;
+		const vector<Device_Info> sub_devices = get_numa_sub_devices(device_infos[d]);
+		if(sub_devices.size()==0u) {
+			print_warning("Device \""+device_infos[d].name+"\" can't be split by NUMA node. Its "+to_string((uint)domains.size())+" domains share all cores and memory.");
+			continue;
+		}
+		print_info("Splitting device \""+device_infos[d].name+"\" into "+to_string((uint)sub_devices.size())+" NUMA sub-devices for "+to_string((uint)domains.size())+" domains.");
+		for(uint i=0u; i<(uint)domains.size(); i++) device_infos[domains[i]] = sub_devices[(ulong)i*(ulong)sub_devices.size()/(ulong)domains.size()];
+	}
+}
+
 vector<Device_Info> smart_device_selection(const uint D) {
-	const vector<Device_Info>& devices = get_devices(); // a vector of all available OpenCL devices
+	const vector<Device_Info>& all_devices = get_devices(); // a vector of all available OpenCL devices and the native CPU backend
+	const vector<Device_Info> devices = auto_selectable_devices(all_devices);
 	vector<Device_Info> device_infos(D);
 	const int user_specified_devices = (int)main_arguments.size();
 	if(user_specified_devices>0) { // user has selevted specific devices as command line arguments
 		if(user_specified_devices==D) { // as much specified devices as domains
-			for(uint d=0; d<D; d++) device_infos[d] = select_device_with_id(to_uint(main_arguments[d]), devices); // use list of devices IDs specified by user
+			for(uint d=0; d<D; d++) device_infos[d] = select_device_with_id(to_uint(main_arguments[d]), all_devices); // use list of devices IDs specified by user
 		} else {
 			print_warning("Incorrect number of devices specified. Using single fastest device for all domains.");
 			for(uint d=0; d<D; d++) device_infos[d] = select_device_with_most_flops(devices);
@@ -577,15 +1046,137 @@ vector<Device_Info> smart_device_selection(const uint D) {
 		}
 		if(best_j>=0) { // select all devices of fastest device type with at least D devices of the same type
 			for(uint d=0; d<D; d++) device_infos[d] = device_type_ids[best_j][d];
+		} else if(Settings::GetDomainBalancing()!=DomainBalancing::UNIFORM&&(uint)devices.size()>=D) { // domain sizes are weighted by device throughput, so different devices can be combined
+			print_info("Not enough devices of the same type available. Using the "+to_string(D)+" fastest devices with throughput-weighted domain sizes.");
+			vector<Device_Info> devices_sorted = devices;
+			std::stable_sort(devices_sorted.begin(), devices_sorted.end(), [](const Device_Info& a, const Device_Info& b) { return a.tflops>b.tflops; });
+			for(uint d=0; d<D; d++) device_infos[d] = devices_sorted[d];
 		} else {
 			print_warning("Not enough devices of the same type available. Using single fastest device for all domains.");
 			for(uint d=0; d<D; d++) device_infos[d] = select_device_with_most_flops(devices);
 		}
 		//for(uint j=0u; j<(uint)device_type_ids.size(); j++) print_info("Device Type "+to_string(j)+" ("+device_type_ids[j][0].name+"): "+to_string((uint)device_type_ids[j].size())+"x");
 	}
+	if(Settings::GetDeviceFission()) split_numa_devices(device_infos);
+	apply_device_settings(device_infos);
 	return device_infos;
 }
 
+uint3 automatic_domains(const uint Nx, const uint Ny, const uint Nz, uint D) { // choose number of domains and their arrangement, D=0 uses all suitable devices
+	vector<Device_Info> devices = auto_selectable_devices(get_devices(false));
+	if(Settings::GetDeviceFission()) { // every NUMA sub-device counts as a device of its own
+		vector<Device_Info> split_devices;
+		for(uint i=0u; i<(uint)devices.size(); i++) {
+			const vector<Device_Info> sub_devices = get_numa_sub_devices(devices[i]);
+			if(sub_devices.size()>0u) split_devices.insert(split_devices.end(), sub_devices.begin(), sub_devices.end());
+			else split_devices.push_back(devices[i]);
+		}
+		devices = split_devices;
+	}
+	apply_device_settings(devices);
+	std::stable_sort(devices.begin(), devices.end(), [](const Device_Info& a, const Device_Info& b) { return a.tflops>b.tflops; });
+	if(D==0u) { // same device selection as in smart_device_selection()
+		for(uint i=0u; i<(uint)devices.size(); i++) if(Settings::GetDomainBalancing()!=DomainBalancing::UNIFORM||devices[i].name==devices[0].name) D++;
+	}
+	uint memory = max_uint; // in MB, smallest device memory among the devices that will be used
+	for(uint i=0u; i<min(D, (uint)devices.size()); i++) memory = min(memory, devices[i].memory);
+	const uint3 Dxyz = decompose_domains(Nx, Ny, Nz, D, memory);
+	print_info("Automatic domain decomposition: "+to_string(D)+" domains as "+to_string(Dxyz.x)+"x"+to_string(Dxyz.y)+"x"+to_string(Dxyz.z)+".");
+	return Dxyz;
+}
+
+vector<float> domain_weights(const vector<Device_Info>& device_infos) { // returns relative throughput of the device of each domain, used for sizing domains on heterogeneous devices
+	const uint D = (uint)device_infos.size();
+	vector<float> weights(D, 1.0f);
+	if(Settings::GetDomainBalancing()==DomainBalancing::TFLOPS) {
+		for(uint d=0u; d<D; d++) weights[d] = device_infos[d].tflops;
+	} else if(Settings::GetDomainBalancing()==DomainBalancing::BANDWIDTH) {
+		for(uint d=0u; d<D; d++) {
+			int measured = -1;
+			for(uint e=0u; e<d; e++) if(device_infos[e].id==device_infos[d].id) measured = (int)e; // don't benchmark the same device twice
+			if(measured>=0) {
+				weights[d] = weights[measured];
+			} else {
+				weights[d] = measure_memory_bandwidth(device_infos[d]);
+				print_info("Measured memory bandwidth of device "+to_string(device_infos[d].id)+" ("+device_infos[d].name+"): "+to_string(weights[d], 1u)+" GB/s");
+			}
+		}
+	}
+	for(uint d=0u; d<D; d++) {
+		if(!(weights[d]>0.0f)) {
+			print_warning("Throughput of device \""+device_infos[d].name+"\" could not be estimated. Using equal domain sizes.");
+			return vector<float>(D, 1.0f);
+		}
+	}
+	return weights;
+}
+vector<uint> split_domains(const uint N, const vector<float>& weights) { // split N lattice points into slabs with sizes proportional to weights, returns start position of every slab and N at the end
+	const uint D = (uint)weights.size();
+	double sum = 0.0;
+	for(uint d=0u; d<D; d++) sum += (double)weights[d];
+	vector<double> target(D);
+	vector<uint> sizes(D);
+	uint assigned = 0u;
+	for(uint d=0u; d<D; d++) {
+		target[d] = (double)N*(double)weights[d]/sum;
+		sizes[d] = max((uint)target[d], 1u); // every slab needs at least one lattice point
+		assigned += sizes[d];
+	}
+	while(assigned<N) { // hand out remaining lattice points to the slab furthest below its target size
+		uint best_d = 0u;
+		for(uint d=1u; d<D; d++) if(target[d]-(double)sizes[d]>target[best_d]-(double)sizes[best_d]) best_d = d;
+		sizes[best_d]++;
+		assigned++;
+	}
+	while(assigned>N) { // take back lattice points from the slab furthest above its target size
+		int best_d = -1;
+		for(uint d=0u; d<D; d++) if(sizes[d]>1u&&(best_d<0||(double)sizes[d]-target[d]>(double)sizes[best_d]-target[best_d])) best_d = (int)d;
+		if(best_d<0) break; // less lattice points than slabs, is caught in sanity checks
+		sizes[best_d]--;
+		assigned--;
+	}
+	vector<uint> offsets(D+1u, 0u);
+	for(uint d=0u; d<D; d++) offsets[d+1u] = offsets[d]+sizes[d];
+	return offsets;
+}
+vector<uint> split_domains(const vector<double>& cost, const vector<float>& weights) { // split planes into slabs with total cost proportional to weights, returns start position of every slab and the number of planes at the end
+	const uint N=(uint)cost.size(), D=(uint)weights.size();
+	double total_cost=0.0, total_weight=0.0;
+	for(uint i=0u; i<N; i++) total_cost += cost[i];
+	for(uint d=0u; d<D; d++) total_weight += (double)weights[d];
+	vector<uint> offsets(D+1u, 0u);
+	offsets[D] = N;
+	double sum=0.0, weight=0.0; // cost and weight of all slabs so far
+	uint i = 0u;
+	for(uint d=0u; d+1u<D; d++) {
+		weight += (double)weights[d];
+		const double target = total_cost*weight/total_weight; // cumulative cost at the end of slab d
+		while(i<N&&sum+0.5*cost[i]<target) sum += cost[i++]; // add plane i to slab d if more than half of its cost lies below the target
+		const uint offset = min(max(i, offsets[d]+1u), N-(D-1u-d)); // every slab needs at least one plane
+		while(i<offset) sum += cost[i++];
+		while(i>offset) sum -= cost[--i];
+		offsets[d+1u] = offset;
+	}
+	return offsets;
+}
+float split_imbalance(const vector<double>& cost, const vector<uint>& offsets, const vector<float>& weights) { // relative excess time of the slowest slab over a perfectly balanced split
+	const uint D = (uint)weights.size();
+	double total_cost=0.0, total_weight=0.0, worst=0.0;
+	for(uint d=0u; d<D; d++) {
+		double slab_cost = 0.0;
+		for(uint i=offsets[d]; i<offsets[d+1u]; i++) slab_cost += cost[i];
+		worst = fmax(worst, slab_cost/(double)weights[d]);
+		total_cost += slab_cost;
+		total_weight += (double)weights[d];
+	}
+	return total_cost>0.0 ? (float)(worst*total_weight/total_cost-1.0) : 0.0f;
+}
+string print_split(const vector<uint>& offsets) { // list slab sizes, for example "64, 64, 128"
+	string s = "";
+	for(uint i=0u; i+1u<(uint)offsets.size(); i++) s += (i>0u ? ", " : "")+to_string(offsets[i+1u]-offsets[i]);
+	return s;
+}
+
 LBM::LBM(const uint Nx, const uint Ny, const uint Nz, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho) // single device
 	:LBM(Nx, Ny, Nz, 1u, 1u, 1u, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho) { // delegating constructor
 }
@@ -607,80 +1198,181 @@ LBM::LBM(const uint3 N, const float nu, const uint particles_N, const float part
 LBM::LBM(const uint3 N, const float nu, const float fx, const float fy, const float fz, const uint particles_N, const float particles_rho)
 	:LBM(N.x, N.y, N.z, 1u, 1u, 1u, nu, fx, fy, fz, 0.0f, 0.0f, 0.0f, particles_N, particles_rho) { // delegating constructor
 }
+LBM::LBM(const uint Nx, const uint Ny, const uint Nz, const uint D, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho) // automatic domain decomposition
+	:LBM(uint3(Nx, Ny, Nz), automatic_domains(Nx, Ny, Nz, D), nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho) { // delegating constructor
+}
+LBM::LBM(const uint3 N, const uint3 D, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho)
+	:LBM(N.x, N.y, N.z, D.x, D.y, D.z, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho) { // delegating constructor
+}
 LBM::LBM(const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho) { // multiple devices
-	const uint NDx=(Nx/Dx)*Dx, NDy=(Ny/Dy)*Dy, NDz=(Nz/Dz)*Dz; // make resolution equally divisible by domains
+	const bool balanced = Settings::GetDomainBalancing()!=DomainBalancing::UNIFORM&&Dx*Dy*Dz>1u; // domain sizes are weighted by device throughput
+	const uint NDx=balanced ? Nx : (Nx/Dx)*Dx, NDy=balanced ? Ny : (Ny/Dy)*Dy, NDz=balanced ? Nz : (Nz/Dz)*Dz; // make resolution equally divisible by domains
 	if(NDx!=Nx||NDy!=Ny||NDz!=Nz) print_warning("LBM grid ("+to_string(Nx)+"x"+to_string(Ny)+"x"+to_string(Nz)+") is not equally divisible in domains ("+to_string(Dx)+"x"+to_string(Dy)+"x"+to_string(Dz)+"). Changeing resolution to ("+to_string(NDx)+"x"+to_string(NDy)+"x"+to_string(NDz)+").");
 	this->Nx = NDx; this->Ny = NDy; this->Nz = NDz;
 	this->Dx = Dx; this->Dy = Dy; this->Dz = Dz;
 	const uint D = Dx*Dy*Dz;
-	const uint Hx=Dx>1u, Hy=Dy>1u, Hz=Dz>1u; // halo offsets
-	const vector<Device_Info>& device_infos = smart_device_selection(D);
+	const uint W=halo_width(), Hx=(Dx>1u)*W, Hy=(Dy>1u)*W, Hz=(Dz>1u)*W; // halo offsets
+	transport = create_transport(); // nullptr if all domains run in this process
+	D0 = 0u; D1 = D;
+	if(transport!=nullptr) {
+		const uint rank=transport->get_rank(), P=transport->get_size();
+		if(P>D) print_error("There are more processes ("+to_string(P)+") than domains ("+to_string(D)+").");
+		D0 = (uint)((ulong)rank*(ulong)D/(ulong)P); // every process owns a contiguous block of domains
+		D1 = (uint)((ulong)(rank+1u)*(ulong)D/(ulong)P);
+		const uint setup[6] = { this->Nx, this->Ny, this->Nz, Dx, Dy, Dz };
+		for(uint peer=0u; peer<P; peer++) { // all processes have to run the same setup, otherwise halo sizes don't match
+			if(peer==rank) continue;
+			uint peer_setup[6];
+			transport->exchange(peer, setup, peer_setup, sizeof(setup));
+			if(memcmp(setup, peer_setup, sizeof(setup))!=0) print_error("Process "+to_string(peer)+" runs a different grid ("+to_string(peer_setup[0])+"x"+to_string(peer_setup[1])+"x"+to_string(peer_setup[2])+", "+to_string(peer_setup[3])+"x"+to_string(peer_setup[4])+"x"+to_string(peer_setup[5])+" domains) than process "+to_string(rank)+".");
+		}
+		print_info("Process "+to_string(rank)+" runs domains "+to_string(D0)+" to "+to_string(D1-1u)+" of "+to_string(D)+".");
+		if(Settings::GetRepartitionPeriod()>0u) print_warning("Dynamic domain repartitioning is not supported across processes and is disabled.");
+	}
+	resident_slabs = Settings::GetOutOfCore()&&D>1u ? min(3u, D) : 0u; // one slab uploads while the next computes and the one after downloads
+	vector<Device_Info> device_infos = smart_device_selection(out_of_core() ? 1u : D);
+	if(out_of_core()) device_infos = vector<Device_Info>(D, device_infos[0]); // all slabs are streamed through the same device
+	weights = balanced ? domain_weights(device_infos) : vector<float>(D, 1.0f);
+	if(balanced&&transport!=nullptr) { // only the weights of the own devices are known, all processes have to agree on the domain sizes
+		for(uint d=0u; d<D; d++) if(d<D0||d>=D1) weights[d] = 0.0f;
+		transport->sum(weights);
+	}
+	vector<float> wx(Dx, 0.0f), wy(Dy, 0.0f), wz(Dz, 0.0f); // domains are split along planes, so sum up weights of all domains within each slab
+	for(uint d=0u; d<D; d++) {
+		const uint x=((uint)d%(Dx*Dy))%Dx, y=((uint)d%(Dx*Dy))/Dx, z=(uint)d/(Dx*Dy); // d = x+(y+z*Dy)*Dx
+		wx[x] += weights[d];
+		wy[y] += weights[d];
+		wz[z] += weights[d];
+	}
+	Sx = split_domains(this->Nx, wx);
+	Sy = split_domains(this->Ny, wy);
+	Sz = split_domains(this->Nz, wz);
+	if(balanced) print_info("Throughput-weighted domain sizes: x = ("+print_split(Sx)+"), y = ("+print_split(Sy)+"), z = ("+print_split(Sz)+")");
+	if(D>1u) { // report predicted communication overhead, based on the largest domain
+		uint Lx=0u, Ly=0u, Lz=0u;
+		for(uint x=0u; x<Dx; x++) Lx = max(Lx, get_domain_Nx(x));
+		for(uint y=0u; y<Dy; y++) Ly = max(Ly, get_domain_Ny(y));
+		for(uint z=0u; z<Dz; z++) Lz = max(Lz, get_domain_Nz(z));
+		const double halo = (double)halo_transfer_bytes(Lx, Ly, Lz, Dx, Dy, Dz), compute = (double)D*(double)Lx*(double)Ly*(double)Lz*(double)bandwidth_bytes_per_cell_device();
+		print_info("Domain decomposition "+to_string(Dx)+"x"+to_string(Dy)+"x"+to_string(Dz)+": "+to_string(halo/1048576.0, 1u)+" MB halo transfer per time step, predicted communication share is "+to_string(100.0*halo/(halo+compute), 1u)+"% of the data moved.");
+	}
 	sanity_checks_constructor(device_infos, this->Nx, this->Ny, this->Nz, Dx, Dy, Dz, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho);
 	lbm = new LBM_Domain*[D];
-	for(uint d=0u; d<D; d++) { // { thread* threads=new thread[D]; for(uint d=0u; d<D; d++) threads[d]=thread([=]() {
+	for(uint d=0u; d<D; d++) lbm[d] = nullptr; // domains of other processes stay nullptr
+	for(uint d=D0; d<D1; d++) { // { thread* threads=new thread[D]; for(uint d=0u; d<D; d++) threads[d]=thread([=]() {
 		const uint x=((uint)d%(Dx*Dy))%Dx, y=((uint)d%(Dx*Dy))/Dx, z=(uint)d/(Dx*Dy); // d = x+(y+z*Dy)*Dx
-		lbm[d] = new LBM_Domain(device_infos[d], this->Nx/Dx+2u*Hx, this->Ny/Dy+2u*Hy, this->Nz/Dz+2u*Hz, Dx, Dy, Dz, (int)(x*this->Nx/Dx)-(int)Hx, (int)(y*this->Ny/Dy)-(int)Hy, (int)(z*this->Nz/Dz)-(int)Hz, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho);
+		const LBM_Domain* resident = out_of_core()&&d>=resident_slabs ? lbm[d%resident_slabs] : nullptr; // out-of-core, slab d shares the device buffers of resident slab d%resident_slabs
+		const LBM_Domain* first_slab = out_of_core()&&d>0u ? lbm[0] : nullptr; // out-of-core, all slabs share the program of the first slab
+		lbm[d] = new LBM_Domain(device_infos[d], get_domain_Nx(x)+2u*Hx, get_domain_Ny(y)+2u*Hy, get_domain_Nz(z)+2u*Hz, Dx, Dy, Dz, (int)Sx[x]-(int)Hx, (int)Sy[y]-(int)Hy, (int)Sz[z]-(int)Hz, this->Nx, this->Ny, this->Nz, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho, resident, first_slab);
 	} // }); for(uint d=0u; d<D; d++) threads[d].join(); delete[] threads; }
+	if(D>1u) allocate_transfer_host_buffers();
+	link_memory_containers();
+#ifdef GRAPHICS
+	graphics = Graphics(this);
+#endif // GRAPHICS
+	fx3d::info.initialize(this);
+}
+void LBM::link_memory_containers() { // (re-)link host Memory_Container objects to the buffers of all domains
+	const uint D = get_D();
 	{
 		Memory<float>** buffers_rho = new Memory<float>*[D];
-		for(uint d=0u; d<D; d++) buffers_rho[d] = &(lbm[d]->rho);
+		for(uint d=0u; d<D; d++) buffers_rho[d] = lbm[d]!=nullptr ? &(lbm[d]->rho) : nullptr; // domains of other processes have no host buffers
 		rho = Memory_Container(this, buffers_rho, "rho");
 	} {
 		Memory<float>** buffers_u = new Memory<float>*[D];
-		for(uint d=0u; d<D; d++) buffers_u[d] = &(lbm[d]->u);
+		for(uint d=0u; d<D; d++) buffers_u[d] = lbm[d]!=nullptr ? &(lbm[d]->u) : nullptr;
 		u = Memory_Container(this, buffers_u, "u");
 	} {
 		Memory<uchar>** buffers_flags = new Memory<uchar>*[D];
-		for(uint d=0u; d<D; d++) buffers_flags[d] = &(lbm[d]->flags);
+		for(uint d=0u; d<D; d++) buffers_flags[d] = lbm[d]!=nullptr ? &(lbm[d]->flags) : nullptr;
 		flags = Memory_Container(this, buffers_flags, "flags");
 	} 
 	if (Settings::IsFeatureEnabled(Feature::FORCE_FIELD))
 	{
 		Memory<float>** buffers_F = new Memory<float>*[D];
-		for(uint d=0u; d<D; d++) buffers_F[d] = &(lbm[d]->F);
+		for(uint d=0u; d<D; d++) buffers_F[d] = lbm[d]!=nullptr ? &(lbm[d]->F) : nullptr;
 		F = Memory_Container(this, buffers_F, "F");
 	} 
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 	{
 		Memory<float>** buffers_phi = new Memory<float>*[D];
-		for(uint d=0u; d<D; d++) buffers_phi[d] = &(lbm[d]->phi);
+		for(uint d=0u; d<D; d++) buffers_phi[d] = lbm[d]!=nullptr ? &(lbm[d]->phi) : nullptr;
 		phi = Memory_Container(this, buffers_phi, "phi");
 	} 
 	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
 	{
 		Memory<float>** buffers_T = new Memory<float>*[D];
-		for(uint d=0u; d<D; d++) buffers_T[d] = &(lbm[d]->T);
+		for(uint d=0u; d<D; d++) buffers_T[d] = lbm[d]!=nullptr ? &(lbm[d]->T) : nullptr;
 		T = Memory_Container(this, buffers_T, "T");
 	}
 	if (Settings::IsFeatureEnabled(Feature::PARTICLES))
 	{
-		particles = &(lbm[0]->particles);
+		particles = &(lbm[D0]->particles);
 	}
-#ifdef GRAPHICS
-	graphics = Graphics(this);
-#endif // GRAPHICS
-	fx3d::info.initialize(this);
 }
 LBM::~LBM() {
 	fx3d::info.print_finalize();
-	for(uint d=0u; d<get_D(); d++) delete lbm[d];
+	for(uint d=D0; d<D1; d++) delete lbm[d];
 	delete[] lbm;
+	host_free((void*)halo_buffer);
+	delete transport;
 }
 
 void LBM::sanity_checks_constructor(const vector<Device_Info>& device_infos, const uint Nx, const uint Ny, const uint Nz, const uint Dx, const uint Dy, const uint Dz, const float nu, const float fx, const float fy, const float fz, const float sigma, const float alpha, const float beta, const uint particles_N, const float particles_rho) { // sanity checks on grid resolution and extension support
 	if((ulong)Nx*(ulong)Ny*(ulong)Nz==0ull) print_error("Grid point number is 0: "+to_string(Nx)+"x"+to_string(Ny)+"x"+to_string(Nz)+" = 0.");
 	if(Dx*Dy*Dz==0u) print_error("You specified 0 LBM grid domains ("+to_string(Dx)+"x"+to_string(Dy)+"x"+to_string(Dz)+"). There has to be at least 1 domain in every direction. Check your input in LBM constructor.");
-	const uint local_Nx=Nx/Dx+2u*(Dx>1u), local_Ny=Ny/Dy+2u*(Dy>1u), local_Nz=Nz/Dz+2u*(Dz>1u);
-	if((ulong)local_Nx*(ulong)local_Ny*(ulong)local_Nz>=(ulong)max_uint) print_error("Single domain grid resolution is too large: "+to_string(local_Nx)+"x"+to_string(local_Ny)+"x"+to_string(local_Nz)+" > 2^32.");
-	uint memory_available = max_uint; // in MB
-	for(Device_Info device_info : device_infos) memory_available = min(memory_available, device_info.memory);
-	uint memory_required = (uint)((ulong)Nx*(ulong)Ny*(ulong)Nz/((ulong)(Dx*Dy*Dz))*(ulong)bytes_per_cell_device()/1048576ull); // in MB
+	if(Nx<Dx||Ny<Dy||Nz<Dz) print_error("Grid resolution ("+to_string(Nx)+", "+to_string(Ny)+", "+to_string(Nz)+") is too small for "+to_string(Dx)+"x"+to_string(Dy)+"x"+to_string(Dz)+" domains.");
+	if(Settings::GetHaloExchangePeriod()>1u&&Dx*Dy*Dz>1u) { // wide halos only carry DDFs, rho, u and flags
+		if(Settings::IsFeatureEnabled((Feature)((int)Feature::FORCE_FIELD | (int)Feature::SURFACE | (int)Feature::TEMPERATURE | (int)Feature::PARTICLES))) print_error("Halo exchange period "+to_string(Settings::GetHaloExchangePeriod())+" is not supported with the FORCE_FIELD, SURFACE, TEMPERATURE or PARTICLES extensions. Set the halo exchange period to 1.");
+		const uint W = halo_width();
+		for(uint x=0u; x<Dx; x++) if(Dx>1u&&get_domain_Nx(x)<W) print_error("Domain "+to_string(x)+" in x-direction is thinner ("+to_string(get_domain_Nx(x))+") than the halo ("+to_string(W)+" layers). Reduce the halo exchange period or use less domains.");
+		for(uint y=0u; y<Dy; y++) if(Dy>1u&&get_domain_Ny(y)<W) print_error("Domain "+to_string(y)+" in y-direction is thinner ("+to_string(get_domain_Ny(y))+") than the halo ("+to_string(W)+" layers). Reduce the halo exchange period or use less domains.");
+		for(uint z=0u; z<Dz; z++) if(Dz>1u&&get_domain_Nz(z)<W) print_error("Domain "+to_string(z)+" in z-direction is thinner ("+to_string(get_domain_Nz(z))+") than the halo ("+to_string(W)+" layers). Reduce the halo exchange period or use less domains.");
+	}
+	if(Settings::GetOutOfCore()&&Dx*Dy*Dz==1u) print_warning("Out-of-core simulations stream z-slabs through the device, but there is only 1 domain. Computing in device memory instead.");
+	if(out_of_core()) { // slabs share the device buffers of the resident slabs, so they all have to be the same size and all communication has to go through host memory
+		if(Dx>1u||Dy>1u) print_error("Out-of-core simulations stream z-slabs through the device, domains have to be 1x1x"+to_string(Dx*Dy*Dz)+" instead of "+to_string(Dx)+"x"+to_string(Dy)+"x"+to_string(Dz)+".");
+		if(Settings::IsFeatureEnabled((Feature)((int)Feature::FORCE_FIELD | (int)Feature::SURFACE | (int)Feature::TEMPERATURE | (int)Feature::PARTICLES))) print_error("Out-of-core simulations are not supported with the FORCE_FIELD, SURFACE, TEMPERATURE or PARTICLES extensions.");
+		if(transport!=nullptr) print_error("Out-of-core simulations have to run in a single process.");
+		if(device_infos[0].is_native) print_error("Out-of-core simulations need an OpenCL device, the native CPU backend already computes in host memory.");
+		if(Settings::GetDomainBalancing()!=DomainBalancing::UNIFORM) print_error("Out-of-core simulations need uniform domain balancing, all slabs have to be the same size.");
+		if(Settings::GetHaloExchangePeriod()>1u) print_error("Out-of-core simulations are not supported with a halo exchange period larger than 1.");
+		if(Settings::GetRepartitionPeriod()>0u) print_warning("Dynamic domain repartitioning is not supported out-of-core and is disabled.");
+		const uint slab_memory = (uint)((ulong)Nx*(ulong)Ny*(ulong)(Nz/Dz+2u)*(ulong)bytes_per_cell_device()/1048576ull); // in MB, with halo
+		ulong slab_buffers = 2ull*(ulong)Nx*(ulong)Ny*(ulong)transfer_bytes_max(); // transfer buffers in device memory, every slab has its own
+#ifdef GRAPHICS
+		slab_buffers += 2ull*(ulong)fx3d::GraphicsSettings::GetCamera().width*(ulong)fx3d::GraphicsSettings::GetCamera().height*sizeof(int)+15ull*sizeof(float); // bitmap, zbuffer and camera parameters, every slab has its own
+#endif // GRAPHICS
+		const uint buffers_memory = (uint)(((ulong)Dz*slab_buffers+1048575ull)/1048576ull); // in MB, for all slabs
+		if(resident_slabs*slab_memory+buffers_memory>device_infos[0].memory) print_error("Out-of-core simulation needs "+to_string(resident_slabs)+"x "+to_string(slab_memory)+" MB for the resident slabs and "+to_string(buffers_memory)+" MB for the transfer and graphics buffers of all slabs, but device \""+device_infos[0].name+"\" only has "+to_string(device_infos[0].memory)+" MB. Use more slabs.");
+		print_info("Out-of-core simulation with "+to_string(Dz)+" slabs of "+to_string(slab_memory)+" MB in host memory, "+to_string(resident_slabs)+" of them at a time in device memory.");
+#ifdef GRAPHICS
+		print_warning("Graphics render from device memory, out-of-core they only show the slabs that were streamed through the device last.");
+#endif // GRAPHICS
+	}
+	if(Settings::GetTemporalBlocking()>1u&&(Dx*Dy*Dz>1u||!device_infos[0].is_native||Settings::IsFeatureEnabled((Feature)((int)Feature::FORCE_FIELD | (int)Feature::SURFACE | (int)Feature::TEMPERATURE | (int)Feature::PARTICLES)))) {
+		print_warning("Temporal blocking is only available for a single domain on the native C++ CPU backend without the FORCE_FIELD, SURFACE, TEMPERATURE and PARTICLES extensions. Computing one time step per pass instead.");
+	} else if(Settings::GetTemporalBlocking()>1u&&Settings::GetTemporalBlocking()+1u>min(min(Nx, Ny), Nz)/2u) {
+		print_warning("Temporal blocking of "+to_string(Settings::GetTemporalBlocking())+" time steps needs a margin of "+to_string(Settings::GetTemporalBlocking()+1u)+" layers, which is more than half of the smallest lattice dimension. Computing one time step per pass instead.");
+	}
+	uint memory_available=max_uint, memory_required=0u; // in MB, for the domain with the least memory headroom
+	for(uint d=0u; d<Dx*Dy*Dz; d++) {
+		const uint x=(d%(Dx*Dy))%Dx, y=(d%(Dx*Dy))/Dx, z=d/(Dx*Dy); // d = x+(y+z*Dy)*Dx
+		const uint W = halo_width();
+		const uint local_Nx=get_domain_Nx(x)+2u*(Dx>1u)*W, local_Ny=get_domain_Ny(y)+2u*(Dy>1u)*W, local_Nz=get_domain_Nz(z)+2u*(Dz>1u)*W;
+		if((ulong)local_Nx*(ulong)local_Ny*(ulong)local_Nz>=(ulong)max_uint) print_info("Domain "+to_string(d)+" has "+to_string(local_Nx)+"x"+to_string(local_Ny)+"x"+to_string(local_Nz)+" >= 2^32 lattice points, its kernels use 64-bit indexing.");
+		const uint domain_memory_required = (uint)((ulong)get_domain_Nx(x)*(ulong)get_domain_Ny(y)*(ulong)get_domain_Nz(z)*(ulong)bytes_per_cell_device()/1048576ull); // in MB
+		if((ulong)domain_memory_required*(ulong)memory_available>(ulong)memory_required*(ulong)device_infos[d].memory) { // compare ratios required/available
+			memory_required = domain_memory_required;
+			memory_available = device_infos[d].memory;
+		}
+	}
 	if(memory_required>memory_available) {
 		float factor = cbrt((float)memory_available/(float)memory_required);
 		const uint maxNx=(uint)(factor*(float)Nx), maxNy=(uint)(factor*(float)Ny), maxNz=(uint)(factor*(float)Nz);
 		string message = "Grid resolution ("+to_string(Nx)+", "+to_string(Ny)+", "+to_string(Nz)+") is too large: "+to_string(Dx*Dy*Dz)+"x "+to_string(memory_required)+" MB required, "+to_string(Dx*Dy*Dz)+"x "+to_string(memory_available)+" MB available. Largest possible resolution is ("+to_string(maxNx)+", "+to_string(maxNy)+", "+to_string(maxNz)+"). Restart the simulation with lower resolution or on different device(s) with more memory.";
 #if !defined(FP16S)&&!defined(FP16C)
-		uint memory_required_fp16 = (uint)((ulong)Nx*(ulong)Ny*(ulong)Nz/((ulong)(Dx*Dy*Dz))*(ulong)(bytes_per_cell_device()-Settings::GetVSetSize()*2u)/1048576ull); // in MB
+		uint memory_required_fp16 = (uint)((ulong)memory_required*(ulong)(bytes_per_cell_device()-Settings::GetVSetSize()*2u)/(ulong)bytes_per_cell_device()); // in MB
 		float factor_fp16 = cbrt((float)memory_available/(float)memory_required_fp16);
 		const uint maxNx_fp16=(uint)(factor_fp16*(float)Nx), maxNy_fp16=(uint)(factor_fp16*(float)Ny), maxNz_fp16=(uint)(factor_fp16*(float)Nz);
 		message += " Consider using FP16S/FP16C memory compression to double maximum grid resolution to a maximum of ("+to_string(maxNx_fp16)+", "+to_string(maxNy_fp16)+", "+to_string(maxNz_fp16)+"); for this, uncomment \"#define FP16S\" or \"#define FP16C\" in defines.hpp.";
@@ -796,42 +1488,93 @@ void LBM::sanity_checks_initialization() { // sanity checks during initializatio
 	}
 }
 
+template<typename Function> void LBM::cycle_slabs(Function function) { // out-of-core: stream all slabs through the device, every slab has its own queue, so slab d uploads while slab d-1 computes and slab d-2 downloads
+	const uint D = get_D();
+	for(uint d=0u; d<D; d++) {
+		if(d>=resident_slabs) lbm[d-resident_slabs]->finish_queue(); // slab d reuses the device buffers of slab d-resident_slabs, which has to be downloaded first
+		lbm[d]->enqueue_slab_upload();
+		function(d);
+		lbm[d]->enqueue_slab_download();
+	}
+	for(uint d=0u; d<D; d++) lbm[d]->finish_queue(); // all slabs and their extracted halo data are back in host memory
+}
+void LBM::initialize_slabs() { // out-of-core version of initialize(), the transfer buffers can only hold one halo field at a time, so every exchange is a separate pass over the slabs
+	const uint bytes_rho_u_flags=transfer_bytes_rho_u_flags(), bytes_fi=transfer_bytes_fi();
+	for(uint d=0u; d<get_D(); d++) lbm[d]->increment_time_step(); // the communicate calls at initialization need an odd time step
+	cycle_slabs([&](const uint d) {
+		lbm[d]->enqueue_transfer_extract_field(lbm[d]->kernel_transfer[enum_transfer_field::rho_u_flags][0], 2u, bytes_rho_u_flags);
+	});
+	exchange_transfer_buffers(2u, bytes_rho_u_flags);
+	cycle_slabs([&](const uint d) {
+		lbm[d]->enqueue_transfer_insert_field(lbm[d]->kernel_transfer[enum_transfer_field::rho_u_flags][1], 2u, bytes_rho_u_flags);
+		lbm[d]->enqueue_initialize(); // odd time step is baked-in the kernel
+		lbm[d]->enqueue_transfer_extract_field(lbm[d]->kernel_transfer[enum_transfer_field::rho_u_flags][0], 2u, bytes_rho_u_flags);
+	});
+	exchange_transfer_buffers(2u, bytes_rho_u_flags);
+	cycle_slabs([&](const uint d) {
+		lbm[d]->enqueue_transfer_insert_field(lbm[d]->kernel_transfer[enum_transfer_field::rho_u_flags][1], 2u, bytes_rho_u_flags);
+		lbm[d]->enqueue_transfer_extract_field(lbm[d]->kernel_transfer[enum_transfer_field::fi][0], 2u, bytes_fi); // time step must be odd here
+	});
+	exchange_transfer_buffers(2u, bytes_fi);
+	slab_halo_pending = true; // the DDF halo is inserted at the beginning of the first time step
+	halo_rho_u_flags_stale = false;
+	for(uint d=0u; d<get_D(); d++) lbm[d]->reset_time_step(); // set time step to 0 again
+}
+void LBM::do_time_step_slabs() { // out-of-core version of do_time_step(), one pass over all slabs inserts the DDF halo of the previous time step, streams and collides, and extracts the new DDF halo
+	const uint bytes_fi = transfer_bytes_fi();
+	const bool insert = slab_halo_pending;
+	cycle_slabs([&](const uint d) {
+		if(insert) lbm[d]->enqueue_slab_insert_fi();
+		lbm[d]->enqueue_stream_collide();
+		lbm[d]->enqueue_transfer_extract_field(lbm[d]->kernel_transfer[enum_transfer_field::fi][0], 2u, bytes_fi);
+	});
+	exchange_transfer_buffers(2u, bytes_fi);
+	slab_halo_pending = true;
+	halo_rho_u_flags_stale = true;
+	for(uint d=0u; d<get_D(); d++) lbm[d]->increment_time_step();
+}
+
 void LBM::initialize() { // write all data fields to device and call kernel_initialize
 	sanity_checks_initialization();
+	if(out_of_core()) {
+		initialize_slabs();
+		initialized = true;
+		return;
+	}
 
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->rho.enqueue_write_to_device();
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->u.enqueue_write_to_device();
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->flags.enqueue_write_to_device();
 	if (Settings::IsFeatureEnabled(Feature::FORCE_FIELD))
 	{
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->F.enqueue_write_to_device();
 	}
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 	{
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->phi.enqueue_write_to_device();
 	}
 	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
 	{
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->T.enqueue_write_to_device();
 	}
 	if (Settings::IsFeatureEnabled(Feature::PARTICLES))
 	{
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->particles.enqueue_write_to_device();
 	}
 
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->increment_time_step(); // the communicate calls at initialization need an odd time step
 	communicate_rho_u_flags();
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 		communicate_phi_massex_flags();
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->enqueue_initialize(); // odd time step is baked-in the kernel
 	communicate_rho_u_flags();
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
@@ -839,33 +1582,60 @@ void LBM::initialize() { // write all data fields to device and call kernel_init
 	communicate_fi(); // time step must be odd here
 	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
 		communicate_gi(); // time step must be odd here
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->finish_queue();
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->reset_time_step(); // set time step to 0 again
+	release_host_mirrors(); // all fields are in device memory now
 	initialized = true;
 }
+void LBM::release_host_mirrors() { // with lazy host mirrors, free the host buffers of all fields that also live in device memory, they are allocated again on the next host access or readback
+	rho.release_host_buffers();
+	u.release_host_buffers();
+	flags.release_host_buffers();
+	if (Settings::IsFeatureEnabled(Feature::FORCE_FIELD))
+		F.release_host_buffers();
+	if (Settings::IsFeatureEnabled(Feature::SURFACE))
+		phi.release_host_buffers();
+	if (Settings::IsFeatureEnabled(Feature::TEMPERATURE))
+		T.release_host_buffers();
+}
 
 void LBM::do_time_step() { // call kernel_stream_collide to perform one LBM time step
+	if(out_of_core()) {
+		do_time_step_slabs();
+		return;
+	}
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 	{
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 		lbm[d]->enqueue_surface_0();
 	}
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->enqueue_stream_collide(); // run LBM stream_collide kernel after domain communication
-// #if defined(SURFACE) || defined(GRAPHICS)
-	communicate_rho_u_flags(); // rho/u/flags halo data is required for SURFACE extension, and u halo data is required for Q-criterion rendering
-// #endif // SURFACE || GRAPHICS
+	halo_rho_u_flags_stale = true; // rho/u/flags halo data is only required for SURFACE extension, for rendering and for the moving boundary update, so it is exchanged on demand
+	const bool communicate = get_D()==1u||(get_t()+1ull)%(ulong)Settings::GetHaloExchangePeriod()==0ull; // wide halos are recomputed locally in between exchanges
+	if(!communicate) // only wide halos skip communication, they are not supported together with SURFACE, TEMPERATURE and PARTICLES
+	{
+		for(uint d=D0; d<D1; d++) 
+			lbm[d]->finish_queue();
+		for(uint d=D0; d<D1; d++) 
+			lbm[d]->increment_time_step();
+		return;
+	}
+#if defined(INTERACTIVE_GRAPHICS)||defined(INTERACTIVE_GRAPHICS_ASCII)
+	update_halo_rho_u_flags(); // interactive graphics render in their own thread and can't trigger communication, so keep the halo up-to-date in every communication step
+#endif // INTERACTIVE_GRAPHICS_ASCII || INTERACTIVE_GRAPHICS
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
 	{
-		for(uint d=0u; d<get_D(); d++) 
+		update_halo_rho_u_flags(); // surface_1 reads rho/u/flags of neighbors in the halo
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->enqueue_surface_1();
 		communicate_flags();
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->enqueue_surface_2();
 		communicate_flags();
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->enqueue_surface_3();
 		communicate_phi_massex_flags();
 	}
@@ -874,18 +1644,25 @@ void LBM::do_time_step() { // call kernel_stream_collide to perform one LBM time
 		communicate_gi();
 	if (Settings::IsFeatureEnabled(Feature::PARTICLES))
 	{
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->enqueue_integrate_particles(); // intgegrate particles forward in time and couple particles to fluid
 	}
 	if(get_D()==1u) 
 	{
-		for(uint d=0u; d<get_D(); d++) 
+		for(uint d=D0; d<D1; d++) 
 			lbm[d]->finish_queue(); // this additional domain synchronization barrier is only required in single-GPU, as communication calls already provide all necessary synchronization barriers in multi-GPU
 	}
-	for(uint d=0u; d<get_D(); d++) 
+	for(uint d=D0; d<D1; d++) 
 		lbm[d]->increment_time_step();
 }
 
+void LBM::do_time_steps_tiled(const uint steps) { // perform steps LBM time steps in one pass over the lattice (temporal blocking)
+	lbm[0]->enqueue_stream_collide_tiles(steps); // temporal blocking is only available for a single domain, so there is no communication
+	halo_rho_u_flags_stale = true;
+	lbm[0]->finish_queue();
+	lbm[0]->increment_time_step(steps);
+}
+
 void LBM::run(const ulong steps) { // initializes the LBM simulation (copies data to device and runs initialize kernel), then runs LBM
 	fx3d::info.append(steps, get_t());
 	if(!initialized)
@@ -897,15 +1674,95 @@ void LBM::run(const ulong steps) { // initializes the LBM simulation (copies dat
 	for(ulong i=1ull; i<=steps; i++)
 	{
 		clock.start();
-		do_time_step();
-		fx3d::info.update(clock.stop());
+		const uint block = lbm[D0]->temporal_blocking() ? (uint)min((ulong)Settings::GetTemporalBlocking(), steps-i+1ull) : 1u; // time steps in this pass, the last pass can be shorter
+		if(block>1u) do_time_steps_tiled(block); else do_time_step();
+		if(Settings::GetRepartitionPeriod()>0u&&get_D()>1u&&transport==nullptr&&!out_of_core()&&get_t()%(ulong)Settings::GetRepartitionPeriod()==0ull) repartition(); // dynamic load balancing
+		const double dt = clock.stop()/(double)block;
+		for(uint b=0u; b<block; b++) fx3d::info.update(dt); // time steps of a temporal block take equally long
+		i += (ulong)(block-1u);
+	}
+	if(get_D()>1u) for(uint d=D0; d<D1; d++) lbm[d]->finish_queue(); // wait for everything to finish (multi-GPU only)
+}
+
+void LBM::repartition() { // count active nodes in all domains and move domain boundaries if the load is too uneven
+	const uint D = get_D();
+	for(uint d=0u; d<D; d++) lbm[d]->enqueue_count_active_cells();
+	for(uint d=0u; d<D; d++) lbm[d]->finish_queue();
+	const float inactive_cost = 0.1f; // solid and gas nodes still cost a flag read and an early return in every kernel
+	const float threshold = Settings::GetRepartitionThreshold();
+	const uint Ds[3]={ Dx, Dy, Dz }, Ns[3]={ Nx, Ny, Nz };
+	const vector<uint>* S[3] = { &Sx, &Sy, &Sz };
+	vector<uint> split[3] = { Sx, Sy, Sz }; // new domain split positions
+	bool changed = false;
+	for(uint axis=0u; axis<3u; axis++) {
+		if(Ds[axis]==1u) continue; // only move planes in directions that are split into domains
+		vector<double> cost(Ns[axis], 0.0); // load of every global plane orthogonal to axis
+		vector<float> w(Ds[axis], 0.0f); // throughput of every slab
+		for(uint d=0u; d<D; d++) {
+			const uint c[3] = { (d%(Dx*Dy))%Dx, (d%(Dx*Dy))/Dx, d/(Dx*Dy) }; // d = x+(y+z*Dy)*Dx
+			const uint offset = axis==0u ? 0u : axis==1u ? lbm[d]->get_Nx() : lbm[d]->get_Nx()+lbm[d]->get_Ny(); // plane counts of this axis in active_cells
+			const uint s0=(*S[axis])[c[axis]], s1=(*S[axis])[c[axis]+1u];
+			for(uint i=s0; i<s1; i++) cost[i] += (double)lbm[d]->active_cells[offset+halo_width()+i-s0]; // skip the halo planes
+			w[c[axis]] += weights[d];
+		}
+		const double area = (double)get_N()/(double)Ns[axis];
+		for(uint i=0u; i<Ns[axis]; i++) cost[i] += (double)inactive_cost*(area-cost[i]);
+		const float imbalance = split_imbalance(cost, *S[axis], w);
+		if(imbalance<=threshold) continue; // hysteresis, don't rebuild domains for small fluctuations
+		const vector<uint> balanced = split_domains(cost, w);
+		if(split_imbalance(cost, balanced, w)<imbalance-0.5f*threshold) { // only repartition if it is a real improvement
+			split[axis] = balanced;
+			changed = true;
+		}
+	}
+	if(!changed) return;
+	for(uint d=0u; d<D; d++) { // new domains have to fit into device memory
+		const uint x=(d%(Dx*Dy))%Dx, y=(d%(Dx*Dy))/Dx, z=d/(Dx*Dy); // d = x+(y+z*Dy)*Dx
+		const uint W = halo_width();
+		const ulong local_N = (ulong)(split[0][x+1u]-split[0][x]+2u*(Dx>1u)*W)*(ulong)(split[1][y+1u]-split[1][y]+2u*(Dy>1u)*W)*(ulong)(split[2][z+1u]-split[2][z]+2u*(Dz>1u)*W);
+		if(local_N*(ulong)bytes_per_cell_device()/1048576ull>(ulong)lbm[d]->get_device().info.memory) {
+			print_warning("Domain repartitioning skipped, domain "+to_string(d)+" would not fit into device memory.");
+			return;
+		}
 	}
-	if(get_D()>1u) for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue(); // wait for everything to finish (multi-GPU only)
+	print_info("Repartitioning domains at t = "+to_string(get_t())+": x = ("+print_split(split[0])+"), y = ("+print_split(split[1])+"), z = ("+print_split(split[2])+")");
+	vector<vector<char>> state; // global copy of all fields, domain sizes are compile-time constants in OpenCL C code, so resized domains have to be rebuilt
+	for(uint d=0u; d<D; d++) lbm[d]->gather_state(state);
+	const ulong t = get_t();
+	const uint W=halo_width(), Hx=(Dx>1u)*W, Hy=(Dy>1u)*W, Hz=(Dz>1u)*W; // halo offsets
+	for(uint d=0u; d<D; d++) {
+		const uint x=(d%(Dx*Dy))%Dx, y=(d%(Dx*Dy))/Dx, z=d/(Dx*Dy); // d = x+(y+z*Dy)*Dx
+		if(split[0][x]==Sx[x]&&split[0][x+1u]==Sx[x+1u]&&split[1][y]==Sy[y]&&split[1][y+1u]==Sy[y+1u]&&split[2][z]==Sz[z]&&split[2][z+1u]==Sz[z+1u]) continue; // domain is unchanged and keeps its data
+		const LBM_Domain* old = lbm[d];
+		Device_Info device_info = old->get_device().info;
+		device_info.memory_used = 0u; // memory of the old domain is freed before the new domain is allocated
+		const float nu=old->get_nu(), fx=old->get_fx(), fy=old->get_fy(), fz=old->get_fz(), sigma=old->get_sigma(), alpha=old->get_alpha(), beta=old->get_beta(), particles_rho=old->get_particles_rho();
+		const uint particles_N = old->get_particles_N();
+		delete old;
+		lbm[d] = new LBM_Domain(device_info, split[0][x+1u]-split[0][x]+2u*Hx, split[1][y+1u]-split[1][y]+2u*Hy, split[2][z+1u]-split[2][z]+2u*Hz, Dx, Dy, Dz, (int)split[0][x]-(int)Hx, (int)split[1][y]-(int)Hy, (int)split[2][z]-(int)Hz, Nx, Ny, Nz, nu, fx, fy, fz, sigma, alpha, beta, particles_N, particles_rho);
+		lbm[d]->scatter_state(state, t); // halo nodes are copied from their owning domain, so no communication is necessary
+	}
+	Sx = split[0]; Sy = split[1]; Sz = split[2];
+	allocate_transfer_host_buffers();
+	link_memory_containers();
+	release_host_mirrors(); // new domains have written their host buffers to device memory in scatter_state()
 }
 
 void LBM::update_fields() { // update fields (rho, u, T) manually
-	for(uint d=0u; d<get_D(); d++) lbm[d]->enqueue_update_fields();
-	for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue();
+	if(out_of_core()) { // one pass over all slabs, which also inserts a pending DDF halo, as update_fields reads the DDFs of the halo
+		if(!initialized||Settings::IsFeatureEnabled(Feature::UPDATE_FIELDS)||(t_slabs_updated==get_t()&&!slab_halo_pending)) return; // rho/u in host memory are already up-to-date
+		const bool insert = slab_halo_pending;
+		cycle_slabs([&](const uint d) {
+			if(insert) lbm[d]->enqueue_slab_insert_fi();
+			lbm[d]->enqueue_update_fields();
+		});
+		slab_halo_pending = false;
+		t_slabs_updated = get_t();
+		return;
+	}
+	for(uint d=D0; d<D1; d++) lbm[d]->enqueue_update_fields();
+	halo_rho_u_flags_stale = true; // update_fields() only computes interior nodes
+	for(uint d=D0; d<D1; d++) lbm[d]->finish_queue();
 }
 
 void LBM::reset() { // reset simulation (takes effect in following run() call)
@@ -914,8 +1771,8 @@ void LBM::reset() { // reset simulation (takes effect in following run() call)
 
 // #ifdef FORCE_FIELD
 void LBM::calculate_force_on_boundaries() { // calculate forces from fluid on TYPE_S nodes
-	for(uint d=0u; d<get_D(); d++) lbm[d]->enqueue_calculate_force_on_boundaries();
-	for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue();
+	for(uint d=D0; d<D1; d++) lbm[d]->enqueue_calculate_force_on_boundaries();
+	for(uint d=D0; d<D1; d++) lbm[d]->finish_queue();
 }
 float3 LBM::calculate_force_on_object(const uchar flag_marker) { // add up force for all nodes flagged with flag_marker
 	double3 force(0.0, 0.0, 0.0);
@@ -959,9 +1816,11 @@ float3 LBM::calculate_torque_on_object(const float3& rotation_center, const ucha
 
 // #ifdef MOVING_BOUNDARIES
 void LBM::update_moving_boundaries() { // mark/unmark nodes next to TYPE_S nodes with velocity!=0 with TYPE_MS
-	for(uint d=0u; d<get_D(); d++) lbm[d]->enqueue_update_moving_boundaries();
+	if(out_of_core()) print_error("Moving boundaries can't be updated in device memory out-of-core, set the flags in host memory before the simulation starts.");
+	update_halo_rho_u_flags(); // velocities of TYPE_S nodes in the halo have to be known
+	for(uint d=D0; d<D1; d++) lbm[d]->enqueue_update_moving_boundaries();
 	communicate_rho_u_flags();
-	for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue();
+	for(uint d=D0; d<D1; d++) lbm[d]->finish_queue();
 }
 // #endif // MOVING_BOUNDARIES
 
@@ -975,9 +1834,9 @@ void LBM::integrate_particles(const ulong steps, const uint time_step_multiplica
 		if(!running) break;
 #endif // INTERACTIVE_GRAPHICS_ASCII || INTERACTIVE_GRAPHICS
 		clock.start();
-		for(uint d=0u; d<get_D(); d++) lbm[d]->enqueue_integrate_particles(time_step_multiplicator);
-		for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue();
-		for(uint d=0u; d<get_D(); d++) lbm[d]->increment_time_step(time_step_multiplicator);
+		for(uint d=D0; d<D1; d++) lbm[d]->enqueue_integrate_particles(time_step_multiplicator);
+		for(uint d=D0; d<D1; d++) lbm[d]->finish_queue();
+		for(uint d=D0; d<D1; d++) lbm[d]->increment_time_step(time_step_multiplicator);
 		fx3d::info.update(clock.stop());
 	}
 }
@@ -1007,12 +1866,19 @@ void LBM::write_status(const string& path) { // write LBM status report to a .tx
 }
 
 void LBM::voxelize_mesh_on_device(const Mesh* mesh, const uchar flag, const float3& rotation_center, const float3& linear_velocity, const float3& rotational_velocity) { // voxelize triangle mesh
-	if(get_D()==1u) {
-		lbm[0]->voxelize_mesh_on_device(mesh, flag, rotation_center, linear_velocity, rotational_velocity); // if this crashes on Windows, create a TdrDelay 32-bit DWORD with decimal value 300 in Computer\HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Control\GraphicsDrivers
+	if(out_of_core()) { // slabs take turns in device memory, so they are voxelized one after the other, moving boundaries are marked by kernel_initialize
+		if(initialized) print_error("Out-of-core simulations can only voxelize meshes before the simulation starts.");
+		cycle_slabs([&](const uint d) {
+			lbm[d]->voxelize_mesh_on_device(mesh, flag, rotation_center, linear_velocity, rotational_velocity);
+		});
+		return;
+	}
+	if(D1-D0==1u) {
+		lbm[D0]->voxelize_mesh_on_device(mesh, flag, rotation_center, linear_velocity, rotational_velocity); // if this crashes on Windows, create a TdrDelay 32-bit DWORD with decimal value 300 in Computer\HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Control\GraphicsDrivers
 	} else {
-		thread* threads=new thread[get_D()]; for(uint d=0u; d<get_D(); d++) threads[d]=thread([=]() {
+		thread* threads=new thread[get_D()]; for(uint d=D0; d<D1; d++) threads[d]=thread([=]() {
 			lbm[d]->voxelize_mesh_on_device(mesh, flag, rotation_center, linear_velocity, rotational_velocity);
-		}); for(uint d=0u; d<get_D(); d++) threads[d].join(); delete[] threads;
+		}); for(uint d=D0; d<D1; d++) threads[d].join(); delete[] threads;
 	}
 	if (Settings::IsFeatureEnabled(Feature::MOVING_BOUNDARIES))
 	{
@@ -1025,8 +1891,9 @@ void LBM::voxelize_mesh_on_device(const Mesh* mesh, const uchar flag, const floa
 	}
 }
 void LBM::unvoxelize_mesh_on_device(const Mesh* mesh, const uchar flag) { // remove voxelized triangle mesh from LBM grid by removing all flags in mesh bounding box (only required when bounding box size changes during re-voxelization)
-	for(uint d=0u; d<get_D(); d++) lbm[d]->enqueue_unvoxelize_mesh_on_device(mesh, flag);
-	for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue();
+	if(out_of_core()) print_error("Out-of-core simulations can't remove meshes in device memory, reset the flags in host memory instead.");
+	for(uint d=D0; d<D1; d++) lbm[d]->enqueue_unvoxelize_mesh_on_device(mesh, flag);
+	for(uint d=D0; d<D1; d++) lbm[d]->finish_queue();
 }
 void LBM::write_mesh_to_vtk(const Mesh* mesh, const string& path) const { // write mesh to binary .vtk file
 	const string header_1 = "# vtk DataFile Version 3.0\nData\nBINARY\nDATASET POLYDATA\nPOINTS "+to_string(3u*mesh->triangle_number)+" float\n";
@@ -1147,9 +2014,12 @@ int* LBM::Graphics::draw_frame() {
 	if (!Settings::IsFeatureEnabled(Feature::UPDATE_FIELDS))
 	{
 		if(visualization_modes&(VIS_FIELD|VIS_STREAMLINES|VIS_Q_CRITERION)) {
-			for(uint d=0u; d<lbm->get_D(); d++) lbm->lbm[d]->enqueue_update_fields(); // only call update_fields() if the time step has changed since the last rendered frame
+			for(uint d=lbm->D0; d<lbm->D1; d++) lbm->lbm[d]->enqueue_update_fields(); // only call update_fields() if the time step has changed since the last rendered frame
 		}
 	}
+#if !defined(INTERACTIVE_GRAPHICS)&&!defined(INTERACTIVE_GRAPHICS_ASCII)
+	lbm->update_halo_rho_u_flags(); // Q-criterion and streamlines read u in the halo, without interactive graphics draw_frame() runs between time steps, so it can trigger the exchange itself
+#endif // !INTERACTIVE_GRAPHICS_ASCII && !INTERACTIVE_GRAPHICS
 	if(key_1) { visualization_modes = (visualization_modes&~0b11)|(((visualization_modes&0b11)+1)%4); key_1 = false; }
 	if(key_2) { visualization_modes ^= VIS_FIELD        ; key_2 = false; }
 	if(key_3) { visualization_modes ^= VIS_STREAMLINES  ; key_3 = false; }
@@ -1173,11 +2043,11 @@ int* LBM::Graphics::draw_frame() {
 		if(key_E) { slice_z = clamp(slice_z+1, 0, (int)lbm->get_Nz()-1); key_E = false; }
 	}
 	bool new_frame = true;
-	for(uint d=0u; d<lbm->get_D(); d++) new_frame = new_frame && lbm->lbm[d]->graphics.enqueue_draw_frame(visualization_modes, slice_mode, slice_x, slice_y, slice_z);
-	for(uint d=0u; d<lbm->get_D(); d++) lbm->lbm[d]->finish_queue();
-	int* bitmap = lbm->lbm[0]->graphics.get_bitmap();
-	int* zbuffer = lbm->lbm[0]->graphics.get_zbuffer();
-	for(uint d=1u; d<lbm->get_D()&&new_frame; d++) {
+	for(uint d=lbm->D0; d<lbm->D1; d++) new_frame = new_frame && lbm->lbm[d]->graphics.enqueue_draw_frame(visualization_modes, slice_mode, slice_x, slice_y, slice_z);
+	for(uint d=lbm->D0; d<lbm->D1; d++) lbm->lbm[d]->finish_queue();
+	int* bitmap = lbm->lbm[lbm->D0]->graphics.get_bitmap(); // in multi-process runs every process only shows its own domains
+	int* zbuffer = lbm->lbm[lbm->D0]->graphics.get_zbuffer();
+	for(uint d=lbm->D0+1u; d<lbm->D1&&new_frame; d++) {
 		const int* bitmap_d = lbm->lbm[d]->graphics.get_bitmap(); // each domain renders its own frame
 		const int* zbuffer_d = lbm->lbm[d]->graphics.get_zbuffer();
 		for(uint i=0u; i<fx3d::GraphicsSettings::GetCamera().width*fx3d::GraphicsSettings::GetCamera().height; i++) {
@@ -1295,11 +2165,13 @@ void LBM_Domain::allocate_transfer(Device& device) { // allocate all memory for
 	if(Dy>1u) Amax = max(Amax, (ulong)Nz*(ulong)Nx); // Ay
 	if(Dz>1u) Amax = max(Amax, (ulong)Nx*(ulong)Ny); // Az
 
-	transfer_buffer_p = Memory<char>(device, Amax, max(Settings::GetVSetTransfer()*(uint)sizeof(fpxx), 17u)); // only allocate one set of transfer buffers in plus/minus directions, for all x/y/z transfers
-	transfer_buffer_m = Memory<char>(device, Amax, max(Settings::GetVSetTransfer()*(uint)sizeof(fpxx), 17u));
+	transfer_buffer_p = Memory<char>(device, Amax, transfer_bytes_max()); // only allocate one set of transfer buffers in plus/minus directions, for all x/y/z transfers
+	transfer_buffer_m = Memory<char>(device, Amax, transfer_bytes_max());
 
 	kernel_transfer[enum_transfer_field::fi              ][0] = Kernel(device, 0u, "transfer_extract_fi"              , 0u, t, transfer_buffer_p, transfer_buffer_m, fi);
 	kernel_transfer[enum_transfer_field::fi              ][1] = Kernel(device, 0u, "transfer__insert_fi"              , 0u, t, transfer_buffer_p, transfer_buffer_m, fi);
+	add_ddf_buffers(kernel_transfer[enum_transfer_field::fi][0], fi_split);
+	add_ddf_buffers(kernel_transfer[enum_transfer_field::fi][1], fi_split);
 	kernel_transfer[enum_transfer_field::rho_u_flags     ][0] = Kernel(device, 0u, "transfer_extract_rho_u_flags"     , 0u, t, transfer_buffer_p, transfer_buffer_m, rho, u, flags);
 	kernel_transfer[enum_transfer_field::rho_u_flags     ][1] = Kernel(device, 0u, "transfer__insert_rho_u_flags"     , 0u, t, transfer_buffer_p, transfer_buffer_m, rho, u, flags);
 	if (Settings::IsFeatureEnabled(Feature::SURFACE))
@@ -1313,6 +2185,8 @@ void LBM_Domain::allocate_transfer(Device& device) { // allocate all memory for
 	{
 		kernel_transfer[enum_transfer_field::gi              ][0] = Kernel(device, 0u, "transfer_extract_gi"              , 0u, t, transfer_buffer_p, transfer_buffer_m, gi);
 		kernel_transfer[enum_transfer_field::gi              ][1] = Kernel(device, 0u, "transfer__insert_gi"              , 0u, t, transfer_buffer_p, transfer_buffer_m, gi);
+		add_ddf_buffers(kernel_transfer[enum_transfer_field::gi][0], gi_split);
+		add_ddf_buffers(kernel_transfer[enum_transfer_field::gi][1], gi_split);
 	}
 }
 
@@ -1327,46 +2201,90 @@ void LBM_Domain::enqueue_transfer_extract_field(Kernel& kernel_transfer_extract_
 	transfer_buffer_m.enqueue_read_from_device(0ull, kernel_transfer_extract_field.range()*(ulong)bytes_per_cell); // PCIe copy (-)
 }
 void LBM_Domain::enqueue_transfer_insert_field(Kernel& kernel_transfer_insert_field, const uint direction, const uint bytes_per_cell) {
+	enqueue_transfer_insert_field(kernel_transfer_insert_field, direction, bytes_per_cell, get_t());
+}
+void LBM_Domain::enqueue_transfer_insert_field(Kernel& kernel_transfer_insert_field, const uint direction, const uint bytes_per_cell, const ulong t) { // insert halo data that was extracted at time step t, only the parity of t matters
 	kernel_transfer_insert_field.set_ranges(get_area(direction)); // direction: x=0, y=1, z=2
 	transfer_buffer_p.enqueue_write_to_device(0ull, kernel_transfer_insert_field.range()*(ulong)bytes_per_cell); // PCIe copy (+)
 	transfer_buffer_m.enqueue_write_to_device(0ull, kernel_transfer_insert_field.range()*(ulong)bytes_per_cell); // PCIe copy (-)
-	kernel_transfer_insert_field.set_parameters(0u, direction, get_t()).enqueue_run(); // selective in-VRAM copy
+	kernel_transfer_insert_field.set_parameters(0u, direction, t).enqueue_run(); // selective in-VRAM copy
+}
+void LBM_Domain::enqueue_slab_upload() { // out-of-core: write all state fields of this slab from host memory into its device buffers
+	for_each_state_field([&](auto& memory, const bool, const bool, const uint, const uint) {
+		memory.enqueue_write_to_device();
+	});
+}
+void LBM_Domain::enqueue_slab_download() { // out-of-core: read all state fields of this slab from its device buffers back into host memory
+	for_each_state_field([&](auto& memory, const bool, const bool, const uint, const uint) {
+		memory.enqueue_read_from_device();
+	});
+}
+void LBM_Domain::enqueue_slab_insert_fi() { // out-of-core: the DDF halo was extracted in the previous time step, after stream_collide with t-1, and is inserted right before the next stream_collide
+	enqueue_transfer_insert_field(kernel_transfer[enum_transfer_field::fi][1], 2u, transfer_bytes_fi(), t-1ull); // for t=0, t-1 wraps around to an odd time step, same as in initialize()
 }
 void LBM::communicate_field(const enum_transfer_field field, const uint bytes_per_cell) {
-	if(Dx>1u) { // communicate in x-direction
-		for(uint d=0u; d<get_D(); d++) lbm[d]->enqueue_transfer_extract_field(lbm[d]->kernel_transfer[field][0], 0u, bytes_per_cell); // selective in-VRAM copy (x) + PCIe copy
-		for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue(); // domain synchronization barrier
-		for(uint d=0u; d<get_D(); d++) {
-			const uint x=(d%(Dx*Dy))%Dx, y=(d%(Dx*Dy))/Dx, z=d/(Dx*Dy), dxp=((x+1u)%Dx)+(y+z*Dy)*Dx; // d = x+(y+z*Dy)*Dx
-			lbm[d]->transfer_buffer_p.exchange_host_buffer(lbm[dxp]->transfer_buffer_m.exchange_host_buffer(lbm[d]->transfer_buffer_p.data())); // CPU pointer swaps
-		}
-		for(uint d=0u; d<get_D(); d++) lbm[d]-> enqueue_transfer_insert_field(lbm[d]->kernel_transfer[field][1], 0u, bytes_per_cell); // PCIe copy + selective in-VRAM copy (x)
-	}
-	if(Dy>1u) { // communicate in y-direction
-		for(uint d=0u; d<get_D(); d++) lbm[d]->enqueue_transfer_extract_field(lbm[d]->kernel_transfer[field][0], 1u, bytes_per_cell); // selective in-VRAM copy (y) + PCIe copy
-		for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue(); // domain synchronization barrier
-		for(uint d=0u; d<get_D(); d++) {
-			const uint x=(d%(Dx*Dy))%Dx, y=(d%(Dx*Dy))/Dx, z=d/(Dx*Dy), dyp=x+(((y+1u)%Dy)+z*Dy)*Dx; // d = x+(y+z*Dy)*Dx
-			lbm[d]->transfer_buffer_p.exchange_host_buffer(lbm[dyp]->transfer_buffer_m.exchange_host_buffer(lbm[d]->transfer_buffer_p.data())); // CPU pointer swaps
+	const uint Ds[3] = { Dx, Dy, Dz };
+	for(uint direction=0u; direction<3u; direction++) { // communicate in x-, y- and z-direction
+		if(Ds[direction]==1u) continue;
+		for(uint d=D0; d<D1; d++) lbm[d]->enqueue_transfer_extract_field(lbm[d]->kernel_transfer[field][0], direction, bytes_per_cell); // selective in-VRAM copy + PCIe copy
+		for(uint d=D0; d<D1; d++) lbm[d]->finish_queue(); // domain synchronization barrier
+		exchange_transfer_buffers(direction, bytes_per_cell);
+		for(uint d=D0; d<D1; d++) lbm[d]-> enqueue_transfer_insert_field(lbm[d]->kernel_transfer[field][1], direction, bytes_per_cell); // PCIe copy + selective in-VRAM copy
+	}
+	if(halo_width()>1u&&field!=enum_transfer_field::fi&&field!=enum_transfer_field::gi) for(uint d=D0; d<D1; d++) lbm[d]->invalidate_boundary_list(); // inner layers of wide halos are computed locally and can be on the boundary list
+}
+void LBM::exchange_transfer_buffers(const uint direction, const uint bytes_per_cell) { // hand the extracted halo data in host memory over to the neighboring domains, all extract copies have to be finished
+	for(uint d=0u; d<get_D(); d++) { // every process visits the domain pairs in the same order, so exchanges with other processes match up
+		const uint x=(d%(Dx*Dy))%Dx, y=(d%(Dx*Dy))/Dx, z=d/(Dx*Dy); // d = x+(y+z*Dy)*Dx
+		const uint dp = direction==0u ? ((x+1u)%Dx)+(y+z*Dy)*Dx : direction==1u ? x+(((y+1u)%Dy)+z*Dy)*Dx : x+(y+((z+1u)%Dz)*Dy)*Dx; // neighbor in positive direction
+		if(lbm[d]!=nullptr&&lbm[dp]!=nullptr) {
+			lbm[d]->transfer_buffer_p.exchange_host_buffer(lbm[dp]->transfer_buffer_m.exchange_host_buffer(lbm[d]->transfer_buffer_p.data())); // CPU pointer swaps
+		} else if(lbm[d]!=nullptr||lbm[dp]!=nullptr) { // one of the two domains belongs to another process
+			LBM_Domain* local = lbm[d]!=nullptr ? lbm[d] : lbm[dp];
+			Memory<char>& buffer = lbm[d]!=nullptr ? local->transfer_buffer_p : local->transfer_buffer_m;
+			transport->exchange(get_domain_process(lbm[d]!=nullptr ? dp : d), buffer.data(), halo_buffer, local->get_area(direction)*(ulong)bytes_per_cell); // shared memory or TCP copy
+			halo_buffer = buffer.exchange_host_buffer(halo_buffer); // received data takes the place of the sent data, same as the CPU pointer swap
 		}
-		for(uint d=0u; d<get_D(); d++) lbm[d]-> enqueue_transfer_insert_field(lbm[d]->kernel_transfer[field][1], 1u, bytes_per_cell); // PCIe copy + selective in-VRAM copy (y)
-	}
-	if(Dz>1u) { // communicate in z-direction
-		for(uint d=0u; d<get_D(); d++) lbm[d]->enqueue_transfer_extract_field(lbm[d]->kernel_transfer[field][0], 2u, bytes_per_cell); // selective in-VRAM copy (z) + PCIe copy
-		for(uint d=0u; d<get_D(); d++) lbm[d]->finish_queue(); // domain synchronization barrier
-		for(uint d=0u; d<get_D(); d++) {
-			const uint x=(d%(Dx*Dy))%Dx, y=(d%(Dx*Dy))/Dx, z=d/(Dx*Dy), dzp=x+(y+((z+1u)%Dz)*Dy)*Dx; // d = x+(y+z*Dy)*Dx
-			lbm[d]->transfer_buffer_p.exchange_host_buffer(lbm[dzp]->transfer_buffer_m.exchange_host_buffer(lbm[d]->transfer_buffer_p.data())); // CPU pointer swaps
-		}
-		for(uint d=0u; d<get_D(); d++) lbm[d]-> enqueue_transfer_insert_field(lbm[d]->kernel_transfer[field][1], 2u, bytes_per_cell); // PCIe copy + selective in-VRAM copy (z)
+	}
+}
+uint LBM::get_domain_process(const uint d) const { // returns the rank of the process that owns domain d, process r owns domains r*D/P to (r+1)*D/P-1
+	if(transport==nullptr) return 0u;
+	const ulong D=(ulong)get_D(), P=(ulong)transport->get_size();
+	uint rank = 0u;
+	while((ulong)(rank+1u)<P&&(ulong)(rank+1u)*D/P<=(ulong)d) rank++;
+	return rank;
+}
+void LBM::allocate_transfer_host_buffers() { // host transfer buffers move between domains in every communication, so all of them need the size for the largest domain side
+	const uint W=halo_width(), Hx=(Dx>1u)*W, Hy=(Dy>1u)*W, Hz=(Dz>1u)*W; // halo offsets
+	uint Lx=0u, Ly=0u, Lz=0u; // largest domain dimensions including halo
+	for(uint x=0u; x<Dx; x++) Lx = max(Lx, get_domain_Nx(x)+2u*Hx);
+	for(uint y=0u; y<Dy; y++) Ly = max(Ly, get_domain_Ny(y)+2u*Hy);
+	for(uint z=0u; z<Dz; z++) Lz = max(Lz, get_domain_Nz(z)+2u*Hz);
+	ulong Amax = 0ull; // same as in LBM_Domain::allocate_transfer(), but over all domains
+	if(Dx>1u) Amax = max(Amax, (ulong)Ly*(ulong)Lz);
+	if(Dy>1u) Amax = max(Amax, (ulong)Lz*(ulong)Lx);
+	if(Dz>1u) Amax = max(Amax, (ulong)Lx*(ulong)Ly);
+	const ulong capacity = Amax*(ulong)transfer_bytes_max();
+	for(uint d=D0; d<D1; d++) {
+		const Host_Memory_Policy& policy = lbm[d]->get_device().info.host_policy;
+		host_free((void*)lbm[d]->transfer_buffer_p.exchange_host_buffer(host_allocate<char>(capacity, policy)));
+		host_free((void*)lbm[d]->transfer_buffer_m.exchange_host_buffer(host_allocate<char>(capacity, policy)));
+	}
+	if(transport!=nullptr) {
+		host_free((void*)halo_buffer);
+		halo_buffer = host_allocate<char>(capacity, lbm[D0]->get_device().info.host_policy);
 	}
 }
 
 void LBM::communicate_fi() {
-	communicate_field(enum_transfer_field::fi, Settings::GetVSetTransfer()*sizeof(fpxx));
+	communicate_field(enum_transfer_field::fi, transfer_bytes_fi());
 }
 void LBM::communicate_rho_u_flags() {
-	communicate_field(enum_transfer_field::rho_u_flags, 17u);
+	communicate_field(enum_transfer_field::rho_u_flags, transfer_bytes_rho_u_flags());
+	halo_rho_u_flags_stale = false;
+}
+void LBM::update_halo_rho_u_flags() { // demand-driven rho/u/flags halo exchange
+	if(halo_rho_u_flags_stale&&!out_of_core()) communicate_rho_u_flags(); // out-of-core, the transfer buffers hold the pending DDF halo
 }
 // #ifdef SURFACE
 void LBM::communicate_flags() {
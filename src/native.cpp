@@ -0,0 +1,873 @@
+#include <utils/opencl.hpp> // native CPU backend: C++ implementation of the core LBM kernels in kernel.cpp, with the same order of floating-point operations, so FP32 results are bit-identical to OpenCL with STRICT_MATH
+#include <utils/defines.hpp> // FP16S/FP16C, TYPE_S/E/T/G
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <fstream>
+#ifdef _WIN32
+#include <Windows.h> // GlobalMemoryStatusEx()
+#else // Linux
+#include <unistd.h> // sysconf()
+#endif // Linux
+
+constexpr uint lanes = 16u; // lattice points that are processed together, arrays are [direction][lane] so that the arithmetic vectorizes over lanes (one AVX-512 or two AVX2 registers)
+constexpr uchar TYPE_MS=0x03, TYPE_BO=0x03, TYPE_SU=0x38; // same as in LBM_Domain::device_defines(), single flags are in defines.hpp
+
+class Native_Thread_Pool { // persistent worker threads, creating threads for every kernel call would take longer than small kernels
+private:
+	vector<thread> workers;
+	std::mutex mutex, dispatch; // dispatch serializes kernel calls from different host threads
+	std::condition_variable start, done;
+	std::function<void(const uint, const uint)> task; // (thread index, number of threads)
+	ulong generation = 0ull; // counts dispatched tasks, so workers can tell a new task from a spurious wakeup
+	uint running = 0u; // workers that have not finished the current task yet
+	bool quit = false;
+	inline void loop(const uint i) {
+		ulong seen = 0ull;
+		while(true) {
+			std::function<void(const uint, const uint)> function;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				start.wait(lock, [&]() { return quit||generation!=seen; });
+				if(quit) return;
+				seen = generation;
+				function = task;
+			}
+			function(i, size());
+			std::lock_guard<std::mutex> lock(mutex);
+			if(--running==0u) done.notify_one();
+		}
+	}
+public:
+	inline Native_Thread_Pool() {
+		const uint T = max(1u, (uint)thread::hardware_concurrency());
+		for(uint i=1u; i<T; i++) workers.push_back(thread([this, i]() { loop(i); })); // the calling thread is thread 0
+	}
+	inline ~Native_Thread_Pool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		start.notify_all();
+		for(uint i=0u; i<(uint)workers.size(); i++) workers[i].join();
+	}
+	inline uint size() const { return (uint)workers.size()+1u; }
+	inline void run(const std::function<void(const uint, const uint)>& function) { // returns when all threads have finished
+		std::lock_guard<std::mutex> lock_dispatch(dispatch);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = function;
+			running = (uint)workers.size();
+			generation++;
+		}
+		start.notify_all();
+		function(0u, size());
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&]() { return running==0u; });
+	}
+};
+Native_Thread_Pool& thread_pool() { // created on first use, so listing devices doesn't start any threads
+	static Native_Thread_Pool pool;
+	return pool;
+}
+void run_native_threads(const std::function<void(const uint, const uint)>& function) {
+	thread_pool().run(function);
+}
+
+class Native_Program {
+private:
+	std::map<string, string> defines; // name -> value of all #define lines of the OpenCL C code
+	inline bool is_defined(const string& name) const { return defines.count(name)>0u; }
+	inline const string& get(const string& name) const {
+		const auto define = defines.find(name);
+		if(define==defines.end()) print_error("Native C++ CPU backend is missing \"#define "+name+"\" in the OpenCL C code.");
+		return define->second;
+	}
+	inline uint get_uint(const string& name) const { return (uint)std::stoull(get(name), nullptr, 0); } // stops at "u"/"ul" suffix
+	inline ulong get_ulong(const string& name) const { return std::stoull(get(name), nullptr, 0); }
+	inline float get_float(const string& name) const { // "0.5f" or "(1.0f/3.0f)", parsed and rounded the same way as by the OpenCL C compiler
+		const string value = trim(replace(replace(get(name), "(", ""), ")", ""));
+		const size_t slash = value.find('/');
+		if(slash!=string::npos) return std::strtof(value.substr(0u, slash).c_str(), nullptr)/std::strtof(value.substr(slash+1u).c_str(), nullptr);
+		return std::strtof(value.c_str(), nullptr);
+	}
+public:
+	uint Nx=1u, Ny=1u, Nz=1u, Dx=1u, Dy=1u, Dz=1u, Hx=0u, Hy=0u, Hz=0u, W=1u; // local grid, domains, halo offsets and halo width
+	uint Bx=1u, By=1u, Bz=1u; // DDF brick/tile size, only used with DDF_BRICK layout or DDF_MORTON ordering
+	ulong N = 1ull;
+	uint Q=19u, dimensions=3u, transfers=5u; // velocity set
+	float c_max=0.57735027f, w=1.0f; // def_c, def_w
+	int c[3][27]; // velocity set directions as integers for neighbor indices
+	float cf[3][27], wi[27]; // velocity set directions and weights, c(i) and w(i) in kernel.cpp
+	uint projection_terms[27], projection_axis[27][3]; // for odd i, calculate_f_eq() projects u onto c(i) by adding the non-zero components of c(i) from x to z
+	float projection_sign[27][3];
+	uint rho_u_terms[3], rho_u_p[3][13], rho_u_m[3][13]; // calculate_rho_u() sums f[p]-f[m] pairs in ascending order for every axis
+	uint transfer[6][9]; // index_transfer(), DDFs crossing the domain boundary in every direction
+	bool ddf_brick=false, ddf_morton=false, trt=false, volume_force=false, moving_boundaries=false, equilibrium_boundaries=false, update_fields=false, halo_fp16_fi=false, halo_fp16_rho_u=false, halo_wide=false;
+
+	inline Native_Program(const string& opencl_c_code) {
+		std::istringstream lines(opencl_c_code);
+		string line;
+		while(std::getline(lines, line)) {
+			line = trim(line);
+			if(line.rfind("#define ", 0u)!=0u) continue;
+			line = trim(line.substr(8u));
+			const size_t space = line.find(' ');
+			if(space==string::npos) defines[line] = "";
+			else defines[line.substr(0u, space)] = trim(line.substr(space+1u));
+		}
+		const char* unsupported[] = { "SURFACE", "TEMPERATURE", "SUBGRID", "FORCE_FIELD", "PARTICLES" };
+		for(const char* extension : unsupported) if(is_defined(extension)) print_error("The "+string(extension)+" extension is not supported by the native C++ CPU backend. Use an OpenCL device instead.");
+		Nx = get_uint("def_Nx"); Ny = get_uint("def_Ny"); Nz = get_uint("def_Nz"); N = get_ulong("def_N");
+		if(is_defined("INDEX64")) print_error("Domains with 2^32 or more lattice points are not supported by the native C++ CPU backend. Use an OpenCL device or split the lattice into more domains instead.");
+		Dx = get_uint("def_Dx"); Dy = get_uint("def_Dy"); Dz = get_uint("def_Dz");
+		Hx = get_uint("def_Hx"); Hy = get_uint("def_Hy"); Hz = get_uint("def_Hz"); W = get_uint("def_halo_width");
+		Q = get_uint("def_velocity_set"); dimensions = get_uint("def_dimensions"); transfers = get_uint("def_transfers");
+		c_max = get_float("def_c");
+		w = get_float("def_w");
+		ddf_brick = is_defined("DDF_BRICK");
+		ddf_morton = is_defined("DDF_MORTON");
+		if(ddf_brick||ddf_morton) { Bx = get_uint("def_Bx"); By = get_uint("def_By"); Bz = get_uint("def_Bz"); }
+		trt = is_defined("TRT");
+		volume_force = is_defined("VOLUME_FORCE");
+		moving_boundaries = is_defined("MOVING_BOUNDARIES");
+		equilibrium_boundaries = is_defined("EQUILIBRIUM_BOUNDARIES");
+		update_fields = is_defined("UPDATE_FIELDS");
+		halo_fp16_fi = is_defined("HALO_FP16_FI");
+		halo_fp16_rho_u = is_defined("HALO_FP16_RHO_U");
+		halo_wide = is_defined("HALO_WIDE");
+		static const int c_D2Q9[3*9] = {
+			0, 1,-1, 0, 0, 1,-1, 1,-1, // x
+			0, 0, 0, 1,-1, 1,-1,-1, 1, // y
+			0, 0, 0, 0, 0, 0, 0, 0, 0  // z
+		};
+		static const int c_D3Q15[3*15] = {
+			0, 1,-1, 0, 0, 0, 0, 1,-1, 1,-1, 1,-1,-1, 1, // x
+			0, 0, 0, 1,-1, 0, 0, 1,-1, 1,-1,-1, 1, 1,-1, // y
+			0, 0, 0, 0, 0, 1,-1, 1,-1,-1, 1, 1,-1, 1,-1  // z
+		};
+		static const int c_D3Q19[3*19] = {
+			0, 1,-1, 0, 0, 0, 0, 1,-1, 1,-1, 0, 0, 1,-1, 1,-1, 0, 0, // x
+			0, 0, 0, 1,-1, 0, 0, 1,-1, 0, 0, 1,-1,-1, 1, 0, 0, 1,-1, // y
+			0, 0, 0, 0, 0, 1,-1, 0, 0, 1,-1, 1,-1, 0, 0,-1, 1,-1, 1  // z
+		};
+		static const int c_D3Q27[3*27] = {
+			0, 1,-1, 0, 0, 0, 0, 1,-1, 1,-1, 0, 0, 1,-1, 1,-1, 0, 0, 1,-1, 1,-1, 1,-1,-1, 1, // x
+			0, 0, 0, 1,-1, 0, 0, 1,-1, 0, 0, 1,-1,-1, 1, 0, 0, 1,-1, 1,-1, 1,-1,-1, 1, 1,-1, // y
+			0, 0, 0, 0, 0, 1,-1, 0, 0, 1,-1, 1,-1, 0, 0,-1, 1,-1, 1, 1,-1,-1, 1, 1,-1, 1,-1  // z
+		};
+		const int* c_set = Q==9u ? c_D2Q9 : Q==15u ? c_D3Q15 : Q==19u ? c_D3Q19 : Q==27u ? c_D3Q27 : nullptr;
+		if(c_set==nullptr) print_error("Native C++ CPU backend does not support velocity set with "+to_string(Q)+" directions.");
+		const float w_class[4] = { get_float("def_w0"), get_float("def_ws"), Q==15u ? 0.0f : get_float("def_we"), Q==27u||Q==15u ? get_float("def_wc") : 0.0f }; // weight by squared length of c(i)
+		for(uint i=0u; i<Q; i++) {
+			for(uint a=0u; a<3u; a++) {
+				c[a][i] = c_set[a*Q+i];
+				cf[a][i] = (float)c[a][i];
+			}
+			wi[i] = w_class[c[0][i]*c[0][i]+c[1][i]*c[1][i]+c[2][i]*c[2][i]];
+		}
+		for(uint i=1u; i<Q; i+=2u) {
+			projection_terms[i] = 0u;
+			for(uint a=0u; a<3u; a++) {
+				if(c[a][i]==0) continue;
+				projection_axis[i][projection_terms[i]] = a;
+				projection_sign[i][projection_terms[i]] = cf[a][i];
+				projection_terms[i]++;
+			}
+		}
+		for(uint a=0u; a<3u; a++) {
+			rho_u_terms[a] = 0u;
+			for(uint i=1u; i<Q; i+=2u) {
+				if(c[a][i]==0) continue;
+				rho_u_p[a][rho_u_terms[a]] = c[a][i]>0 ? i : i+1u;
+				rho_u_m[a][rho_u_terms[a]] = c[a][i]>0 ? i+1u : i;
+				rho_u_terms[a]++;
+			}
+		}
+		for(uint side=0u; side<2u*dimensions; side++) {
+			const int sign = side%2u ? -1 : 1;
+			uint b = 0u;
+			for(uint i=1u; i<Q; i++) if(c[side/2u][i]==sign) transfer[side][b++] = i;
+			if(b!=transfers) print_error("Native C++ CPU backend found "+to_string(b)+" instead of "+to_string(transfers)+" DDFs crossing the domain boundary.");
+		}
+	}
+
+	inline void coordinates(const uint n, uint& x, uint& y, uint& z) const { // n = x+(y+z*Ny)*Nx
+		const uint t = n%(Nx*Ny);
+		x = t%Nx;
+		y = t/Nx;
+		z = n/(Nx*Ny);
+	}
+	inline uint index(const uint x, const uint y, const uint z) const {
+		return x+(y+z*Ny)*Nx;
+	}
+	inline ulong index_f(const uint n, const uint i) const {
+		if(!ddf_brick&&!ddf_morton) return (ulong)i*N+(ulong)n; // SoA
+		uint x, y, z;
+		coordinates(n, x, y, z);
+		const uint brick = x/Bx+(y/By+z/Bz*(Ny/By))*(Nx/Bx);
+		uint cell = x%Bx+(y%By+z%Bz*By)*Bx;
+		if(ddf_morton) { // same as cell_in_tile() in kernel.cpp
+			cell = 0u;
+			uint k = 0u;
+			for(uint b=1u; b<4u; b<<=1u) {
+				if(b<Bx) cell |= ((x/b)&1u)<<k++;
+				if(b<By) cell |= ((y/b)&1u)<<k++;
+				if(b<Bz) cell |= ((z/b)&1u)<<k++;
+			}
+		}
+		if(ddf_brick) return ((ulong)brick*(ulong)Q+(ulong)i)*(ulong)(Bx*By*Bz)+(ulong)cell; // AoSoA, same as index_tiled() in kernel.cpp
+		return (ulong)i*N+(ulong)brick*(ulong)(Bx*By*Bz)+(ulong)cell; // SoA with lattice points reordered tile by tile
+	}
+	inline bool is_halo(const uint n) const {
+		uint x, y, z;
+		coordinates(n, x, y, z);
+		return (Dx>1u&&(x<Hx||x>=Nx-Hx))||(Dy>1u&&(y<Hy||y>=Ny-Hy))||(Dz>1u&&(z<Hz||z>=Nz-Hz));
+	}
+	inline bool is_halo_outer(const uint n) const {
+		uint x, y, z;
+		coordinates(n, x, y, z);
+		return (Dx>1u&&(x==0u||x>=Nx-1u))||(Dy>1u&&(y==0u||y>=Ny-1u))||(Dz>1u&&(z==0u||z>=Nz-1u));
+	}
+	inline void neighbors(const uint n, uint* j) const { // periodic boundary conditions
+		uint x, y, z;
+		coordinates(n, x, y, z);
+		const uint xn[3] = { (x+Nx-1u)%Nx, x, (x+1u)%Nx }; // indexed by c+1
+		const uint yn[3] = { ((y+Ny-1u)%Ny)*Nx, y*Nx, ((y+1u)%Ny)*Nx };
+		const uint zn[3] = { ((z+Nz-1u)%Nz)*Ny*Nx, z*Ny*Nx, ((z+1u)%Nz)*Ny*Nx };
+		j[0] = n;
+		for(uint i=1u; i<Q; i++) j[i] = xn[c[0][i]+1]+yn[c[1][i]+1]+zn[c[2][i]+1];
+	}
+	inline uint get_area(const uint direction) const {
+		const uint A[3] = { Ny*Nz, Nz*Nx, Nx*Ny };
+		return A[direction];
+	}
+	inline uint index_extract_p(const uint a, const uint direction, const uint l) const {
+		return direction==0u ? index(Nx-W-1u-l, a%Ny, a/Ny) : direction==1u ? index(a/Nz, Ny-W-1u-l, a%Nz) : index(a%Nx, a/Nx, Nz-W-1u-l);
+	}
+	inline uint index_extract_m(const uint a, const uint direction, const uint l) const {
+		return direction==0u ? index(W+l, a%Ny, a/Ny) : direction==1u ? index(a/Nz, W+l, a%Nz) : index(a%Nx, a/Nx, W+l);
+	}
+	inline uint index_insert_p(const uint a, const uint direction, const uint l) const {
+		return direction==0u ? index(Nx-W+l, a%Ny, a/Ny) : direction==1u ? index(a/Nz, Ny-W+l, a%Nz) : index(a%Nx, a/Nx, Nz-W+l);
+	}
+	inline uint index_insert_m(const uint a, const uint direction, const uint l) const {
+		return direction==0u ? index(W-1u-l, a%Ny, a/Ny) : direction==1u ? index(a/Nz, W-1u-l, a%Nz) : index(a%Nx, a/Nx, W-1u-l);
+	}
+};
+
+Native_Program* create_native_program(const string& opencl_c_code) {
+	return new Native_Program(opencl_c_code);
+}
+void delete_native_program(Native_Program* program) {
+	delete program;
+}
+
+
+
+// ################################################## number formats ##################################################
+
+inline float vload_half(const ushort x) { // IEEE-754 FP16 to FP32, exact like vload_half() in OpenCL C
+	const uint s=(uint)(x&0x8000)<<16, e=(x&0x7C00)>>10, m=x&0x03FF;
+	if(e==31u) return as_float(s|0x7F800000|m<<13); // infinity or NaN
+	if(e!=0u) return as_float(s|(e+112u)<<23|m<<13); // normalized
+	const float v = (float)m*5.9604645E-8f; // denormalized, m*2^-24 is exact
+	return s ? -v : v;
+}
+inline ushort vstore_half_rte(const float x) { // FP32 to IEEE-754 FP16 with round-to-nearest-even, like vstore_half_rte() in OpenCL C
+	const uint b=as_uint(x), s=(b>>16)&0x8000, e=(b>>23)&0xFF, m=b&0x007FFFFF;
+	if(e==255u) return (ushort)(s|0x7C00|(m!=0u)*0x0200); // infinity or NaN
+	const int E = (int)e-112; // FP16 exponent
+	if(E>=31) return (ushort)(s|0x7C00); // overflow to infinity
+	if(E>0) { // normalized
+		const uint h=s|(uint)E<<10|m>>13, r=m&0x1FFF; // r = truncated mantissa bits
+		return (ushort)(h+(uint)(r>0x1000||(r==0x1000&&(h&1u)))); // carry into the exponent is correct, also for overflow to infinity
+	}
+	if(E<-10) return (ushort)s; // rounds to zero
+	const uint M=m|0x00800000, shift=(uint)(14-E), h=M>>shift, r=M&((1u<<shift)-1u), half=1u<<(shift-1u); // denormalized
+	return (ushort)(s|(h+(uint)(r>half||(r==half&&(h&1u)))));
+}
+inline ushort float_to_half_custom_rte(const float x) { // float_to_half_custom() from kernel.cpp, without saturation unlike the one in utilities.hpp
+	const uint b = as_uint(x)+0x00000800; // round-to-nearest-even: add last bit after truncated mantissa
+	const uint e = (b&0x7F800000)>>23; // exponent
+	const uint m = b&0x007FFFFF; // mantissa
+	return (ushort)((b&0x80000000)>>16 | (e>112)*((((e-112)<<11)&0x7800)|m>>12) | ((e<113)&&(e>100) ? (((0x007FF800+m)>>(124-e))+1)>>1 : 0u)); // sign : normalized : denormalized
+}
+#if defined(FP16S)
+inline float load(const fpxx* p, const ulong o) { return vload_half(p[o])*3.0517578E-5f; }
+inline void store(fpxx* p, const ulong o, const float x) { p[o] = vstore_half_rte(x*32768.0f); }
+#elif defined(FP16C)
+inline float load(const fpxx* p, const ulong o) { return half_to_float_custom(p[o]); }
+inline void store(fpxx* p, const ulong o, const float x) { p[o] = float_to_half_custom_rte(x); }
+#else // FP32
+inline float load(const fpxx* p, const ulong o) { return p[o]; }
+inline void store(fpxx* p, const ulong o, const float x) { p[o] = x; }
+#endif // FP32
+
+
+
+// ################################################## LBM code ##################################################
+
+struct Cell_Block { // lattice points processed together, lanes past L repeat the last lattice point so that all loops have the full vector length
+	uint L = 0u; // number of valid lanes
+	uint n[lanes];
+	uchar flagsn[lanes];
+	uint j[27][lanes]; // neighbor indices
+	float fhn[27][lanes], feq[27][lanes], Fin[27][lanes]; // local DDFs, equilibrium DDFs, forcing terms
+	float rhon[lanes], uxn[lanes], uyn[lanes], uzn[lanes];
+};
+template<class Select, class Process> void for_each_block(const ulong n0, const ulong n1, Cell_Block& b, const Select& select, const Process& process) { // collect lattice points where select(n) is true into blocks
+	b.L = 0u;
+	for(ulong n=n0; n<n1; n++) {
+		if(!select((uint)n)) continue;
+		b.n[b.L++] = (uint)n;
+		if(b.L==lanes) {
+			process(b);
+			b.L = 0u;
+		}
+	}
+	if(b.L>0u) {
+		for(uint v=b.L; v<lanes; v++) b.n[v] = b.n[b.L-1u];
+		process(b);
+	}
+}
+
+void neighbors(const Native_Program& p, Cell_Block& b) {
+	uint j[27];
+	for(uint v=0u; v<lanes; v++) {
+		p.neighbors(b.n[v], j);
+		for(uint i=0u; i<p.Q; i++) b.j[i][v] = j[i];
+	}
+}
+void load_f(const Native_Program& p, Cell_Block& b, const fpxx* fi, const ulong t) { // Esoteric-Pull
+	for(uint v=0u; v<lanes; v++) {
+		const uint n = b.n[v];
+		b.fhn[0][v] = load(fi, p.index_f(n, 0u));
+		for(uint i=1u; i<p.Q; i+=2u) {
+			b.fhn[i   ][v] = load(fi, p.index_f(n        , t%2ull ? i    : i+1u));
+			b.fhn[i+1u][v] = load(fi, p.index_f(b.j[i][v], t%2ull ? i+1u : i   ));
+		}
+	}
+}
+void store_f(const Native_Program& p, const Cell_Block& b, fpxx* fi, const ulong t) { // Esoteric-Pull
+	for(uint v=0u; v<b.L; v++) {
+		const uint n = b.n[v];
+		store(fi, p.index_f(n, 0u), b.fhn[0][v]);
+		for(uint i=1u; i<p.Q; i+=2u) {
+			store(fi, p.index_f(b.j[i][v], t%2ull ? i+1u : i   ), b.fhn[i   ][v]);
+			store(fi, p.index_f(n        , t%2ull ? i    : i+1u), b.fhn[i+1u][v]);
+		}
+	}
+}
+void apply_moving_boundaries(const Native_Program& p, Cell_Block& b, const float* u, const uchar* flags) { // apply Dirichlet velocity boundaries if necessary (Krueger p.180, rho_solid=1)
+	for(uint v=0u; v<lanes; v++) {
+		if((b.flagsn[v]&TYPE_BO)!=TYPE_MS) continue;
+		for(uint i=1u; i<p.Q; i+=2u) {
+			const float w6 = -6.0f*p.wi[i]; // w(i) = w(i+1) if i is odd
+			uint ji = b.j[i+1u][v];
+			if((flags[ji]&TYPE_BO)==TYPE_S) b.fhn[i   ][v] = std::fma(w6, p.cf[0][i+1u]*u[ji]+p.cf[1][i+1u]*u[p.N+(ulong)ji]+p.cf[2][i+1u]*u[2ull*p.N+(ulong)ji], b.fhn[i   ][v]);
+			ji = b.j[i][v];
+			if((flags[ji]&TYPE_BO)==TYPE_S) b.fhn[i+1u][v] = std::fma(w6, p.cf[0][i   ]*u[ji]+p.cf[1][i   ]*u[p.N+(ulong)ji]+p.cf[2][i   ]*u[2ull*p.N+(ulong)ji], b.fhn[i+1u][v]);
+		}
+	}
+}
+void calculate_rho_u(const Native_Program& p, Cell_Block& b) { // calculate density and velocity fields from fi
+	float* un[3] = { b.uxn, b.uyn, b.uzn };
+	for(uint v=0u; v<lanes; v++) b.rhon[v] = b.fhn[0][v];
+	for(uint i=1u; i<p.Q; i++) for(uint v=0u; v<lanes; v++) b.rhon[v] += b.fhn[i][v];
+	for(uint v=0u; v<lanes; v++) b.rhon[v] += 1.0f; // add 1.0f last to avoid digit extinction effects when summing up fi (perturbation method / DDF-shifting)
+	for(uint a=0u; a<3u; a++) {
+		float* ua = un[a];
+		if(p.rho_u_terms[a]==0u) {
+			for(uint v=0u; v<lanes; v++) ua[v] = 0.0f;
+			continue;
+		}
+		const float* fp = b.fhn[p.rho_u_p[a][0]];
+		const float* fm = b.fhn[p.rho_u_m[a][0]];
+		for(uint v=0u; v<lanes; v++) ua[v] = fp[v]-fm[v]; // alternating + and - for best accuracy
+		for(uint k=1u; k<p.rho_u_terms[a]; k++) {
+			fp = b.fhn[p.rho_u_p[a][k]];
+			fm = b.fhn[p.rho_u_m[a][k]];
+			for(uint v=0u; v<lanes; v++) ua[v] = ua[v]+fp[v]-fm[v];
+		}
+	}
+	for(uint v=0u; v<lanes; v++) {
+		b.uxn[v] = b.uxn[v]/b.rhon[v];
+		b.uyn[v] = b.uyn[v]/b.rhon[v];
+		b.uzn[v] = b.uzn[v]/b.rhon[v];
+	}
+}
+void calculate_f_eq(const Native_Program& p, const float* rho, const float* ux, const float* uy, const float* uz, float (*feq)[lanes]) { // calculate f_equilibrium from density and velocity field (perturbation method / DDF-shifting)
+	float c3[lanes], rhom1[lanes], u3[3][lanes];
+	for(uint v=0u; v<lanes; v++) {
+		c3[v] = -3.0f*(ux[v]*ux[v]+uy[v]*uy[v]+uz[v]*uz[v]); // c3 = -2*sq(u)/(2*sq(c))
+		rhom1[v] = rho[v]-1.0f; // rhom1 is arithmetic optimization to minimize digit extinction
+		u3[0][v] = ux[v]*3.0f;
+		u3[1][v] = uy[v]*3.0f;
+		u3[2][v] = uz[v]*3.0f;
+		feq[0][v] = p.wi[0]*std::fma(rho[v], 0.5f*c3[v], rhom1[v]); // 000 (identical for all velocity sets)
+	}
+	for(uint i=1u; i<p.Q; i+=2u) {
+		const float wi = p.wi[i];
+		const uint terms = p.projection_terms[i];
+		for(uint v=0u; v<lanes; v++) {
+			float ui = p.projection_sign[i][0]*u3[p.projection_axis[i][0]][v]; // ux+uy, ux-uy, -ux+uy+uz, ...
+			for(uint k=1u; k<terms; k++) ui += p.projection_sign[i][k]*u3[p.projection_axis[i][k]][v];
+			const float rhow=wi*rho[v], rhom1w=wi*rhom1[v];
+			feq[i   ][v] = std::fma(rhow, std::fma(0.5f, std::fma(ui, ui, c3[v]),  ui), rhom1w);
+			feq[i+1u][v] = std::fma(rhow, std::fma(0.5f, std::fma(ui, ui, c3[v]), -ui), rhom1w);
+		}
+	}
+}
+void calculate_forcing_terms(const Native_Program& p, Cell_Block& b, const float fx, const float fy, const float fz) { // calculate volume force terms Fin from velocity field (Guo forcing, Krueger p.233f)
+	float uF[lanes];
+	for(uint v=0u; v<lanes; v++) {
+		uF[v] = p.dimensions==2u ? -0.33333334f*std::fma(b.uxn[v], fx, b.uyn[v]*fy) : -0.33333334f*std::fma(b.uxn[v], fx, std::fma(b.uyn[v], fy, b.uzn[v]*fz));
+		b.Fin[0][v] = 9.0f*p.wi[0]*uF[v]; // 000 (identical for all velocity sets)
+	}
+	for(uint i=1u; i<p.Q; i++) {
+		const float cx=p.cf[0][i], cy=p.cf[1][i], cz=p.cf[2][i], cF=cx*fx+cy*fy+cz*fz, w9=9.0f*p.wi[i];
+		for(uint v=0u; v<lanes; v++) b.Fin[i][v] = w9*std::fma(cF, cx*b.uxn[v]+cy*b.uyn[v]+cz*b.uzn[v]+0.33333334f, uF[v]);
+	}
+}
+void apply_force_and_limit(const Native_Program& p, Cell_Block& b, const float fx, const float fy, const float fz, const bool forcing_terms) {
+	if(p.volume_force) {
+		for(uint v=0u; v<lanes; v++) {
+			const float rho2 = 0.5f/b.rhon[v]; // apply external volume force (Guo forcing, Krueger p.233f)
+			b.uxn[v] = clamp(std::fma(fx, rho2, b.uxn[v]), -p.c_max, p.c_max); // limit velocity (for stability purposes)
+			b.uyn[v] = clamp(std::fma(fy, rho2, b.uyn[v]), -p.c_max, p.c_max); // force term: F*dt/(2*rho)
+			b.uzn[v] = clamp(std::fma(fz, rho2, b.uzn[v]), -p.c_max, p.c_max);
+		}
+		if(forcing_terms) calculate_forcing_terms(p, b, fx, fy, fz);
+	} else {
+		for(uint v=0u; v<lanes; v++) {
+			b.uxn[v] = clamp(b.uxn[v], -p.c_max, p.c_max); // limit velocity (for stability purposes)
+			b.uyn[v] = clamp(b.uyn[v], -p.c_max, p.c_max);
+			b.uzn[v] = clamp(b.uzn[v], -p.c_max, p.c_max);
+		}
+		if(forcing_terms) for(uint i=0u; i<p.Q; i++) for(uint v=0u; v<lanes; v++) b.Fin[i][v] = 0.0f;
+	}
+}
+void store_rho_u(const Native_Program& p, const Cell_Block& b, float* rho, float* u) { // update density and velocity fields, except for equilibrium boundaries
+	for(uint v=0u; v<b.L; v++) {
+		if(p.equilibrium_boundaries&&(b.flagsn[v]&TYPE_BO)==TYPE_E) continue;
+		const uint n = b.n[v];
+		rho[               n] = b.rhon[v];
+		u[                 n] = b.uxn[v];
+		u[    p.N+(ulong)n] = b.uyn[v];
+		u[2ull*p.N+(ulong)n] = b.uzn[v];
+	}
+}
+void collide(const Native_Program& p, Cell_Block& b) {
+	const float w = p.w; // LBM relaxation rate w = dt/tau = dt/(nu/c^2+dt/2) = 1/(3*nu+1/2)
+	float (*fhn)[lanes]=b.fhn, (*feq)[lanes]=b.feq, (*Fin)[lanes]=b.Fin;
+	if(!p.trt) { // SRT
+		if(p.volume_force) {
+			const float c_tau = std::fma(w, -0.5f, 1.0f);
+			for(uint i=0u; i<p.Q; i++) for(uint v=0u; v<lanes; v++) Fin[i][v] *= c_tau;
+		}
+		for(uint i=0u; i<p.Q; i++) for(uint v=0u; v<lanes; v++) fhn[i][v] = std::fma(1.0f-w, fhn[i][v], std::fma(w, feq[i][v], Fin[i][v])); // perform collision (SRT)
+	} else { // TRT
+		const float wp = w; // TRT: inverse of "+" relaxation time
+		const float wm = 1.0f/(0.1875f/(1.0f/w-0.5f)+0.5f); // TRT: inverse of "-" relaxation time wm = 1.0f/(0.1875f/(3.0f*nu)+0.5f), nu = (1.0f/w-0.5f)/3.0f;
+		if(p.volume_force) {
+			const float c_taup=std::fma(wp, -0.25f, 0.5f), c_taum=std::fma(wm, -0.25f, 0.5f); // source: https://arxiv.org/pdf/1901.08766.pdf
+			for(uint v=0u; v<lanes; v++) Fin[0][v] = std::fma(c_taup, Fin[0][v]+Fin[0][v], c_taum*(Fin[0][v]-Fin[0][v]));
+			for(uint i=1u; i<p.Q; i+=2u) {
+				for(uint v=0u; v<lanes; v++) {
+					const float Fi=Fin[i][v], Fib=Fin[i+1u][v]; // F_bar is F in inverse direction
+					Fin[i   ][v] = std::fma(c_taup, Fi+Fib, c_taum*(Fi-Fib));
+					Fin[i+1u][v] = std::fma(c_taup, Fib+Fi, c_taum*(Fib-Fi));
+				}
+			}
+		}
+		for(uint v=0u; v<lanes; v++) fhn[0][v] = std::fma(0.5f*wp, feq[0][v]-fhn[0][v]+feq[0][v]-fhn[0][v], std::fma(0.5f*wm, feq[0][v]-feq[0][v]-fhn[0][v]+fhn[0][v], fhn[0][v]+Fin[0][v])); // perform collision (TRT)
+		for(uint i=1u; i<p.Q; i+=2u) {
+			for(uint v=0u; v<lanes; v++) {
+				const float fi=fhn[i][v], fb=fhn[i+1u][v], ei=feq[i][v], eb=feq[i+1u][v]; // fhn and feq in inverse directions
+				fhn[i   ][v] = std::fma(0.5f*wp, ei-fi+eb-fb, std::fma(0.5f*wm, ei-eb-fi+fb, fi+Fin[i   ][v]));
+				fhn[i+1u][v] = std::fma(0.5f*wp, eb-fb+ei-fi, std::fma(0.5f*wm, eb-ei-fb+fi, fb+Fin[i+1u][v]));
+			}
+		}
+	}
+	if(p.equilibrium_boundaries) {
+		for(uint v=0u; v<lanes; v++) {
+			if((b.flagsn[v]&TYPE_BO)==TYPE_E) for(uint i=0u; i<p.Q; i++) fhn[i][v] = feq[i][v]; // just write feq to fhn (no collision)
+		}
+	}
+}
+
+void kernel_initialize(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>&, const ulong n0, const ulong n1) { // initialize LBM
+	fpxx* fi = (fpxx*)buffers[0];
+	const float* rho = (const float*)buffers[1];
+	float* u = (float*)buffers[2];
+	uchar* flags = (uchar*)buffers[3];
+	Cell_Block b;
+	for_each_block(n0, n1, b, [&](const uint n) { return !p.is_halo(n); }, [&](Cell_Block& b) { // don't execute initialize() on halo
+		neighbors(p, b);
+		for(uint v=0u; v<b.L; v++) {
+			const uint n = b.n[v];
+			const uchar flagsn = flags[n];
+			const uchar flagsn_bo = flagsn&TYPE_BO; // extract boundary flags
+			if(flagsn_bo==TYPE_S) { // node is solid
+				bool TYPE_ONLY_S = true; // has only solid neighbors
+				for(uint i=1u; i<p.Q; i++) TYPE_ONLY_S = TYPE_ONLY_S&&(flags[b.j[i][v]]&TYPE_BO)==TYPE_S;
+				if(TYPE_ONLY_S||!p.moving_boundaries) { // reset velocity for solid lattice points with only boundary neighbors, without MOVING_BOUNDARIES for all solid lattice points
+					u[                 n] = 0.0f;
+					u[    p.N+(ulong)n] = 0.0f;
+					u[2ull*p.N+(ulong)n] = 0.0f;
+				}
+			} else if(p.moving_boundaries&&flagsn_bo!=TYPE_E) { // local lattice point is not solid and not equilibrium boundary
+				bool next_to_moving_boundary = false;
+				for(uint i=1u; i<p.Q; i++) {
+					const uint ji = b.j[i][v];
+					next_to_moving_boundary = next_to_moving_boundary||((flags[ji]&TYPE_BO)==TYPE_S&&(u[ji]!=0.0f||u[p.N+(ulong)ji]!=0.0f||u[2ull*p.N+(ulong)ji]!=0.0f));
+				}
+				flags[n] = next_to_moving_boundary ? flagsn|TYPE_MS : flagsn&~TYPE_MS; // mark/unmark nodes next to TYPE_S nodes with velocity!=0 with TYPE_MS
+			}
+		}
+		for(uint v=0u; v<lanes; v++) {
+			const uint n = b.n[v];
+			b.rhon[v] = rho[n];
+			b.uxn[v] = u[n];
+			b.uyn[v] = u[p.N+(ulong)n];
+			b.uzn[v] = u[2ull*p.N+(ulong)n];
+		}
+		calculate_f_eq(p, b.rhon, b.uxn, b.uyn, b.uzn, b.fhn);
+		store_f(p, b, fi, 1ull); // write to fi
+	});
+}
+void kernel_update_moving_boundaries(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>&, const ulong n0, const ulong n1) { // mark/unmark nodes next to TYPE_S nodes with velocity!=0 with TYPE_MS
+	const float* u = (const float*)buffers[0];
+	uchar* flags = (uchar*)buffers[1];
+	uint j[27];
+	for(ulong m=n0; m<n1; m++) {
+		const uint n = (uint)m;
+		if(p.is_halo(n)) continue; // don't execute update_moving_boundaries() on halo
+		const uchar flagsn = flags[n];
+		const uchar flagsn_bo = flagsn&TYPE_BO; // extract boundary flags
+		if(flagsn_bo==TYPE_S||flagsn_bo==TYPE_E||(flagsn&TYPE_T)) continue;
+		p.neighbors(n, j);
+		bool next_to_moving_boundary = false;
+		for(uint i=1u; i<p.Q; i++) {
+			next_to_moving_boundary = next_to_moving_boundary||((u[j[i]]!=0.0f||u[p.N+(ulong)j[i]]!=0.0f||u[2ull*p.N+(ulong)j[i]]!=0.0f)&&(flags[j[i]]&TYPE_BO)==TYPE_S);
+		}
+		flags[n] = next_to_moving_boundary ? flagsn|TYPE_MS : flagsn&~TYPE_MS;
+	}
+}
+void stream_collide(const Native_Program& p, fpxx* fi, float* rho, float* u, const uchar* flags, const ulong t, const float* f, const ulong n0, const ulong n1) { // one LBM time step for lattice points n0 to n1
+	Cell_Block b;
+	for_each_block(n0, n1, b, [&](const uint n) { // don't execute stream_collide() on halo, inner layers of wide halos are computed redundantly to avoid communication
+		const uchar flagsn = flags[n];
+		return !p.is_halo_outer(n)&&(flagsn&TYPE_BO)!=TYPE_S&&(flagsn&TYPE_SU)!=TYPE_G; // if node is solid boundary or gas, skip it
+	}, [&](Cell_Block& b) {
+		for(uint v=0u; v<lanes; v++) b.flagsn[v] = flags[b.n[v]];
+		neighbors(p, b);
+		load_f(p, b, fi, t); // perform streaming (part 2)
+		if(p.moving_boundaries) apply_moving_boundaries(p, b, u, flags);
+		calculate_rho_u(p, b);
+		if(p.equilibrium_boundaries) {
+			for(uint v=0u; v<lanes; v++) {
+				if((b.flagsn[v]&TYPE_BO)!=TYPE_E) continue;
+				const uint n = b.n[v];
+				b.rhon[v] = rho[n]; // apply preset velocity/density
+				b.uxn[v] = u[n];
+				b.uyn[v] = u[p.N+(ulong)n];
+				b.uzn[v] = u[2ull*p.N+(ulong)n];
+			}
+		}
+		apply_force_and_limit(p, b, f[0], f[1], f[2], true);
+		if(p.update_fields) store_rho_u(p, b, rho, u);
+		calculate_f_eq(p, b.rhon, b.uxn, b.uyn, b.uzn, b.feq);
+		collide(p, b);
+		store_f(p, b, fi, t); // perform streaming (part 1)
+	});
+}
+void kernel_stream_collide(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>& constants, const ulong n0, const ulong n1) { // main LBM kernel
+	float f[3];
+	for(uint a=0u; a<3u; a++) std::memcpy((void*)&f[a], (const void*)&constants[5u+a], sizeof(float));
+	stream_collide(p, (fpxx*)buffers[0], (float*)buffers[1], (float*)buffers[2], (const uchar*)buffers[3], constants[4], f, n0, n1);
+}
+void kernel_stream_collide_tiles(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>& constants, const ulong r0, const ulong r1) { // temporal blocking: advance tiles r0 to r1 by several time steps while they stay in cache
+	const fpxx* fi = (const fpxx*)buffers[0];
+	fpxx* fi_next = (fpxx*)buffers[1]; // tiles are written to a separate buffer, as neighboring tiles still read their margin at time step t from fi
+	float* rho = (float*)buffers[2];
+	float* u = (float*)buffers[3];
+	const uchar* flags = (const uchar*)buffers[4];
+	const ulong t = constants[5];
+	float f[3];
+	for(uint a=0u; a<3u; a++) std::memcpy((void*)&f[a], (const void*)&constants[6u+a], sizeof(float));
+	const uint steps=(uint)constants[9], T=(uint)constants[10]; // time steps per pass, tile edge length
+	const uint N[3]={ p.Nx, p.Ny, p.Nz }, tiles[3]={ (p.Nx+T-1u)/T, (p.Ny+T-1u)/T, (p.Nz+T-1u)/T };
+	Native_Program lp = p; // tile plus margin as a lattice of its own, with the same kernel code as for the whole domain
+	lp.ddf_brick = lp.ddf_morton = false; // SoA layout in the tile buffer
+	vector<fpxx> lfi;
+	vector<float> lrho, lu;
+	vector<uchar> lflags;
+	vector<uint> gn; // domain index of every tile lattice point
+	const auto writes_rho_u = [&](const uchar flagsn) { // same lattice points as in stream_collide() and store_rho_u(), flags don't change during a temporal block
+		const uchar flagsn_bo = flagsn&TYPE_BO;
+		return p.update_fields&&flagsn_bo!=TYPE_S&&(flagsn&TYPE_SU)!=TYPE_G&&!(p.equilibrium_boundaries&&flagsn_bo==TYPE_E);
+	};
+	for(ulong r=r0; r<r1; r++) {
+		const uint c[3] = { (uint)(r%(ulong)tiles[0]), (uint)((r/(ulong)tiles[0])%(ulong)tiles[1]), (uint)(r/((ulong)tiles[0]*(ulong)tiles[1])) }; // r = x+(y+z*tiles_y)*tiles_x
+		uint o[3], l[3], m[3]; // tile origin, tile size, margin
+		for(uint a=0u; a<3u; a++) {
+			o[a] = c[a]*T;
+			l[a] = min(T, N[a]-o[a]);
+			m[a] = l[a]==N[a] ? 0u : steps+1u; // the error from the unknown outside creeps inwards by one layer per time step, periodic axes that fit into one tile need no margin
+		}
+		lp.Nx=l[0]+2u*m[0]; lp.Ny=l[1]+2u*m[1]; lp.Nz=l[2]+2u*m[2]; lp.N=(ulong)lp.Nx*(ulong)lp.Ny*(ulong)lp.Nz;
+		lp.Dx=m[0]>0u ? 2u : 1u; lp.Dy=m[1]>0u ? 2u : 1u; lp.Dz=m[2]>0u ? 2u : 1u; // is_halo_outer() then skips the outermost margin layer, which has no neighbors to stream from
+		lfi.resize(lp.N*(ulong)p.Q); lrho.resize(lp.N); lu.resize(3ull*lp.N); lflags.resize(lp.N); gn.resize(lp.N);
+		for(uint z=0u; z<lp.Nz; z++) for(uint y=0u; y<lp.Ny; y++) for(uint x=0u; x<lp.Nx; x++) { // gather tile with margin, periodic like neighbors()
+			const uint n=lp.index(x, y, z), g=p.index((o[0]+x+p.Nx-m[0])%p.Nx, (o[1]+y+p.Ny-m[1])%p.Ny, (o[2]+z+p.Nz-m[2])%p.Nz);
+			gn[n] = g;
+			for(uint i=0u; i<p.Q; i++) lfi[lp.index_f(n, i)] = fi[p.index_f(g, i)]; // DDFs are copied in place, independent of time step parity
+			lflags[n] = flags[g];
+			if(writes_rho_u(lflags[n])) { // rho/u of these lattice points are only outputs, and other threads may be writing them back right now, so they are not read
+				lrho[n] = 1.0f;
+				for(uint a=0u; a<3u; a++) lu[(ulong)a*lp.N+(ulong)n] = 0.0f;
+			} else { // boundary rho/u are inputs and are never written back
+				lrho[n] = rho[g];
+				for(uint a=0u; a<3u; a++) lu[(ulong)a*lp.N+(ulong)n] = u[(ulong)a*p.N+(ulong)g];
+			}
+		}
+		for(uint s=0u; s<steps; s++) stream_collide(lp, lfi.data(), lrho.data(), lu.data(), lflags.data(), t+(ulong)s, f, 0ull, lp.N);
+		for(uint z=m[2]; z<m[2]+l[2]; z++) for(uint y=m[1]; y<m[1]+l[1]; y++) for(uint x=m[0]; x<m[0]+l[0]; x++) { // write back the tile without margin
+			const uint n=lp.index(x, y, z), g=gn[n];
+			for(uint i=0u; i<p.Q; i++) fi_next[p.index_f(g, i)] = lfi[lp.index_f(n, i)];
+			if(writes_rho_u(lflags[n])) { // only tile interiors write rho/u, and only where no tile reads them
+				rho[g] = lrho[n];
+				for(uint a=0u; a<3u; a++) u[(ulong)a*p.N+(ulong)g] = lu[(ulong)a*lp.N+(ulong)n];
+			}
+		}
+	}
+}
+void kernel_update_fields(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>& constants, const ulong n0, const ulong n1) { // calculate fields from DDFs
+	const fpxx* fi = (const fpxx*)buffers[0];
+	float* rho = (float*)buffers[1];
+	float* u = (float*)buffers[2];
+	const uchar* flags = (const uchar*)buffers[3];
+	const ulong t = constants[4];
+	float f[3];
+	for(uint a=0u; a<3u; a++) std::memcpy((void*)&f[a], (const void*)&constants[5u+a], sizeof(float));
+	Cell_Block b;
+	for_each_block(n0, n1, b, [&](const uint n) { // don't execute update_fields() on halo
+		const uchar flagsn = flags[n];
+		return !p.is_halo(n)&&(flagsn&TYPE_BO)!=TYPE_S&&(flagsn&TYPE_SU)!=TYPE_G; // don't update fields for boundary or gas lattice points
+	}, [&](Cell_Block& b) {
+		for(uint v=0u; v<lanes; v++) b.flagsn[v] = flags[b.n[v]];
+		neighbors(p, b);
+		load_f(p, b, fi, t); // perform streaming (part 2)
+		if(p.moving_boundaries) apply_moving_boundaries(p, b, u, flags);
+		calculate_rho_u(p, b);
+		apply_force_and_limit(p, b, f[0], f[1], f[2], false);
+		store_rho_u(p, b, rho, u);
+	});
+}
+
+void store_halo_fi(const Native_Program& p, const ulong b, const fpxx x, void* transfer_buffer) {
+	if(p.halo_fp16_fi) ((ushort*)transfer_buffer)[b] = vstore_half_rte((float)x*32768.0f); // pack FP32 DDF into the scaled FP16 format of FP16S
+	else ((fpxx*)transfer_buffer)[b] = x; // fpxx allows direct copying without decompression+compression
+}
+fpxx load_halo_fi(const Native_Program& p, const ulong b, const void* transfer_buffer) {
+	if(p.halo_fp16_fi) return (fpxx)(vload_half(((const ushort*)transfer_buffer)[b])*3.0517578E-5f); // unpack scaled FP16 DDF
+	else return ((const fpxx*)transfer_buffer)[b];
+}
+void kernel_transfer_extract_fi(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>& constants, const ulong a0, const ulong a1) {
+	const uint direction = (uint)constants[0];
+	const ulong t = constants[1];
+	void* transfer_buffer[2] = { buffers[2], buffers[3] }; // plus, minus
+	const fpxx* fi = (const fpxx*)buffers[4];
+	const uint A = p.get_area(direction); // A = area of the domain boundary
+	uint j[27];
+	for(ulong m=a0; m<min(a1, (ulong)A); m++) {
+		const uint a = (uint)m; // a = domain area index for each side
+		for(uint s=0u; s<2u; s++) {
+			const uint side = 2u*direction+s;
+			const uint n = s ? p.index_extract_m(a, direction, 0u) : p.index_extract_p(a, direction, 0u);
+			p.neighbors(n, j);
+			for(uint b=0u; b<p.transfers; b++) {
+				const uint i = p.transfer[side][b];
+				const ulong index = p.index_f(i%2u ? j[i] : n, t%2ull ? (i%2u ? i+1u : i-1u) : i); // Esoteric-Pull: standard store, or streaming part 1/2
+				store_halo_fi(p, (ulong)b*A+a, fi[index], transfer_buffer[s]);
+			}
+			if(p.halo_wide) { // the neighbor domain recomputes its inner halo layers locally, so it needs all DDFs stored at these layers
+				for(uint l=0u; l<p.W; l++) {
+					const uint nl = s ? p.index_extract_m(a, direction, l) : p.index_extract_p(a, direction, l);
+					for(uint i=0u; i<p.Q; i++) store_halo_fi(p, (ulong)(p.transfers+l*p.Q+i)*A+a, fi[p.index_f(nl, i)], transfer_buffer[s]); // DDFs are stored in-place, independent of time step parity
+				}
+			}
+		}
+	}
+}
+void kernel_transfer_insert_fi(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>& constants, const ulong a0, const ulong a1) {
+	const uint direction = (uint)constants[0];
+	const ulong t = constants[1];
+	const void* transfer_buffer[2] = { buffers[2], buffers[3] }; // plus, minus
+	fpxx* fi = (fpxx*)buffers[4];
+	const uint A = p.get_area(direction);
+	uint j[27];
+	for(ulong m=a0; m<min(a1, (ulong)A); m++) {
+		const uint a = (uint)m;
+		for(uint s=0u; s<2u; s++) {
+			const uint side = 2u*direction+s;
+			const uint n = s ? p.index_insert_m(a, direction, 0u) : p.index_insert_p(a, direction, 0u);
+			p.neighbors(n, j);
+			for(uint b=0u; b<p.transfers; b++) {
+				const uint i = p.transfer[side][b];
+				const ulong index = p.index_f(i%2u ? n : j[i-1u], t%2ull ? i : (i%2u ? i+1u : i-1u)); // Esoteric-Pull: standard load, or streaming part 2/2
+				fi[index] = load_halo_fi(p, (ulong)b*A+a, transfer_buffer[s]);
+			}
+			if(p.halo_wide) {
+				for(uint l=0u; l<p.W; l++) {
+					const uint nl = s ? p.index_insert_m(a, direction, l) : p.index_insert_p(a, direction, l);
+					for(uint i=0u; i<p.Q; i++) fi[p.index_f(nl, i)] = load_halo_fi(p, (ulong)(p.transfers+l*p.Q+i)*A+a, transfer_buffer[s]);
+				}
+			}
+		}
+	}
+}
+void kernel_transfer_extract_rho_u_flags(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>& constants, const ulong a0, const ulong a1) {
+	const uint direction = (uint)constants[0];
+	char* transfer_buffer[2] = { (char*)buffers[2], (char*)buffers[3] }; // plus, minus
+	const float* rho = (const float*)buffers[4];
+	const float* u = (const float*)buffers[5];
+	const uchar* flags = (const uchar*)buffers[6];
+	const uint A = p.get_area(direction);
+	const ulong B = (ulong)p.W*(ulong)A; // all halo layers are packed like one W times larger area
+	for(ulong m=a0; m<min(a1, (ulong)A); m++) {
+		const uint a = (uint)m;
+		for(uint l=0u; l<p.W; l++) {
+			for(uint s=0u; s<2u; s++) {
+				const uint n = s ? p.index_extract_m(a, direction, l) : p.index_extract_p(a, direction, l);
+				const ulong c = (ulong)l*A+a;
+				if(p.halo_fp16_rho_u) { // rho-1 and u are within [-2, 2], scaling by 2^15 uses the full FP16 range and avoids denormals
+					ushort* buffer = (ushort*)transfer_buffer[s];
+					buffer[    c] = vstore_half_rte((rho[n]-1.0f)*32768.0f);
+					buffer[  B+c] = vstore_half_rte(u[                 n]*32768.0f);
+					buffer[2*B+c] = vstore_half_rte(u[    p.N+(ulong)n]*32768.0f);
+					buffer[3*B+c] = vstore_half_rte(u[2ull*p.N+(ulong)n]*32768.0f);
+					((uchar*)transfer_buffer[s])[8ull*B+c] = flags[n];
+				} else {
+					float* buffer = (float*)transfer_buffer[s];
+					buffer[    c] = rho[n];
+					buffer[  B+c] = u[                 n];
+					buffer[2*B+c] = u[    p.N+(ulong)n];
+					buffer[3*B+c] = u[2ull*p.N+(ulong)n];
+					((uchar*)transfer_buffer[s])[16ull*B+c] = flags[n];
+				}
+			}
+		}
+	}
+}
+void kernel_transfer_insert_rho_u_flags(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>& constants, const ulong a0, const ulong a1) {
+	const uint direction = (uint)constants[0];
+	const char* transfer_buffer[2] = { (const char*)buffers[2], (const char*)buffers[3] }; // plus, minus
+	float* rho = (float*)buffers[4];
+	float* u = (float*)buffers[5];
+	uchar* flags = (uchar*)buffers[6];
+	const uint A = p.get_area(direction);
+	const ulong B = (ulong)p.W*(ulong)A;
+	for(ulong m=a0; m<min(a1, (ulong)A); m++) {
+		const uint a = (uint)m;
+		for(uint l=0u; l<p.W; l++) {
+			for(uint s=0u; s<2u; s++) {
+				const uint n = s ? p.index_insert_m(a, direction, l) : p.index_insert_p(a, direction, l);
+				const ulong c = (ulong)l*A+a;
+				if(p.halo_fp16_rho_u) {
+					const ushort* buffer = (const ushort*)transfer_buffer[s];
+					rho[               n] = std::fma(vload_half(buffer[c]), 3.0517578E-5f, 1.0f);
+					u[                 n] = vload_half(buffer[  B+c])*3.0517578E-5f;
+					u[    p.N+(ulong)n] = vload_half(buffer[2*B+c])*3.0517578E-5f;
+					u[2ull*p.N+(ulong)n] = vload_half(buffer[3*B+c])*3.0517578E-5f;
+					flags[n] = ((const uchar*)transfer_buffer[s])[8ull*B+c];
+				} else {
+					const float* buffer = (const float*)transfer_buffer[s];
+					rho[               n] = buffer[    c];
+					u[                 n] = buffer[  B+c];
+					u[    p.N+(ulong)n] = buffer[2*B+c];
+					u[2ull*p.N+(ulong)n] = buffer[3*B+c];
+					flags[n] = ((const uchar*)transfer_buffer[s])[16ull*B+c];
+				}
+			}
+		}
+	}
+}
+
+
+
+// ################################################## kernel registry ##################################################
+
+typedef void (*Native_Kernel_Function)(const Native_Program& p, const vector<void*>& buffers, const vector<ulong>& constants, const ulong n0, const ulong n1); // processes the global range n0 to n1
+struct Native_Kernel_Entry {
+	const char* name;
+	Native_Kernel_Function function;
+};
+const Native_Kernel_Entry native_kernels[] = { // parameters at the same positions as in kernel.cpp, buffers[i] is set for Memory parameters and constants[i] for constant parameters
+	{ "initialize"                  , kernel_initialize                   },
+	{ "update_moving_boundaries"    , kernel_update_moving_boundaries     },
+	{ "stream_collide"              , kernel_stream_collide               },
+	{ "stream_collide_tiles"        , kernel_stream_collide_tiles         },
+	{ "update_fields"               , kernel_update_fields                },
+	{ "transfer_extract_fi"         , kernel_transfer_extract_fi          },
+	{ "transfer__insert_fi"         , kernel_transfer_insert_fi           },
+	{ "transfer_extract_rho_u_flags", kernel_transfer_extract_rho_u_flags },
+	{ "transfer__insert_rho_u_flags", kernel_transfer_insert_rho_u_flags  },
+};
+
+int get_native_kernel(const string& name) {
+	for(uint i=0u; i<(uint)(sizeof(native_kernels)/sizeof(native_kernels[0])); i++) if(name==native_kernels[i].name) return (int)i;
+	return -1;
+}
+void run_native_kernel(const Native_Program& program, const int kernel, const ulong N, const vector<void*>& buffers, const vector<ulong>& constants) {
+	const Native_Kernel_Function function = native_kernels[kernel].function;
+	thread_pool().run([&](const uint i, const uint T) { // every thread gets a contiguous range of lattice points
+		function(program, buffers, constants, N*(ulong)i/(ulong)T, N*(ulong)(i+1u)/(ulong)T);
+	});
+}
+
+Device_Info get_native_device_info(const uint id) {
+	Device_Info info;
+	info.id = id;
+	info.name = "Native C++ CPU Backend";
+	info.vendor = "FluidX3D";
+	info.driver_version = "native";
+	info.opencl_c_version = "none, kernels in C++";
+#ifdef _WIN32
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	if(GlobalMemoryStatusEx(&status)) info.memory = (uint)(status.ullTotalPhys/1048576ull); // system memory in MB
+#else // Linux
+	const long pages=sysconf(_SC_PHYS_PAGES), page_size=sysconf(_SC_PAGE_SIZE);
+	if(pages>0l&&page_size>0l) info.memory = (uint)((ulong)pages*(ulong)page_size/1048576ull); // system memory in MB
+	std::ifstream cpufreq("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq"); // in kHz
+	ulong frequency = 0ull;
+	if(cpufreq>>frequency) info.clock_frequency = (uint)(frequency/1000ull); // in MHz
+#endif // Linux
+	info.max_global_buffer = info.memory;
+	info.compute_units = max(1u, (uint)thread::hardware_concurrency());
+	info.is_cpu = true;
+	info.is_native = true;
+	info.is_fp32_capable = lanes;
+	info.cores = max(1u, info.compute_units/2u); // assume hyperthreading, same as for OpenCL CPU devices
+	info.tflops = 1E-6f*(float)info.cores*32.0f*(float)info.clock_frequency; // IPC of 32, same as for OpenCL CPU devices
+	return info;
+}
+float measure_native_memory_bandwidth() { // same copy benchmark as measure_memory_bandwidth(), on all CPU threads
+	const ulong N = 16777216ull; // 64 MB per buffer
+	vector<float> a(N, 0.0f), b(N, 0.0f);
+	const auto copy = [&]() {
+		thread_pool().run([&](const uint i, const uint T) {
+			const ulong n0=N*(ulong)i/(ulong)T, n1=N*(ulong)(i+1u)/(ulong)T;
+			std::memcpy((void*)(b.data()+n0), (const void*)(a.data()+n0), (n1-n0)*sizeof(float));
+		});
+	};
+	copy(); // warmup
+	const uint runs = 8u;
+	Clock clock;
+	for(uint i=0u; i<runs; i++) copy();
+	return (float)(2.0*(double)(N*sizeof(float))*(double)runs/clock.stop()*1E-9); // one read and one write per element
+}